@@ -0,0 +1,117 @@
+//! Synthetic benchmark fixtures
+//!
+//! Fixtures are generated deterministically on first use and kept in Cargo's
+//! target tmp directory, so every run (and every release) benchmarks exactly
+//! the same files without checking large data into the repository.
+
+use std::fs;
+use std::io::{BufWriter, Write};
+use std::path::{Path, PathBuf};
+
+use faigz_rs::{FastaFormat, FastaIndex, FastaReader};
+
+/// Length of the single long contig in [`long_contig`]
+pub const LONG_CONTIG_LEN: i64 = 12_000_000;
+
+/// Bases per line in generated FASTA files
+const LINE_WIDTH: usize = 60;
+
+/// Small deterministic generator (xorshift64*), independent of `rand`
+/// versions so fixtures never change between releases
+pub struct XorShift(u64);
+
+impl XorShift {
+    pub fn new(seed: u64) -> Self {
+        XorShift(seed.max(1))
+    }
+
+    pub fn next_u64(&mut self) -> u64 {
+        self.0 ^= self.0 >> 12;
+        self.0 ^= self.0 << 25;
+        self.0 ^= self.0 >> 27;
+        self.0.wrapping_mul(0x2545_f491_4f6c_dd1d)
+    }
+
+    /// Uniform value in `0..n`
+    pub fn below(&mut self, n: u64) -> u64 {
+        self.next_u64() % n.max(1)
+    }
+}
+
+fn fixture_dir() -> PathBuf {
+    let dir = Path::new(env!("CARGO_TARGET_TMPDIR")).join("faigz-fixtures");
+    fs::create_dir_all(&dir).unwrap();
+    dir
+}
+
+/// Write `path` with `write` unless it already exists, then make sure its
+/// index is built
+fn generate(path: PathBuf, write: impl FnOnce(&mut dyn Write)) -> PathBuf {
+    if !path.exists() {
+        let tmp = path.with_extension("tmp");
+        let mut out = BufWriter::new(fs::File::create(&tmp).unwrap());
+        write(&mut out);
+        out.flush().unwrap();
+        drop(out);
+        fs::rename(&tmp, &path).unwrap();
+    }
+    FastaIndex::new(path.to_str().unwrap(), FastaFormat::Fasta).unwrap();
+    path
+}
+
+fn write_record(out: &mut dyn Write, name: &str, seq: &[u8]) {
+    writeln!(out, ">{}", name).unwrap();
+    for line in seq.chunks(LINE_WIDTH) {
+        out.write_all(line).unwrap();
+        out.write_all(b"\n").unwrap();
+    }
+}
+
+fn random_bases(rng: &mut XorShift, len: usize) -> Vec<u8> {
+    (0..len).map(|_| b"ACGT"[rng.below(4) as usize]).collect()
+}
+
+/// Name of contig `i` in [`many_contigs`] (PanSN style)
+pub fn contig_name(i: usize) -> String {
+    format!("HG{:05}#{}#ctg{:06}", i / 16, i % 2 + 1, i)
+}
+
+/// FASTA with `n` short contigs, for name lookup
+pub fn many_contigs(n: usize) -> PathBuf {
+    generate(fixture_dir().join(format!("contigs_{}.fa", n)), |out| {
+        let mut rng = XorShift::new(n as u64);
+        for i in 0..n {
+            let len = 50 + rng.below(100) as usize;
+            write_record(out, &contig_name(i), &random_bases(&mut rng, len));
+        }
+    })
+}
+
+/// FASTA whose first contig, `chr1`, is [`LONG_CONTIG_LEN`] bases long
+pub fn long_contig() -> PathBuf {
+    generate(fixture_dir().join("long.fa"), |out| {
+        let mut rng = XorShift::new(42);
+        write_record(
+            out,
+            "chr1",
+            &random_bases(&mut rng, LONG_CONTIG_LEN as usize),
+        );
+        write_record(out, "chr2", &random_bases(&mut rng, 1_000_000));
+    })
+}
+
+/// The bundled BGZF yeast assemblies and an uncompressed copy of them, so
+/// compressed and plain access can be compared on identical data
+pub fn yeast() -> (PathBuf, PathBuf) {
+    let bgzf = Path::new(env!("CARGO_MANIFEST_DIR")).join("scerevisiae8.fa.gz");
+    let plain = generate(fixture_dir().join("scerevisiae8.fa"), |out| {
+        let index = FastaIndex::new(bgzf.to_str().unwrap(), FastaFormat::Fasta).unwrap();
+        let mut reader = FastaReader::new(&index).unwrap();
+        for name in index.sequence_names() {
+            let len = index.sequence_length(&name).unwrap();
+            let seq = reader.fetch_seq_bytes(&name, 0, len).unwrap();
+            write_record(out, &name, seq);
+        }
+    });
+    (bgzf, plain)
+}
@@ -0,0 +1,178 @@
+//! Criterion suite for the fetch hot paths
+//!
+//! Run with `cargo bench`; fixtures are generated on the first run (see
+//! `common`). Groups:
+//!
+//! - `name_lookup`: sequence lookup against contig count
+//! - `fetch_length`: fetch latency against region length, 10 bp to 10 Mbp
+//! - `fetch_position`: fetch latency against file position, BGZF vs plain
+//! - `thread_scaling`: fetch throughput against thread count
+
+use std::thread;
+use std::time::{Duration, Instant};
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use faigz_rs::{FastaFormat, FastaIndex, FastaReader};
+
+mod common;
+
+use common::XorShift;
+
+/// Length of the regions fetched by the position and thread benchmarks
+const REGION_LEN: i64 = 1_000;
+
+/// Fetches each thread performs per `thread_scaling` iteration
+const FETCHES_PER_THREAD: usize = 1_000;
+
+fn open(path: &std::path::Path) -> FastaIndex {
+    FastaIndex::new(path.to_str().unwrap(), FastaFormat::Fasta).unwrap()
+}
+
+fn name_lookup(c: &mut Criterion) {
+    let mut group = c.benchmark_group("name_lookup");
+
+    for n in [1_000, 10_000, 100_000] {
+        let index = open(&common::many_contigs(n));
+
+        // A fixed spread of names across the whole index
+        let mut rng = XorShift::new(7);
+        let names: Vec<String> = (0..1_024)
+            .map(|_| common::contig_name(rng.below(n as u64) as usize))
+            .collect();
+
+        group.throughput(Throughput::Elements(names.len() as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(n), &names, |b, names| {
+            b.iter(|| {
+                for name in names {
+                    black_box(index.sequence_length(name));
+                }
+            })
+        });
+    }
+
+    group.finish();
+}
+
+fn fetch_length(c: &mut Criterion) {
+    let index = open(&common::long_contig());
+    let reader = FastaReader::new(&index).unwrap();
+    let mut group = c.benchmark_group("fetch_length");
+
+    for len in [10, 100, 1_000, 10_000, 100_000, 1_000_000, 10_000_000i64] {
+        if len >= 1_000_000 {
+            group.sample_size(10);
+        }
+        group.throughput(Throughput::Bytes(len as u64));
+
+        let mut rng = XorShift::new(len as u64);
+        let mut buf = Vec::with_capacity(len as usize);
+        group.bench_with_input(BenchmarkId::from_parameter(len), &len, |b, &len| {
+            b.iter(|| {
+                let start = rng.below((common::LONG_CONTIG_LEN - len) as u64) as i64;
+                buf.clear();
+                reader
+                    .fetch_seq_into("chr1", start, start + len, &mut buf)
+                    .unwrap()
+            })
+        });
+    }
+
+    group.finish();
+}
+
+fn fetch_position(c: &mut Criterion) {
+    let (bgzf, plain) = common::yeast();
+    let mut group = c.benchmark_group("fetch_position");
+    group.throughput(Throughput::Bytes(REGION_LEN as u64));
+
+    for (label, path) in [("bgzf", &bgzf), ("plain", &plain)] {
+        let index = open(path);
+        let reader = FastaReader::new(&index).unwrap();
+        let names = index.sequence_names();
+
+        // Sequences at increasing depth into the file
+        for percent in [0, 25, 50, 75, 100] {
+            let name = &names[(names.len() - 1) * percent / 100];
+            let len = index.sequence_length(name).unwrap();
+            let mut rng = XorShift::new(percent as u64 + 1);
+            let mut buf = Vec::with_capacity(REGION_LEN as usize);
+
+            group.bench_function(BenchmarkId::new(label, percent), |b| {
+                b.iter(|| {
+                    let start = rng.below((len - REGION_LEN) as u64) as i64;
+                    buf.clear();
+                    reader
+                        .fetch_seq_into(name, start, start + REGION_LEN, &mut buf)
+                        .unwrap()
+                })
+            });
+        }
+    }
+
+    group.finish();
+}
+
+fn thread_scaling(c: &mut Criterion) {
+    let (bgzf, plain) = common::yeast();
+    let mut group = c.benchmark_group("thread_scaling");
+    group.sample_size(10);
+    group.measurement_time(Duration::from_secs(10));
+
+    for (label, path) in [("bgzf", &bgzf), ("plain", &plain)] {
+        let index = open(path);
+        let names = index.sequence_names();
+        let lens: Vec<i64> = names
+            .iter()
+            .map(|name| index.sequence_length(name).unwrap())
+            .collect();
+
+        for threads in [1, 2, 4, 8] {
+            let mut readers: Vec<FastaReader> = (0..threads)
+                .map(|_| FastaReader::new(&index).unwrap())
+                .collect();
+
+            group.throughput(Throughput::Elements((threads * FETCHES_PER_THREAD) as u64));
+            group.bench_function(BenchmarkId::new(label, threads), |b| {
+                b.iter_custom(|iters| {
+                    let start = Instant::now();
+                    for iter in 0..iters {
+                        thread::scope(|s| {
+                            for (t, reader) in readers.iter_mut().enumerate() {
+                                let (names, lens) = (&names, &lens);
+                                s.spawn(move || {
+                                    let mut rng = XorShift::new(iter * 64 + t as u64 + 1);
+                                    let mut buf = Vec::with_capacity(REGION_LEN as usize);
+                                    for _ in 0..FETCHES_PER_THREAD {
+                                        let i = rng.below(names.len() as u64) as usize;
+                                        let start = rng.below((lens[i] - REGION_LEN) as u64) as i64;
+                                        buf.clear();
+                                        reader
+                                            .fetch_seq_into(
+                                                &names[i],
+                                                start,
+                                                start + REGION_LEN,
+                                                &mut buf,
+                                            )
+                                            .unwrap();
+                                    }
+                                });
+                            }
+                        });
+                    }
+                    start.elapsed()
+                })
+            });
+        }
+    }
+
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    name_lookup,
+    fetch_length,
+    fetch_position,
+    thread_scaling
+);
+criterion_main!(benches);
@@ -8,33 +8,63 @@ fn main() {
     println!("cargo:rustc-link-lib=z"); // Only link to zlib
     println!("cargo:rustc-link-lib=pthread"); // For pthread support
 
+    // BGZF blocks are inflated with libdeflate instead of zlib when asked for
+    let libdeflate = env::var_os("CARGO_FEATURE_LIBDEFLATE").is_some();
+    if libdeflate {
+        println!("cargo:rustc-link-lib=deflate");
+    }
+
+    // HTTP(S) and S3 range reads go through the system libcurl
+    let remote = env::var_os("CARGO_FEATURE_REMOTE").is_some();
+    if remote {
+        println!("cargo:rustc-link-lib=curl");
+    }
+
     // Tell cargo to invalidate the built crate whenever files change
     println!("cargo:rerun-if-changed=faigz_minimal.h");
     println!("cargo:rerun-if-changed=faigz_minimal.c");
 
     // Build the minimal faigz implementation
-    cc::Build::new()
+    let mut build = cc::Build::new();
+    build
         .file("faigz_minimal.c")
         .include(".")
         .flag_if_supported("-Wno-unused-parameter")
         .flag_if_supported("-Wno-unused-function")
         .flag_if_supported("-Wno-sign-compare")
-        .flag_if_supported("-Wno-unused-variable")
-        .compile("faigz_minimal");
+        .flag_if_supported("-Wno-unused-variable");
+    if libdeflate {
+        build.define("FAIGZ_LIBDEFLATE", None);
+    }
+    if remote {
+        build.define("FAIGZ_CURL", None);
+    }
+    build.compile("faigz_minimal");
 
     // Build the wrapper C code that includes the faigz implementation
-    cc::Build::new()
-        .file("src/wrapper.c")
-        .include(".")
-        .compile("faigz_wrapper");
+    let mut wrapper = cc::Build::new();
+    wrapper.file("src/wrapper.c").include(".");
+    if libdeflate {
+        wrapper.define("FAIGZ_LIBDEFLATE", None);
+    }
+    if remote {
+        wrapper.define("FAIGZ_CURL", None);
+    }
+    wrapper.compile("faigz_wrapper");
 
     // Generate bindings only if we can find the header
     if std::path::Path::new("faigz_minimal.h").exists() {
-        let bindings = bindgen::Builder::default()
+        let mut builder = bindgen::Builder::default()
             .header("faigz_minimal.h")
             .parse_callbacks(Box::new(bindgen::CargoCallbacks::new()))
-            .clang_arg("-I.")
-            .generate();
+            .clang_arg("-I.");
+        if libdeflate {
+            builder = builder.clang_arg("-DFAIGZ_LIBDEFLATE");
+        }
+        if remote {
+            builder = builder.clang_arg("-DFAIGZ_CURL");
+        }
+        let bindings = builder.generate();
 
         match bindings {
             Ok(bindings) => {
@@ -26,10 +26,10 @@ int main() {
     
     printf("Number of sequences: %d\n", meta->n);
     if (meta->n > 0) {
-        printf("First sequence: '%s'\n", meta->name[0]);
+        printf("First sequence: '%s'\n", faidx_meta_iseq(meta, 0));
         
         // Look up the sequence in the hash table
-        faidx1_t *entry = faidx_meta_get_entry(meta, meta->name[0]);
+        faidx1_t *entry = faidx_meta_get_entry(meta, faidx_meta_iseq(meta, 0));
         if (entry) {
             printf("Found entry - seq_offset: %llu, len: %llu\n", 
                    entry->seq_offset, entry->len);
@@ -1,49 +1,135 @@
 #include "faigz_minimal.h"
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+#ifdef FAIGZ_CURL
+#include <curl/curl.h>
+#include <strings.h>
+#endif
+
+// Hardware CRC32 for BGZF blocks; libdeflate brings its own
+#if defined(FAIGZ_LIBDEFLATE)
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FAI_CRC32_PCLMUL
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FAI_CRC32_ARM
+#endif
+
 // Hash table implementation
 static simple_hash_t *hash_init(void) {
-    simple_hash_t *h = calloc(1, sizeof(simple_hash_t));
-    if (!h) return NULL;
-    h->capacity = 16;
-    h->entries = calloc(h->capacity, sizeof(hash_entry_t));
-    if (!h->entries) {
-        free(h);
-        return NULL;
-    }
-    return h;
+    return calloc(1, sizeof(simple_hash_t));
 }
 
 static void hash_destroy(simple_hash_t *h) {
     if (!h) return;
-    for (int i = 0; i < h->n_entries; i++) {
-        free(h->entries[i].key);
-    }
     free(h->entries);
+    free(h->name_off);
+    free(h->arena);
+    free(h->slots);
     free(h);
 }
 
+// FNV-1a, folded to 32 bits
+static uint32_t hash_name(const char *key) {
+    uint64_t x = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        x ^= *p;
+        x *= 0x100000001b3ULL;
+    }
+    return (uint32_t)(x ^ (x >> 32));
+}
+
+// Offsets from a lazily loaded sidecar are only checked here, on use
+static inline const char *hash_key(const simple_hash_t *h, int i) {
+    uint64_t off = h->name_off[i];
+    return off < h->arena_len ? h->arena + off : "";
+}
+
+// Append an entry; the slot table is built afterwards by hash_build
 static int hash_put(simple_hash_t *h, const char *key, faidx1_t val) {
-    if (h->n_entries >= h->capacity) {
-        // Simple resize
-        h->capacity *= 2;
-        h->entries = realloc(h->entries, h->capacity * sizeof(hash_entry_t));
-        if (!h->entries) return -1;
+    if (h->n_entries >= h->m_entries) {
+        int m = h->m_entries ? h->m_entries * 2 : 16;
+        faidx1_t *entries = realloc(h->entries, m * sizeof(faidx1_t));
+        if (!entries) return -1;
+        h->entries = entries;
+        uint64_t *name_off = realloc(h->name_off, m * sizeof(uint64_t));
+        if (!name_off) return -1;
+        h->name_off = name_off;
+        h->m_entries = m;
     }
-    
-    h->entries[h->n_entries].key = strdup(key);
-    h->entries[h->n_entries].val = val;
+
+    size_t key_len = strlen(key) + 1;
+    if (h->arena_len + key_len > h->arena_cap) {
+        uint64_t cap = h->arena_cap ? h->arena_cap : 1024;
+        while (cap < h->arena_len + key_len) cap *= 2;
+        char *arena = realloc(h->arena, cap);
+        if (!arena) return -1;
+        h->arena = arena;
+        h->arena_cap = cap;
+    }
+
+    memcpy(h->arena + h->arena_len, key, key_len);
+    h->name_off[h->n_entries] = h->arena_len;
+    h->arena_len += key_len;
+    h->entries[h->n_entries] = val;
     h->n_entries++;
     return 0;
 }
 
-static faidx1_t *hash_get(simple_hash_t *h, const char *key) {
+// Build the slot table over all entries. Duplicate names keep the first entry.
+static int hash_build(simple_hash_t *h) {
+    uint32_t n_slots = 16;
+    while (n_slots < (uint64_t)h->n_entries * 2) n_slots <<= 1;
+
+    hash_slot_t *slots = calloc(n_slots, sizeof(hash_slot_t));
+    if (!slots) return -1;
+
+    uint32_t mask = n_slots - 1;
     for (int i = 0; i < h->n_entries; i++) {
-        if (strcmp(h->entries[i].key, key) == 0) {
-            return &h->entries[i].val;
+        const char *key = hash_key(h, i);
+        uint32_t hv = hash_name(key);
+        uint32_t k = hv & mask;
+        while (slots[k].idx) {
+            if (slots[k].hash == hv && strcmp(hash_key(h, slots[k].idx - 1), key) == 0) break;
+            k = (k + 1) & mask;
+        }
+        if (!slots[k].idx) {
+            slots[k].hash = hv;
+            slots[k].idx = i + 1;
+        }
+    }
+
+    free(h->slots);
+    h->slots = slots;
+    h->n_slots = n_slots;
+    return 0;
+}
+
+static faidx1_t *hash_get(simple_hash_t *h, const char *key) {
+    if (!h->slots) return NULL;
+
+    uint32_t hv = hash_name(key);
+    uint32_t mask = h->n_slots - 1;
+    uint32_t k = hv & mask;
+    for (uint32_t probes = 0; h->slots[k].idx && probes < h->n_slots; probes++) {
+        const hash_slot_t *slot = &h->slots[k];
+        if (slot->hash == hv && slot->idx <= (uint32_t)h->n_entries &&
+            strcmp(hash_key(h, slot->idx - 1), key) == 0) {
+            return &h->entries[slot->idx - 1];
         }
+        k = (k + 1) & mask;
     }
     return NULL;
 }
@@ -58,544 +144,1395 @@ static char *str_dup(const char *str) {
     return s;
 }
 
-static int is_bgzf_file(const char *filename) {
+static inline uint16_t le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+#ifdef FAI_CRC32_PCLMUL
+// CRC32 of len bytes (len >= 64, a multiple of 16) by carry-less multiply
+// folding, after Gopal et al., "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction". crc is the running CRC, pre- and
+// post-conditioned by the caller.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(const uint8_t *buf, size_t len, uint32_t crc) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = {0x0154442bd4, 0x01c6e41596};
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = {0x01751997d0, 0x00ccaa009e};
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = {0x0163cd6124, 0};
+    static const uint64_t poly[2] __attribute__((aligned(16))) = {0x01db710641, 0x01f7011641};
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    buf += 64;
+    len -= 64;
+
+    // Fold four 128-bit lanes at a time
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    // Fold the lanes into one, then the remaining 16-byte blocks into it
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x4), x5);
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 to 64 bits, then Barrett reduction to 32
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x00), x2);
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+// CRC32 (gzip polynomial) of a decompressed block, with the carry-less
+// multiply or CRC instructions where the CPU has them
+static uint32_t fai_crc32(const char *data, size_t len) {
+    const uint8_t *buf = (const uint8_t *)data;
+#if defined(FAIGZ_LIBDEFLATE)
+    return libdeflate_crc32(0, buf, len);
+#elif defined(FAI_CRC32_PCLMUL)
+    uint32_t crc = 0;
+    if (len >= 64 && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        size_t n = len & ~(size_t)15;
+        crc = ~crc32_pclmul(buf, n, ~crc);
+        buf += n;
+        len -= n;
+    }
+    return crc32(crc, buf, len);
+#elif defined(FAI_CRC32_ARM)
+    uint32_t crc = ~0u;
+    for (; len >= 8; buf += 8, len -= 8) {
+        uint64_t v;
+        memcpy(&v, buf, 8);
+        crc = __crc32d(crc, v);
+    }
+    for (; len; buf++, len--) crc = __crc32b(crc, *buf);
+    return ~crc;
+#else
+    return crc32(0L, buf, len);
+#endif
+}
+
+// Total size of the BGZF block starting at h (from the BC extra subfield), or -1
+static int bgzf_block_size(const uint8_t *h, size_t avail) {
+    if (avail < BGZF_BLOCK_HEADER_LEN) return -1;
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4)) return -1;
+    
+    size_t xend = 12 + le16(h + 10);
+    for (size_t p = 12; p + 4 <= xend && p + 4 <= avail; p += 4 + le16(h + p + 2)) {
+        if (h[p] == 'B' && h[p + 1] == 'C' && le16(h + p + 2) == 2 && p + 6 <= avail) {
+            return le16(h + p + 4) + 1;
+        }
+    }
+    return -1;
+}
+
+// 0 for uncompressed, 1 for plain gzip, 2 for BGZF, from the first bytes
+static int compression_kind(const uint8_t *header, size_t n) {
+    if (n < 2 || header[0] != 0x1f || header[1] != 0x8b) return 0;
+    return bgzf_block_size(header, n) > 0 ? 2 : 1;
+}
+
+// Returns 0 for plain text, 1 for gzip, 2 for BGZF
+static int detect_compression(const char *filename) {
     FILE *fp = fopen(filename, "rb");
     if (!fp) return 0;
     
-    unsigned char magic[2];
-    int is_bgzf = 0;
-    if (fread(magic, 1, 2, fp) == 2) {
-        is_bgzf = (magic[0] == 0x1f && magic[1] == 0x8b);
-    }
+    uint8_t header[BGZF_BLOCK_HEADER_LEN];
+    size_t n = fread(header, 1, sizeof(header), fp);
     fclose(fp);
-    return is_bgzf;
+    return compression_kind(header, n);
+}
+
+static int fai_inflater_init(fai_inflater_t *inf) {
+#ifdef FAIGZ_LIBDEFLATE
+    *inf = libdeflate_alloc_decompressor();
+    return *inf ? 0 : -1;
+#else
+    memset(inf, 0, sizeof(*inf));
+    return inflateInit2(inf, -15) == Z_OK ? 0 : -1;
+#endif
 }
 
-static int create_fai_index(const char *fasta_path, const char *fai_path) {
-    FILE *fasta_fp = fopen(fasta_path, "r");
-    if (!fasta_fp) return -1;
+static void fai_inflater_end(fai_inflater_t *inf) {
+#ifdef FAIGZ_LIBDEFLATE
+    if (*inf) libdeflate_free_decompressor(*inf);
+    *inf = NULL;
+#else
+    inflateEnd(inf);
+#endif
+}
+
+// Inflate one complete BGZF block into out and check it against the block's
+// CRC32; returns the decompressed length or -1. Blocks are independent and at
+// most 64 KiB, so libdeflate inflates each one in a single call.
+static int bgzf_inflate_block(fai_inflater_t *inf, const uint8_t *block, int bsize,
+                              char *out, int out_size) {
+    int hlen = 12 + le16(block + 10);
+    if (bsize < hlen + BGZF_BLOCK_FOOTER_LEN) return -1;
     
-    FILE *fai_fp = fopen(fai_path, "w");
-    if (!fai_fp) {
-        fclose(fasta_fp);
+    uint32_t crc = le32(block + bsize - 8);
+    uint32_t isize = le32(block + bsize - 4);
+    if (isize > (uint32_t)out_size) return -1;
+    const uint8_t *in = block + hlen;
+    size_t in_len = bsize - hlen - BGZF_BLOCK_FOOTER_LEN;
+    
+#ifdef FAIGZ_LIBDEFLATE
+    if (libdeflate_deflate_decompress(*inf, in, in_len, out, isize, NULL) != LIBDEFLATE_SUCCESS) {
         return -1;
     }
+#else
+    if (inflateReset(inf) != Z_OK) return -1;
+    inf->next_in = (Bytef *)in;
+    inf->avail_in = in_len;
+    inf->next_out = (Bytef *)out;
+    inf->avail_out = isize;
+    if (inflate(inf, Z_FINISH) != Z_STREAM_END || inf->avail_out != 0) return -1;
+#endif
+    if (fai_crc32(out, isize) != crc) return -1;
+    
+    return (int)isize;
+}
+
+static int gzi_push(gzi_index_t *index, int *m, uint64_t coffset, uint64_t uoffset) {
+    if (index->n_entries >= *m) {
+        *m = *m ? *m * 2 : 256;
+        gzi_entry_t *entries = realloc(index->entries, *m * sizeof(gzi_entry_t));
+        if (!entries) return -1;
+        index->entries = entries;
+    }
+    index->entries[index->n_entries].compressed_offset = coffset;
+    index->entries[index->n_entries].uncompressed_offset = uoffset;
+    index->n_entries++;
+    return 0;
+}
+
+// Rebuild the block table by walking the BGZF block headers and footers
+static gzi_index_t *scan_gzi_index(const char *path, uint64_t file_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
     
-    char line[1024];
-    char seq_name[256] = {0};
-    uint64_t seq_len = 0;
-    uint64_t seq_offset = 0;
-    uint32_t line_blen = 0;
-    uint32_t line_len = 0;
-    int in_sequence = 0;
-    uint64_t current_offset = 0;
+    gzi_index_t *index = calloc(1, sizeof(gzi_index_t));
+    if (!index) {
+        close(fd);
+        return NULL;
+    }
     
-    while (fgets(line, sizeof(line), fasta_fp)) {
-        int line_length = strlen(line);
-        
-        if (line[0] == '>') {
-            // If we were processing a sequence, write its index entry
-            if (in_sequence && seq_name[0]) {
-                fprintf(fai_fp, "%s\t%lu\t%lu\t%u\t%u\n", 
-                       seq_name, seq_len, seq_offset, line_blen, line_len);
-            }
-            
-            // Start new sequence
-            in_sequence = 1;
-            seq_len = 0;
-            seq_offset = current_offset + line_length;
-            line_blen = 0;
-            line_len = 0;
-            
-            // Extract sequence name (everything after '>' until whitespace)
-            char *name_start = line + 1;
-            char *name_end = name_start;
-            while (*name_end && *name_end != ' ' && *name_end != '\t' && *name_end != '\n') {
-                name_end++;
-            }
-            int name_len = name_end - name_start;
-            if (name_len >= sizeof(seq_name)) name_len = sizeof(seq_name) - 1;
-            strncpy(seq_name, name_start, name_len);
-            seq_name[name_len] = '\0';
-            
-        } else if (in_sequence && line[0] != '\n' && line[0] != '\r') {
-            // Count sequence characters (excluding newlines)
-            int bases_in_line = 0;
-            for (int i = 0; i < line_length; i++) {
-                if (line[i] != '\n' && line[i] != '\r') {
-                    bases_in_line++;
-                }
-            }
-            
-            seq_len += bases_in_line;
-            
-            // Set line length info from first line of sequence
-            if (line_blen == 0) {
-                line_blen = bases_in_line;
-                line_len = line_length;
-            }
+    int m = 0;
+    uint64_t coffset = 0, uoffset = 0;
+    while (coffset < file_size) {
+        uint8_t header[BGZF_BLOCK_HEADER_LEN], isize[4];
+        int bsize;
+        if (pread(fd, header, sizeof(header), coffset) != sizeof(header) ||
+            (bsize = bgzf_block_size(header, sizeof(header))) < 0 ||
+            pread(fd, isize, 4, coffset + bsize - 4) != 4 ||
+            // Empty blocks (such as the EOF marker) hold no data, and bgzip
+            // leaves them out of its .gzi too
+            ((coffset == 0 || le32(isize) > 0) && gzi_push(index, &m, coffset, uoffset) < 0)) {
+            destroy_gzi_index(index);
+            close(fd);
+            return NULL;
         }
-        
-        current_offset += line_length;
+        coffset += bsize;
+        uoffset += le32(isize);
     }
     
-    // Write final sequence entry
-    if (in_sequence && seq_name[0]) {
-        fprintf(fai_fp, "%s\t%lu\t%lu\t%u\t%u\n", 
-               seq_name, seq_len, seq_offset, line_blen, line_len);
+    close(fd);
+    return index;
+}
+
+// Index builder. The file is cut into chunks (runs of BGZF blocks, or byte
+// ranges of a plain file) that worker threads decompress and scan on their
+// own; each chunk is summarised as the fragment before its first newline,
+// run-length encoded whole lines, and the fragment after its last newline.
+// The summaries are then merged in file order, which is cheap and serial.
+#define FAI_BUILD_CHUNK (16 << 20)           // Plain-file bytes per chunk
+#define FAI_BUILD_BLOCKS 256                 // BGZF blocks per chunk
+#define FAI_NAME_MAX 65536                   // Longest header name kept
+
+// Part of a line that may continue into a neighbouring chunk
+typedef struct {
+    uint64_t len, bases;
+    int first;                   // First byte, -1 if empty
+    char *word;                  // Leading bytes up to whitespace
+    size_t word_len;
+    int word_done;               // Whitespace seen, so word is complete
+} fai_frag_t;
+
+// Consecutive whole lines: one marker line, or identical unmarked lines
+typedef struct {
+    uint64_t len, bases, count;
+    int kind;                    // Marker ('>', '@' or '+'), 0 for other lines
+    char *name;                  // Name after a '>' or '@' marker
+} fai_run_t;
+
+typedef struct {
+    fai_frag_t head, tail;
+    int has_nl;                  // Without a newline the chunk is all head
+    fai_run_t *runs;
+    size_t n_runs, m_runs;
+} fai_chunk_t;
+
+// Per-thread scanning state, reused across chunks
+typedef struct {
+    int fd;                      // Shared; only used with pread
+    int compression;
+    fai_format_options format;
+    const gzi_index_t *gzi;
+    uint64_t file_size;
+    int64_t chunk;               // Chunk to scan, -1 for none
+    fai_chunk_t summary;
+    char *buf;
+    size_t buf_size;
+    uint8_t *cbuf;
+    size_t cbuf_size;
+    fai_inflater_t inflater;
+    int inflater_init;
+    int status;
+} fai_worker_t;
+
+static inline int fai_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Which markers start a line of interest depends on the format; in FASTQ
+// they are only hints, as quality lines may begin with '@' or '+' as well
+static inline int fai_line_kind(int first, fai_format_options format) {
+    if (format == FAI_FASTQ) return first == '@' || first == '+' ? first : 0;
+    return first == '>' ? first : 0;
+}
+
+static void fai_frag_init(fai_frag_t *f, const char *p, uint64_t n) {
+    f->len = n;
+    f->first = n ? (unsigned char)p[0] : -1;
+    f->bases = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        if (p[i] != '\n' && p[i] != '\r') f->bases++;
     }
     
-    fclose(fasta_fp);
-    fclose(fai_fp);
+    size_t w = 0;
+    while (w < n && w < FAI_NAME_MAX && !fai_is_space(p[w])) w++;
+    f->word_done = w < n && fai_is_space(p[w]);
+    f->word = w ? malloc(w) : NULL;
+    f->word_len = f->word ? w : 0;
+    if (f->word) memcpy(f->word, p, w);
+}
+
+static void fai_chunk_clear(fai_chunk_t *c) {
+    free(c->head.word);
+    free(c->tail.word);
+    for (size_t i = 0; i < c->n_runs; i++) free(c->runs[i].name);
+    free(c->runs);
+    memset(c, 0, sizeof(*c));
+}
+
+static int fai_chunk_push(fai_chunk_t *c, int kind, uint64_t len, uint64_t bases, char *name) {
+    // Identical unmarked lines collapse into one run
+    if (!kind && c->n_runs > 0) {
+        fai_run_t *last = &c->runs[c->n_runs - 1];
+        if (!last->kind && last->len == len && last->bases == bases) {
+            last->count++;
+            return 0;
+        }
+    }
+    if (c->n_runs == c->m_runs) {
+        size_t m = c->m_runs ? c->m_runs * 2 : 64;
+        fai_run_t *runs = realloc(c->runs, m * sizeof(fai_run_t));
+        if (!runs) return -1;
+        c->runs = runs;
+        c->m_runs = m;
+    }
+    fai_run_t *run = &c->runs[c->n_runs++];
+    run->len = len;
+    run->bases = bases;
+    run->count = 1;
+    run->kind = kind;
+    run->name = name;
     return 0;
 }
 
-static int load_fai_index(faidx_meta_t *meta, const char *fai_path) {
-    FILE *fp = fopen(fai_path, "r");
-    if (!fp) return -1;
-    
-    char line[1024];
-    int idx = 0;
+// Summarise n bytes of decompressed text
+static int fai_scan_chunk(fai_chunk_t *c, const char *buf, uint64_t n,
+                          fai_format_options format) {
+    const char *end = buf + n;
+    const char *nl = memchr(buf, '\n', n);
+    if (!nl) {
+        fai_frag_init(&c->head, buf, n);
+        return 0;
+    }
     
-    while (fgets(line, sizeof(line), fp)) {
-        char *name = strtok(line, "\t");
-        char *len_str = strtok(NULL, "\t");
-        char *offset_str = strtok(NULL, "\t");
-        char *line_blen_str = strtok(NULL, "\t");
-        char *line_len_str = strtok(NULL, "\t\n");
-        
-        if (!name || !len_str || !offset_str || !line_blen_str || !line_len_str) {
-            continue;
+    c->has_nl = 1;
+    fai_frag_init(&c->head, buf, nl - buf + 1);
+    const char *p = nl + 1;
+    while (p < end && (nl = memchr(p, '\n', end - p))) {
+        uint64_t len = nl - p + 1;
+        uint64_t bases = len - 1 - (len >= 2 && nl[-1] == '\r');
+        int kind = fai_line_kind((unsigned char)*p, format);
+        char *name = NULL;
+        if (kind == '>' || kind == '@') {
+            // Name: everything after the marker until whitespace
+            const char *q = p + 1;
+            while (q < nl && !fai_is_space(*q) && q - p <= FAI_NAME_MAX) q++;
+            name = malloc(q - p);
+            if (!name) return -1;
+            memcpy(name, p + 1, q - p - 1);
+            name[q - p - 1] = '\0';
         }
-        
-        // Expand arrays if needed
-        if (idx >= meta->m) {
-            meta->m = meta->m ? meta->m * 2 : 16;
-            meta->name = realloc(meta->name, meta->m * sizeof(char*));
-            if (!meta->name) {
-                fclose(fp);
-                return -1;
-            }
+        if (fai_chunk_push(c, kind, len, bases, name) < 0) {
+            free(name);
+            return -1;
         }
+        p = nl + 1;
+    }
+    fai_frag_init(&c->tail, p, end - p);
+    return 0;
+}
+
+// Decompress (or read) one chunk into the worker's buffer and summarise it
+static int fai_worker_scan(fai_worker_t *w) {
+    int64_t n;
+    if (w->compression == 2) {
+        const gzi_index_t *gzi = w->gzi;
+        int b0 = w->chunk * FAI_BUILD_BLOCKS;
+        int b1 = b0 + FAI_BUILD_BLOCKS < gzi->n_entries ? b0 + FAI_BUILD_BLOCKS : gzi->n_entries;
+        uint64_t c_beg = gzi->entries[b0].compressed_offset;
+        uint64_t c_end = b1 < gzi->n_entries ? gzi->entries[b1].compressed_offset : w->file_size;
+        size_t ucap = (size_t)(b1 - b0) * BGZF_MAX_BLOCK_SIZE;
         
-        meta->name[idx] = str_dup(name);
-        if (!meta->name[idx]) {
-            fclose(fp);
-            return -1;
+        if (c_end - c_beg > w->cbuf_size) {
+            uint8_t *cbuf = realloc(w->cbuf, c_end - c_beg);
+            if (!cbuf) return -1;
+            w->cbuf = cbuf;
+            w->cbuf_size = c_end - c_beg;
+        }
+        if (ucap > w->buf_size) {
+            char *buf = realloc(w->buf, ucap);
+            if (!buf) return -1;
+            w->buf = buf;
+            w->buf_size = ucap;
+        }
+        if (!w->inflater_init) {
+            if (fai_inflater_init(&w->inflater) < 0) return -1;
+            w->inflater_init = 1;
         }
         
-        faidx1_t val;
-        val.id = idx;
-        val.len = atoll(len_str);
-        val.seq_offset = atoll(offset_str);
-        val.line_blen = atoi(line_blen_str);
-        val.line_len = atoi(line_len_str);
-        val.qual_offset = 0; // For FASTQ, this would be calculated
+        ssize_t got = pread(w->fd, w->cbuf, c_end - c_beg, c_beg);
+        if (got < 0 || (uint64_t)got != c_end - c_beg) return -1;
         
-        if (hash_put(meta->hash, name, val) < 0) {
-            fclose(fp);
-            return -1;
+        n = 0;
+        for (int k = b0; k < b1; k++) {
+            uint64_t off = gzi->entries[k].compressed_offset - c_beg;
+            uint64_t next = k + 1 < b1 ? gzi->entries[k + 1].compressed_offset - c_beg : c_end - c_beg;
+            int bsize = bgzf_block_size(w->cbuf + off, next - off);
+            if (bsize < 0) return -1;
+            int ulen = bgzf_inflate_block(&w->inflater, w->cbuf + off, bsize, w->buf + n,
+                                          BGZF_MAX_BLOCK_SIZE);
+            if (ulen < 0) return -1;
+            n += ulen;
         }
-        
-        idx++;
+    } else {
+        uint64_t beg = (uint64_t)w->chunk * FAI_BUILD_CHUNK;
+        uint64_t len = w->file_size - beg < FAI_BUILD_CHUNK ? w->file_size - beg : FAI_BUILD_CHUNK;
+        if (len > w->buf_size) {
+            char *buf = realloc(w->buf, len);
+            if (!buf) return -1;
+            w->buf = buf;
+            w->buf_size = len;
+        }
+        n = pread(w->fd, w->buf, len, beg);
+        if (n < 0 || (uint64_t)n != len) return -1;
     }
     
-    meta->n = idx;
-    fclose(fp);
-    return 0;
+    return fai_scan_chunk(&w->summary, w->buf, n, w->format);
 }
 
-// Public API implementation
-faidx_meta_t *faidx_meta_load(const char *filename, fai_format_options format, int flags) {
-    if (!filename) return NULL;
-    
-    faidx_meta_t *meta = calloc(1, sizeof(faidx_meta_t));
-    if (!meta) return NULL;
-    
-    // Initialize mutex
-    if (pthread_mutex_init(&meta->mutex, NULL) != 0) {
-        free(meta);
-        return NULL;
-    }
-    
-    meta->format = format;
-    meta->ref_count = 1;
-    meta->is_bgzf = is_bgzf_file(filename);
+static void *fai_worker_main(void *arg) {
+    fai_worker_t *w = arg;
+    w->status = fai_worker_scan(w);
+    return NULL;
+}
+
+// FASTQ record parsing state
+enum { FQ_HEADER, FQ_SEQ, FQ_QUAL };
+
+// Serial merge of chunk summaries into .fai records
+typedef struct {
+    FILE *fai;
+    fai_format_options format;
+    uint64_t offset;             // File offset of the next line
     
-    // Store file paths
-    meta->fasta_path = str_dup(filename);
+    // Line still open at the end of the previous chunk
+    int open, kind, word_done;
+    uint64_t len, bases;
+    char *word;                  // Header name gathered so far
+    size_t word_len, word_cap;
     
-    // Construct index paths
-    char fai_path[1024];
-    snprintf(fai_path, sizeof(fai_path), "%s.fai", filename);
-    meta->fai_path = str_dup(fai_path);
+    // Sequence being indexed
+    int in_seq;
+    char *name;
+    size_t name_cap;
+    uint64_t seq_len, seq_offset;
+    uint64_t line_blen, line_len;
     
-    char gzi_path[1024];
-    snprintf(gzi_path, sizeof(gzi_path), "%s.gzi", filename);
-    meta->gzi_path = str_dup(gzi_path);
+    // FASTQ only
+    int fq_state;
+    uint64_t qual_len, qual_offset;
+} fai_merge_t;
+
+static void fai_merge_flush(fai_merge_t *m) {
+    if (!m->in_seq || !m->name || !m->name[0]) return;
     
-    if (!meta->fasta_path || !meta->fai_path || !meta->gzi_path) {
-        faidx_meta_destroy(meta);
-        return NULL;
+    if (m->format == FAI_FASTQ) {
+        fprintf(m->fai, "%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                m->name, m->seq_len, m->seq_offset, m->line_blen, m->line_len, m->qual_offset);
+    } else {
+        fprintf(m->fai, "%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                m->name, m->seq_len, m->seq_offset, m->line_blen, m->line_len);
     }
-    
-    // Initialize hash table
-    meta->hash = hash_init();
-    if (!meta->hash) {
-        faidx_meta_destroy(meta);
-        return NULL;
+    m->in_seq = 0;
+}
+
+static int fai_merge_header(fai_merge_t *m, const char *name, size_t name_len, uint64_t len) {
+    fai_merge_flush(m);
+    if (name_len + 1 > m->name_cap) {
+        char *buf = realloc(m->name, name_len + 1);
+        if (!buf) return -1;
+        m->name = buf;
+        m->name_cap = name_len + 1;
     }
+    if (name_len) memcpy(m->name, name, name_len);
+    m->name[name_len] = '\0';
     
-    // Try to load the index, or create it if it doesn't exist and FAI_CREATE is set
-    if (load_fai_index(meta, meta->fai_path) < 0) {
-        if (flags & FAI_CREATE) {
-            // Try to create the index
-            if (create_fai_index(meta->fasta_path, meta->fai_path) < 0) {
-                faidx_meta_destroy(meta);
-                return NULL;
-            }
-            // Now try to load the newly created index
-            if (load_fai_index(meta, meta->fai_path) < 0) {
-                faidx_meta_destroy(meta);
-                return NULL;
-            }
-        } else {
-            faidx_meta_destroy(meta);
-            return NULL;
+    m->in_seq = 1;
+    m->seq_len = 0;
+    m->seq_offset = m->offset + len;
+    m->line_blen = m->line_len = 0;
+    m->offset += len;
+    return 0;
+}
+
+static void fai_merge_lines(fai_merge_t *m, uint64_t len, uint64_t bases, uint64_t count) {
+    // Blank lines and anything before the first header only move the offset
+    if (m->in_seq && bases > 0) {
+        m->seq_len += bases * count;
+        if (m->line_blen == 0) {
+            m->line_blen = bases;
+            m->line_len = len;
         }
     }
-    
-    // Load GZI index if this is a BGZF file
-    meta->gzi_index = NULL;
-    if (meta->is_bgzf) {
-        meta->gzi_index = load_gzi_index(meta->gzi_path);
-        // GZI index is optional - continue even if it fails to load
+    m->offset += len * count;
+}
+
+// A FASTQ record is "@name", sequence lines, a "+" line, then quality lines
+// until the quality is as long as the sequence. Quality lines may start
+// with '@' or '+', so the record state, not the marker, decides.
+static int fai_merge_fastq(fai_merge_t *m, int kind, const char *name, size_t name_len,
+                           uint64_t len, uint64_t bases, uint64_t count) {
+    switch (m->fq_state) {
+    case FQ_HEADER:
+        if (bases == 0) {
+            m->offset += len * count;
+            return 0;
+        }
+        if (kind != '@' || fai_merge_header(m, name, name_len, len) < 0) return -1;
+        m->fq_state = FQ_SEQ;
+        return 0;
+        
+    case FQ_SEQ:
+        if (kind != '+') {
+            fai_merge_lines(m, len, bases, count);
+            return 0;
+        }
+        m->qual_offset = m->offset + len;
+        m->qual_len = 0;
+        m->offset += len;
+        m->fq_state = FQ_QUAL;
+        break;
+        
+    default:
+        m->qual_len += bases * count;
+        m->offset += len * count;
+        break;
     }
     
-    return meta;
+    if (m->qual_len > m->seq_len) return -1;
+    if (m->qual_len == m->seq_len) {
+        fai_merge_flush(m);
+        m->fq_state = FQ_HEADER;
+    }
+    return 0;
 }
 
-faidx_meta_t *faidx_meta_ref(faidx_meta_t *meta) {
-    if (!meta) return NULL;
+static int fai_merge_line(fai_merge_t *m, int kind, const char *name, size_t name_len,
+                          uint64_t len, uint64_t bases, uint64_t count) {
+    if (m->format == FAI_FASTQ) return fai_merge_fastq(m, kind, name, name_len, len, bases, count);
+    if (kind == '>') return fai_merge_header(m, name, name_len, len);
+    fai_merge_lines(m, len, bases, count);
+    return 0;
+}
+
+// Add a fragment to the open line (starting one if needed) and, if the
+// fragment ends in a newline, complete it
+static int fai_merge_frag(fai_merge_t *m, const fai_frag_t *f, int complete) {
+    size_t skip = 0;
+    if (!m->open) {
+        m->open = 1;
+        m->kind = fai_line_kind(f->first, m->format);
+        m->word_done = 0;
+        m->word_len = 0;
+        m->len = m->bases = 0;
+        skip = m->kind != 0;
+    }
+    m->len += f->len;
+    m->bases += f->bases;
     
-    pthread_mutex_lock(&meta->mutex);
-    meta->ref_count++;
-    pthread_mutex_unlock(&meta->mutex);
+    if ((m->kind == '>' || m->kind == '@') && !m->word_done) {
+        size_t add = f->word_len > skip ? f->word_len - skip : 0;
+        if (m->word_len + add > FAI_NAME_MAX) add = FAI_NAME_MAX - m->word_len;
+        if (m->word_len + add > m->word_cap) {
+            size_t cap = m->word_cap ? m->word_cap : 256;
+            while (cap < m->word_len + add) cap *= 2;
+            char *buf = realloc(m->word, cap);
+            if (!buf) return -1;
+            m->word = buf;
+            m->word_cap = cap;
+        }
+        if (add) memcpy(m->word + m->word_len, f->word + skip, add);
+        m->word_len += add;
+        m->word_done = f->word_done || m->word_len == FAI_NAME_MAX;
+    }
     
-    return meta;
+    if (!complete) return 0;
+    m->open = 0;
+    return fai_merge_line(m, m->kind, m->word, m->word_len, m->len, m->bases, 1);
 }
 
-void faidx_meta_destroy(faidx_meta_t *meta) {
-    if (!meta) return;
+static int fai_merge_chunk(fai_merge_t *m, const fai_chunk_t *c) {
+    if (c->head.len && fai_merge_frag(m, &c->head, c->has_nl) < 0) return -1;
+    if (!c->has_nl) return 0;
     
-    pthread_mutex_lock(&meta->mutex);
-    meta->ref_count--;
-    int should_free = (meta->ref_count <= 0);
-    pthread_mutex_unlock(&meta->mutex);
+    for (size_t i = 0; i < c->n_runs; i++) {
+        const fai_run_t *run = &c->runs[i];
+        if (fai_merge_line(m, run->kind, run->name, run->name ? strlen(run->name) : 0,
+                           run->len, run->bases, run->count) < 0) return -1;
+    }
+    if (c->tail.len && fai_merge_frag(m, &c->tail, 0) < 0) return -1;
+    return 0;
+}
+
+// Write the block table in .gzi layout, which leaves out the first block
+static int write_gzi_index(const gzi_index_t *index, const char *gzi_path) {
+    FILE *fp = fopen(gzi_path, "wb");
+    if (!fp) return -1;
     
-    if (should_free) {
-        if (meta->hash) hash_destroy(meta->hash);
-        
-        if (meta->name) {
-            for (int i = 0; i < meta->n; i++) {
-                free(meta->name[i]);
-            }
-            free(meta->name);
-        }
-        
-        free(meta->fasta_path);
-        free(meta->fai_path);
-        free(meta->gzi_path);
-        
-        if (meta->gzi_index) {
-            destroy_gzi_index(meta->gzi_index);
-        }
-        
-        pthread_mutex_destroy(&meta->mutex);
-        free(meta);
+    uint64_t n = index->n_entries > 0 ? index->n_entries - 1 : 0;
+    int ok = fwrite(&n, sizeof(uint64_t), 1, fp) == 1;
+    for (int i = 1; ok && i < index->n_entries; i++) {
+        uint64_t pair[2] = {index->entries[i].compressed_offset,
+                            index->entries[i].uncompressed_offset};
+        ok = fwrite(pair, sizeof(uint64_t), 2, fp) == 2;
     }
+    
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -1;
 }
 
-faidx_reader_t *faidx_reader_create(faidx_meta_t *meta) {
-    if (!meta) return NULL;
+// path = base followed by suffix; fails if that does not fit
+static int suffix_path(char *path, size_t size, const char *base, const char *suffix) {
+    int n = snprintf(path, size, "%s%s", base, suffix);
+    return (n > 0 && (size_t)n < size) ? 0 : -1;
+}
+
+int faidx_build_index(const char *filename, fai_format_options format, int n_threads) {
+    if (!filename) return -1;
     
-    faidx_reader_t *reader = calloc(1, sizeof(faidx_reader_t));
-    if (!reader) return NULL;
+    char fai_path[1024], gzi_path[1024];
+    if (suffix_path(fai_path, sizeof(fai_path), filename, ".fai") < 0) return -1;
+    if (suffix_path(gzi_path, sizeof(gzi_path), filename, ".gzi") < 0) return -1;
     
-    reader->meta = faidx_meta_ref(meta);
+    struct stat st;
+    if (stat(filename, &st) != 0) return -1;
+    int compression = detect_compression(filename);
     
-    // Open file
-    if (meta->is_bgzf) {
-        reader->gzfp = gzopen(meta->fasta_path, "r");
-        if (!reader->gzfp) {
-            faidx_meta_destroy(reader->meta);
-            free(reader);
-            return NULL;
-        }
-    } else {
-        reader->fp = fopen(meta->fasta_path, "r");
-        if (!reader->fp) {
-            faidx_meta_destroy(reader->meta);
-            free(reader);
-            return NULL;
+    // BGZF chunks are runs of blocks, so the block table comes first
+    gzi_index_t *gzi = NULL;
+    int write_gzi = 0;
+    if (compression == 2) {
+        gzi = load_gzi_index(gzi_path);
+        if (!gzi) {
+            gzi = scan_gzi_index(filename, st.st_size);
+            write_gzi = 1;
         }
+        if (!gzi) return -1;
     }
     
-    return reader;
-}
-
-void faidx_reader_destroy(faidx_reader_t *reader) {
-    if (!reader) return;
+    FILE *fai_fp = fopen(fai_path, "w");
+    if (!fai_fp) {
+        destroy_gzi_index(gzi);
+        return -1;
+    }
     
-    if (reader->fp) fclose(reader->fp);
-    if (reader->gzfp) gzclose(reader->gzfp);
+    fai_merge_t m;
+    memset(&m, 0, sizeof(m));
+    m.fai = fai_fp;
+    m.format = format;
+    int ret = 0;
     
-    faidx_meta_destroy(reader->meta);
-    free(reader);
+    if (compression == 1) {
+        // Plain gzip only decompresses from the start, so scan it serially
+        gzFile gz = gzopen(filename, "rb");
+        char *buf = malloc(FAI_BUILD_CHUNK);
+        int n = -1;
+        if (gz && buf) {
+            while ((n = gzread(gz, buf, FAI_BUILD_CHUNK)) > 0) {
+                fai_chunk_t c;
+                memset(&c, 0, sizeof(c));
+                if (fai_scan_chunk(&c, buf, n, format) < 0 || fai_merge_chunk(&m, &c) < 0) n = -1;
+                fai_chunk_clear(&c);
+                if (n < 0) break;
+            }
+        }
+        if (n < 0) ret = -1;
+        if (gz) gzclose(gz);
+        free(buf);
+    } else {
+        int64_t n_chunks = compression == 2
+            ? (gzi->n_entries + FAI_BUILD_BLOCKS - 1) / FAI_BUILD_BLOCKS
+            : ((uint64_t)st.st_size + FAI_BUILD_CHUNK - 1) / FAI_BUILD_CHUNK;
+        if (n_threads <= 0) {
+            long n = sysconf(_SC_NPROCESSORS_ONLN);
+            n_threads = n > 0 ? (int)n : 1;
+        }
+        if (n_threads > n_chunks) n_threads = n_chunks > 0 ? (int)n_chunks : 1;
+        
+        int fd = open(filename, O_RDONLY);
+        fai_worker_t *workers = calloc(n_threads, sizeof(fai_worker_t));
+        pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+        if (fd < 0 || !workers || !threads) ret = -1;
+        
+        for (int t = 0; ret == 0 && t < n_threads; t++) {
+            workers[t].fd = fd;
+            workers[t].compression = compression;
+            workers[t].format = format;
+            workers[t].gzi = gzi;
+            workers[t].file_size = st.st_size;
+        }
+        
+        // Scan a wave of chunks in parallel, then merge the wave in order
+        for (int64_t next = 0; ret == 0 && next < n_chunks; next += n_threads) {
+            int n = n_chunks - next < n_threads ? (int)(n_chunks - next) : n_threads;
+            int *started = calloc(n, sizeof(int));
+            if (!started) {
+                ret = -1;
+                break;
+            }
+            for (int t = 0; t < n; t++) {
+                workers[t].chunk = next + t;
+                if (t > 0 && pthread_create(&threads[t], NULL, fai_worker_main, &workers[t]) == 0) {
+                    started[t] = 1;
+                }
+            }
+            for (int t = 0; t < n; t++) {
+                if (!started[t]) fai_worker_main(&workers[t]);
+            }
+            for (int t = 0; t < n; t++) {
+                if (started[t]) pthread_join(threads[t], NULL);
+            }
+            free(started);
+            
+            for (int t = 0; t < n; t++) {
+                if (ret == 0 && (workers[t].status < 0 ||
+                                 fai_merge_chunk(&m, &workers[t].summary) < 0)) {
+                    ret = -1;
+                }
+                fai_chunk_clear(&workers[t].summary);
+            }
+        }
+        
+        for (int t = 0; workers && t < n_threads; t++) {
+            free(workers[t].buf);
+            free(workers[t].cbuf);
+            if (workers[t].inflater_init) fai_inflater_end(&workers[t].inflater);
+        }
+        free(workers);
+        free(threads);
+        if (fd >= 0) close(fd);
+    }
+    
+    // A last line without a newline still counts
+    if (ret == 0 && m.open) {
+        fai_frag_t end = {0, 0, -1, NULL, 0, 1};
+        if (fai_merge_frag(&m, &end, 1) < 0) ret = -1;
+    }
+    if (ret == 0 && format == FAI_FASTQ && m.fq_state != FQ_HEADER) ret = -1;
+    if (ret == 0) fai_merge_flush(&m);
+    free(m.word);
+    free(m.name);
+    
+    if (fclose(fai_fp) != 0) ret = -1;
+    if (ret < 0) {
+        unlink(fai_path);
+    } else if (write_gzi) {
+        // Best effort: without a .gzi the table is rebuilt at load time
+        write_gzi_index(gzi, gzi_path);
+    }
+    destroy_gzi_index(gzi);
+    return ret;
 }
 
-char *faidx_reader_fetch_seq(faidx_reader_t *reader, const char *c_name,
-                           hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
-    if (!reader || !c_name) return NULL;
+// BGZF writer. The input is read once and parsed serially into normalised
+// records, which fill fixed-size blocks; full waves of blocks are deflated
+// by worker threads while the next wave fills, then written in order. The
+// .fai and .gzi entries fall out of the parse and the block writes, so
+// nothing is read back.
+#define FAI_COMPRESS_BLOCK 0xff00            // Bytes per block, as bgzip, so any block fits in 64 KiB
+#define FAI_COMPRESS_WAVE 16                 // Blocks per thread per wave
+#define FAI_COMPRESS_READ (1 << 20)          // Input bytes per read
+#define FAI_COMPRESS_WIDTH 60                // Default FASTA line width
 
-    faidx1_t *entry = hash_get(reader->meta->hash, c_name);
-    if (!entry) return NULL;
+#ifdef FAIGZ_LIBDEFLATE
+typedef struct libdeflate_compressor *fai_deflater_t;
+#else
+typedef z_stream fai_deflater_t;
+#endif
 
-    // Adjust coordinates
-    if (p_beg_i < 0) p_beg_i = 0;
-    if (p_end_i < 0 || p_end_i > entry->len) p_end_i = entry->len;
-    if (p_beg_i >= p_end_i) return NULL;
+static const uint8_t bgzf_eof[28] = {
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0,
+    3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
 
-    hts_pos_t seq_len = p_end_i - p_beg_i;
-    char *seq = malloc(seq_len + 1);
-    if (!seq) return NULL;
+static int fai_deflater_init(fai_deflater_t *def, int level) {
+#ifdef FAIGZ_LIBDEFLATE
+    *def = libdeflate_alloc_compressor(level);
+    return *def ? 0 : -1;
+#else
+    memset(def, 0, sizeof(*def));
+    return deflateInit2(def, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK ? 0 : -1;
+#endif
+}
 
-    // Calculate file bytes to read using FAI layout info
-    // .fai gives us: line_blen (bases per line), line_len (bytes per line with \n)
-    hts_pos_t full_lines = seq_len / entry->line_blen;
-    hts_pos_t remaining_bases = seq_len % entry->line_blen;
-    hts_pos_t bytes_to_read = full_lines * entry->line_len + remaining_bases;
+static void fai_deflater_end(fai_deflater_t *def) {
+#ifdef FAIGZ_LIBDEFLATE
+    if (*def) libdeflate_free_compressor(*def);
+    *def = NULL;
+#else
+    deflateEnd(def);
+#endif
+}
 
-    // Allocate buffer for read (includes newlines)
-    char *raw_buffer = malloc(bytes_to_read + 1);
-    if (!raw_buffer) {
-        free(seq);
-        return NULL;
+// Compress len bytes into one BGZF block at out (BGZF_MAX_BLOCK_SIZE bytes);
+// returns the block size or -1
+static int bgzf_deflate_block(fai_deflater_t *def, const char *in, int len, uint8_t *out) {
+    static const uint8_t header[BGZF_BLOCK_HEADER_LEN] = {
+        0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0
+    };
+    memcpy(out, header, sizeof(header));
+    uint8_t *data = out + BGZF_BLOCK_HEADER_LEN;
+    size_t cap = BGZF_MAX_BLOCK_SIZE - BGZF_BLOCK_HEADER_LEN - BGZF_BLOCK_FOOTER_LEN;
+
+#ifdef FAIGZ_LIBDEFLATE
+    size_t clen = libdeflate_deflate_compress(*def, in, len, data, cap);
+    if (clen == 0) return -1;
+#else
+    if (deflateReset(def) != Z_OK) return -1;
+    def->next_in = (Bytef *)in;
+    def->avail_in = len;
+    def->next_out = data;
+    def->avail_out = cap;
+    if (deflate(def, Z_FINISH) != Z_STREAM_END) return -1;
+    size_t clen = cap - def->avail_out;
+#endif
+
+    int bsize = BGZF_BLOCK_HEADER_LEN + (int)clen + BGZF_BLOCK_FOOTER_LEN;
+    uint32_t crc = fai_crc32(in, len);
+    out[16] = (bsize - 1) & 0xff;
+    out[17] = (bsize - 1) >> 8;
+    uint8_t *footer = data + clen;
+    for (int i = 0; i < 4; i++) {
+        footer[i] = crc >> (8 * i);
+        footer[4 + i] = (uint32_t)len >> (8 * i);
     }
+    return bsize;
+}
 
-    // ONE seek to sequence start + offset for p_beg_i
-    hts_pos_t start_line = p_beg_i / entry->line_blen;
-    hts_pos_t start_offset_in_line = p_beg_i % entry->line_blen;
-    hts_pos_t file_offset = entry->seq_offset + (start_line * entry->line_len) + start_offset_in_line;
+typedef struct {
+    char *in;
+    int in_len;
+    uint64_t uoffset;            // Uncompressed offset of the block
+    uint8_t *out;
+    int out_len;
+} fai_zblock_t;
 
-    if (gzseek(reader->gzfp, file_offset, SEEK_SET) == -1) {
-        free(seq);
-        free(raw_buffer);
-        return NULL;
+struct fai_zwave_t;
+
+// One thread's share of a wave: every n_threads-th block from t
+typedef struct {
+    struct fai_zwave_t *wave;
+    int t, n_threads;
+    fai_deflater_t deflater;
+    int deflater_init;
+    int status;
+} fai_zjob_t;
+
+typedef struct fai_zwave_t {
+    fai_zblock_t *blocks;
+    int n;                       // Blocks filled
+    fai_zjob_t *jobs;
+    pthread_t *threads;
+    int *started;
+    int busy;                    // Being compressed
+} fai_zwave_t;
+
+// Record parsing state
+enum { FZ_NONE, FZ_HEADER, FZ_SEQ, FZ_PLUS, FZ_QUAL };
+
+typedef struct {
+    FILE *out, *fai;
+    fai_format_options format;
+    int n_threads, width, align;
+
+    // Blocks are filled in waves[cur] while the other wave is compressed
+    fai_zwave_t waves[2];
+    int cur, wave_size;
+    uint64_t uoffset;            // Bytes emitted so far
+    uint64_t block_uoffset;      // Uncompressed offset of the block being filled
+    uint64_t coffset;            // Compressed bytes written so far
+    gzi_index_t gzi;
+    int gzi_m;
+
+    // Current record
+    int mode, bol;
+    char *hdr;                   // Header line, marker and newline excluded
+    size_t hdr_len, hdr_cap;
+    uint64_t rec_start, seq_offset, seq_len, qual_offset, qual_len;
+    int col;
+} fai_zwriter_t;
+
+static void *fai_zjob_main(void *arg) {
+    fai_zjob_t *j = arg;
+    j->status = 0;
+    for (int k = j->t; k < j->wave->n; k += j->n_threads) {
+        fai_zblock_t *b = &j->wave->blocks[k];
+        b->out_len = bgzf_deflate_block(&j->deflater, b->in, b->in_len, b->out);
+        if (b->out_len < 0) {
+            j->status = -1;
+            break;
+        }
     }
+    return NULL;
+}
 
-    // ONE read of all bytes
-    int bytes_read = gzread(reader->gzfp, raw_buffer, bytes_to_read);
-    if (bytes_read <= 0) {
-        free(seq);
-        free(raw_buffer);
-        return NULL;
+static int fai_zwave_init(fai_zwave_t *wave, int n_blocks, int n_threads, int level) {
+    wave->blocks = calloc(n_blocks, sizeof(fai_zblock_t));
+    wave->jobs = calloc(n_threads, sizeof(fai_zjob_t));
+    wave->threads = calloc(n_threads, sizeof(pthread_t));
+    wave->started = calloc(n_threads, sizeof(int));
+    if (!wave->blocks || !wave->jobs || !wave->threads || !wave->started) return -1;
+    for (int k = 0; k < n_blocks; k++) {
+        wave->blocks[k].in = malloc(FAI_COMPRESS_BLOCK);
+        wave->blocks[k].out = malloc(BGZF_MAX_BLOCK_SIZE);
+        if (!wave->blocks[k].in || !wave->blocks[k].out) return -1;
+    }
+    for (int t = 0; t < n_threads; t++) {
+        fai_zjob_t *j = &wave->jobs[t];
+        j->wave = wave;
+        j->t = t;
+        j->n_threads = n_threads;
+        if (fai_deflater_init(&j->deflater, level) < 0) return -1;
+        j->deflater_init = 1;
     }
-    raw_buffer[bytes_read] = '\0';
+    return 0;
+}
 
-    // Strip newlines in one pass
-    hts_pos_t write_pos = 0;
-    for (int i = 0; i < bytes_read && write_pos < seq_len; i++) {
-        char c = raw_buffer[i];
-        if (c != '\n' && c != '\r') {
-            seq[write_pos++] = c;
+static void fai_zwave_free(fai_zwave_t *wave, int n_blocks, int n_threads) {
+    for (int k = 0; wave->blocks && k < n_blocks; k++) {
+        free(wave->blocks[k].in);
+        free(wave->blocks[k].out);
+    }
+    for (int t = 0; wave->jobs && t < n_threads; t++) {
+        if (wave->jobs[t].deflater_init) fai_deflater_end(&wave->jobs[t].deflater);
+    }
+    free(wave->blocks);
+    free(wave->jobs);
+    free(wave->threads);
+    free(wave->started);
+}
+
+static void fai_zwave_start(fai_zwave_t *wave, int n_threads) {
+    for (int t = 0; t < n_threads; t++) {
+        wave->started[t] = pthread_create(&wave->threads[t], NULL, fai_zjob_main,
+                                          &wave->jobs[t]) == 0;
+    }
+    wave->busy = 1;
+}
+
+// Wait for a wave to be compressed, then write its blocks in order
+static int fz_write_wave(fai_zwriter_t *w, fai_zwave_t *wave) {
+    if (!wave->busy) return 0;
+    int ret = 0;
+    for (int t = 0; t < w->n_threads; t++) {
+        // Threads that could not be started do their share here
+        if (wave->started[t]) pthread_join(wave->threads[t], NULL);
+        else fai_zjob_main(&wave->jobs[t]);
+        if (wave->jobs[t].status < 0) ret = -1;
+    }
+    for (int k = 0; ret == 0 && k < wave->n; k++) {
+        fai_zblock_t *b = &wave->blocks[k];
+        if (gzi_push(&w->gzi, &w->gzi_m, w->coffset, b->uoffset) < 0 ||
+            fwrite(b->out, 1, b->out_len, w->out) != (size_t)b->out_len) {
+            ret = -1;
         }
+        w->coffset += b->out_len;
     }
+    wave->n = 0;
+    wave->busy = 0;
+    return ret;
+}
 
-    free(raw_buffer);
-    seq[write_pos] = '\0';
+// Close the block being filled. With record alignment, a record that began
+// inside it moves whole to the next block, so that records no longer than
+// a block are never split.
+static int fz_cut(fai_zwriter_t *w) {
+    fai_zwave_t *wave = &w->waves[w->cur];
+    fai_zblock_t *b = &wave->blocks[wave->n];
+    int keep = 0;
+    if (w->align && w->rec_start > w->block_uoffset) {
+        keep = b->in_len - (int)(w->rec_start - w->block_uoffset);
+    }
+    b->in_len -= keep;
+    b->uoffset = w->block_uoffset;
+    w->block_uoffset += b->in_len;
 
-    if (len) *len = write_pos;
+    if (++wave->n == w->wave_size) {
+        // Hand this wave to the threads and fill the other once it is written
+        if (fz_write_wave(w, &w->waves[!w->cur]) < 0) return -1;
+        fai_zwave_start(wave, w->n_threads);
+        w->cur = !w->cur;
+    }
 
-    if (write_pos == 0) {
-        free(seq);
-        return NULL;
+    // The threads only read the compressed part of b, so the kept tail can
+    // be copied out while they run
+    fai_zblock_t *next = &w->waves[w->cur].blocks[w->waves[w->cur].n];
+    memcpy(next->in, b->in + b->in_len, keep);
+    next->in_len = keep;
+    return 0;
+}
+
+static int fz_put(fai_zwriter_t *w, const char *p, size_t n) {
+    while (n > 0) {
+        fai_zwave_t *wave = &w->waves[w->cur];
+        fai_zblock_t *b = &wave->blocks[wave->n];
+        size_t take = FAI_COMPRESS_BLOCK - b->in_len;
+        if (take > n) take = n;
+        memcpy(b->in + b->in_len, p, take);
+        b->in_len += take;
+        w->uoffset += take;
+        p += take;
+        n -= take;
+        if (b->in_len == FAI_COMPRESS_BLOCK && fz_cut(w) < 0) return -1;
     }
+    return 0;
+}
 
-    return seq;
+// Bases of a FASTA record, wrapped at the line width
+static int fz_put_bases(fai_zwriter_t *w, const char *p, size_t n) {
+    w->seq_len += n;
+    while (n > 0) {
+        size_t take = w->width - w->col;
+        if (take > n) take = n;
+        if (fz_put(w, p, take) < 0) return -1;
+        w->col += take;
+        p += take;
+        n -= take;
+        if (w->col == w->width) {
+            if (fz_put(w, "\n", 1) < 0) return -1;
+            w->col = 0;
+        }
+    }
+    return 0;
 }
 
-// LEGACY CODE - keeping old implementation commented for reference
-char *faidx_reader_fetch_seq_OLD(faidx_reader_t *reader, const char *c_name,
-                           hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
-    if (!reader || !c_name) return NULL;
+// Runs of non-space bytes in [p, end), passed to put (bases or quality)
+static int fz_put_runs(fai_zwriter_t *w, const char *p, const char *end, int quality) {
+    while (p < end) {
+        const char *q = p;
+        while (q < end && !fai_is_space(*q)) q++;
+        if (q > p) {
+            int r;
+            if (quality) {
+                w->qual_len += q - p;
+                r = fz_put(w, p, q - p);
+            } else if (w->format == FAI_FASTQ) {
+                w->seq_len += q - p;
+                r = fz_put(w, p, q - p);
+            } else {
+                r = fz_put_bases(w, p, q - p);
+            }
+            if (r < 0) return -1;
+        }
+        while (q < end && fai_is_space(*q)) q++;
+        p = q;
+    }
+    return 0;
+}
 
-    faidx1_t *entry = hash_get(reader->meta->hash, c_name);
-    if (!entry) return NULL;
+static int fz_hdr_add(fai_zwriter_t *w, const char *p, size_t n) {
+    if (w->hdr_len + n > w->hdr_cap) {
+        size_t cap = w->hdr_cap ? w->hdr_cap : 256;
+        while (cap < w->hdr_len + n) cap *= 2;
+        char *hdr = realloc(w->hdr, cap);
+        if (!hdr) return -1;
+        w->hdr = hdr;
+        w->hdr_cap = cap;
+    }
+    memcpy(w->hdr + w->hdr_len, p, n);
+    w->hdr_len += n;
+    return 0;
+}
 
-    // Adjust coordinates
-    if (p_beg_i < 0) p_beg_i = 0;
-    if (p_end_i < 0 || p_end_i > entry->len) p_end_i = entry->len;
-    if (p_beg_i >= p_end_i) return NULL;
+// Write the header line and start the record's sequence
+static int fz_header_done(fai_zwriter_t *w) {
+    while (w->hdr_len > 0 && w->hdr[w->hdr_len - 1] == '\r') w->hdr_len--;
+    w->rec_start = w->uoffset;
+    char marker = w->format == FAI_FASTQ ? '@' : '>';
+    if (fz_put(w, &marker, 1) < 0 || fz_put(w, w->hdr, w->hdr_len) < 0 ||
+        fz_put(w, "\n", 1) < 0) return -1;
+    w->seq_offset = w->uoffset;
+    w->seq_len = w->qual_len = 0;
+    w->col = 0;
+    w->mode = FZ_SEQ;
+    return 0;
+}
 
-    hts_pos_t seq_len = p_end_i - p_beg_i;
-    char *seq = malloc(seq_len + 1);
-    if (!seq) return NULL;
+// End the record: finish its last line and write its .fai entry
+static int fz_record_done(fai_zwriter_t *w) {
+    if (w->format == FAI_FASTA && w->col > 0 && fz_put(w, "\n", 1) < 0) return -1;
 
-    // BGZF implementation using GZI index for random access
-    if (reader->meta->is_bgzf) {
-        if (!reader->meta->gzi_index) {
-            // No GZI index available
-            free(seq);
-            return NULL;
-        }
+    size_t name_len = 0;
+    while (name_len < w->hdr_len && name_len < FAI_NAME_MAX && !fai_is_space(w->hdr[name_len])) {
+        name_len++;
+    }
+    w->mode = FZ_NONE;
+    if (name_len == 0) return 0;
 
-        // Calculate the uncompressed offset where the sequence starts
-        uint64_t seq_start_offset = entry->seq_offset;
+    uint64_t blen = 0;
+    if (w->seq_len > 0) {
+        blen = w->format == FAI_FASTA && w->seq_len > (uint64_t)w->width ? w->width : w->seq_len;
+    }
+    uint64_t llen = blen ? blen + 1 : 0;
+    int ok;
+    if (w->format == FAI_FASTQ) {
+        ok = fprintf(w->fai, "%.*s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                     (int)name_len, w->hdr, w->seq_len, w->seq_offset, blen, llen,
+                     w->qual_offset) > 0;
+    } else {
+        ok = fprintf(w->fai, "%.*s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                     (int)name_len, w->hdr, w->seq_len, w->seq_offset, blen, llen) > 0;
+    }
+    return ok ? 0 : -1;
+}
 
-        // Add the position within the sequence
-        uint64_t target_offset = seq_start_offset;
+// The '+' line of a FASTQ record: its text is dropped, so "+" alone is written
+static int fz_plus_done(fai_zwriter_t *w) {
+    if (fz_put(w, "\n+\n", 3) < 0) return -1;
+    w->qual_offset = w->uoffset;
+    w->mode = FZ_QUAL;
+    if (w->seq_len == 0) return fz_put(w, "\n", 1) < 0 ? -1 : fz_record_done(w);
+    return 0;
+}
 
-        // For this minimal implementation, we'll read from the sequence start
-        // and then navigate to the right position
-        // For sequences that start very early (like offset 15), use the beginning of the file
-        uint64_t compressed_offset = 0; // Start from the beginning of the file
-        if (seq_start_offset > 1000) {
-            compressed_offset = find_bgzf_block(reader->meta->gzi_index, seq_start_offset);
-        }
+// A FASTQ quality line ended; the record is complete once the quality is
+// as long as the sequence
+static int fz_qual_done(fai_zwriter_t *w) {
+    if (w->qual_len > w->seq_len) return -1;
+    if (w->qual_len < w->seq_len) return 0;
+    return fz_put(w, "\n", 1) < 0 ? -1 : fz_record_done(w);
+}
 
-        // Create a larger buffer to read the block
-        char *block_buffer = malloc(65536); // 64KB should be enough for most BGZF blocks
-        if (!block_buffer) {
-            free(seq);
-            return NULL;
+// Parse n bytes of input; lines may continue across calls
+static int fz_feed(fai_zwriter_t *w, const char *p, size_t n) {
+    const char *end = p + n;
+    while (p < end) {
+        if (w->bol) {
+            char c = *p;
+            if (w->format == FAI_FASTA && c == '>') {
+                if (w->mode == FZ_SEQ && fz_record_done(w) < 0) return -1;
+                w->mode = FZ_HEADER;
+                w->hdr_len = 0;
+                p++;
+            } else if (w->format == FAI_FASTQ && w->mode == FZ_NONE && c != '\n' && c != '\r') {
+                if (c != '@') return -1;
+                w->mode = FZ_HEADER;
+                w->hdr_len = 0;
+                p++;
+            } else if (w->format == FAI_FASTQ && w->mode == FZ_SEQ && c == '+') {
+                w->mode = FZ_PLUS;
+                p++;
+            }
+            w->bol = 0;
         }
 
-        int block_size = bgzf_read_block(reader->gzfp, compressed_offset, block_buffer, 65536);
-        if (block_size <= 0) {
-            free(block_buffer);
-            free(seq);
-            return NULL;
+        const char *nl = memchr(p, '\n', end - p);
+        const char *e = nl ? nl : end;
+        int r = 0;
+        switch (w->mode) {
+        case FZ_HEADER:
+            r = fz_hdr_add(w, p, e - p);
+            if (r == 0 && nl) r = fz_header_done(w);
+            break;
+        case FZ_SEQ:
+            r = fz_put_runs(w, p, e, 0);
+            break;
+        case FZ_PLUS:
+            if (nl) r = fz_plus_done(w);
+            break;
+        case FZ_QUAL:
+            r = fz_put_runs(w, p, e, 1);
+            if (r == 0 && nl) r = fz_qual_done(w);
+            break;
+        default:
+            // Text before the first header is dropped
+            break;
         }
+        if (r < 0) return -1;
+        if (nl) w->bol = 1;
+        p = nl ? nl + 1 : end;
+    }
+    return 0;
+}
 
-        // Now we need to parse the block to find our sequence and position
-        // This is a simplified approach - we'll scan for the sequence header
-        char *seq_start = NULL;
-        char *search_pattern = malloc(strlen(c_name) + 2);
-        if (!search_pattern) {
-            free(block_buffer);
-            free(seq);
-            return NULL;
-        }
+// Input ended: close the open line and record
+static int fz_finish(fai_zwriter_t *w) {
+    if (w->mode == FZ_HEADER && fz_header_done(w) < 0) return -1;
+    if (w->mode == FZ_PLUS && fz_plus_done(w) < 0) return -1;
+    if (w->mode == FZ_QUAL && !w->bol && fz_qual_done(w) < 0) return -1;
+    if (w->format == FAI_FASTA && w->mode == FZ_SEQ) return fz_record_done(w);
+    return w->mode == FZ_NONE ? 0 : -1;
+}
 
-        snprintf(search_pattern, strlen(c_name) + 2, ">%s", c_name);
-        seq_start = strstr(block_buffer, search_pattern);
+int faidx_compress(const char *in_path, const char *out_path, fai_format_options format,
+                   const faidx_compress_opts_t *opts) {
+    if (!in_path || (format != FAI_FASTA && format != FAI_FASTQ)) return -1;
+    faidx_compress_opts_t o;
+    memset(&o, 0, sizeof(o));
+    if (opts) o = *opts;
+    if (o.n_threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        o.n_threads = n > 0 ? (int)n : 1;
+    }
+    if (o.level <= 0) o.level = 6;
+    if (o.line_width <= 0) o.line_width = FAI_COMPRESS_WIDTH;
 
+    char path[1024], fai_path[1024], gzi_path[1024];
+    if (!out_path) {
+        if (suffix_path(path, sizeof(path), in_path, ".gz") < 0) return -1;
+        out_path = path;
+    }
+    if (strcmp(in_path, out_path) == 0) return -1;
+    if (suffix_path(fai_path, sizeof(fai_path), out_path, ".fai") < 0) return -1;
+    if (suffix_path(gzi_path, sizeof(gzi_path), out_path, ".gzi") < 0) return -1;
 
-        free(search_pattern);
+    fai_zwriter_t w;
+    memset(&w, 0, sizeof(w));
+    w.format = format;
+    w.n_threads = o.n_threads;
+    w.width = o.line_width;
+    w.align = o.align_records;
+    w.wave_size = o.n_threads * FAI_COMPRESS_WAVE;
+    w.bol = 1;
 
-        if (!seq_start) {
-            // Sequence not found in this block - we may need to read more blocks
-            // For now, return NULL
-            free(block_buffer);
-            free(seq);
-            return NULL;
-        }
+    // gzread passes uncompressed input through, so one path reads all kinds.
+    // The input's first chunk is read before the outputs are created, so
+    // an input that cannot be read leaves existing outputs alone.
+    gzFile in = gzopen(in_path, "rb");
+    char *buf = malloc(FAI_COMPRESS_READ);
+    if (in) gzbuffer(in, FAI_COMPRESS_READ);
+    int n = in && buf ? gzread(in, buf, FAI_COMPRESS_READ) : -1;
+    if (n < 0) {
+        free(buf);
+        if (in) gzclose(in);
+        return -1;
+    }
 
-        // Skip to the end of the header line
-        char *line_end = strchr(seq_start, '\n');
-        if (!line_end) {
-            free(block_buffer);
-            free(seq);
-            return NULL;
+    w.out = fopen(out_path, "wb");
+    w.fai = w.out ? fopen(fai_path, "w") : NULL;
+    int created = w.out != NULL;
+    int ret = w.out && w.fai ? 0 : -1;
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        if (fai_zwave_init(&w.waves[i], w.wave_size, w.n_threads, o.level) < 0) ret = -1;
+    }
+
+    while (ret == 0 && n > 0) {
+        if (fz_feed(&w, buf, n) < 0) ret = -1;
+        else n = gzread(in, buf, FAI_COMPRESS_READ);
+    }
+    if (ret == 0 && (n < 0 || fz_finish(&w) < 0)) ret = -1;
+
+    // Close the last block, then write both waves in order and the EOF marker
+    if (ret == 0) {
+        fai_zwave_t *wave = &w.waves[w.cur];
+        fai_zblock_t *b = &wave->blocks[wave->n];
+        if (b->in_len > 0) {
+            b->uoffset = w.block_uoffset;
+            wave->n++;
         }
+        if (fz_write_wave(&w, &w.waves[!w.cur]) < 0) ret = -1;
+        else fai_zwave_start(wave, w.n_threads);
+    }
+    // After a failure this only joins the threads still running
+    for (int i = 0; i < 2; i++) {
+        if (fz_write_wave(&w, &w.waves[i ? w.cur : !w.cur]) < 0) ret = -1;
+    }
+    if (ret == 0 && fwrite(bgzf_eof, 1, sizeof(bgzf_eof), w.out) != sizeof(bgzf_eof)) ret = -1;
 
-        char *seq_data = line_end + 1;
+    if (w.out && fclose(w.out) != 0) ret = -1;
+    if (w.fai && fclose(w.fai) != 0) ret = -1;
+    if (ret == 0 && write_gzi_index(&w.gzi, gzi_path) < 0) ret = -1;
+    if (ret < 0 && created) {
+        // The archive was truncated, so its old indexes go with it
+        unlink(out_path);
+        unlink(fai_path);
+        unlink(gzi_path);
+    }
 
-        // Skip to the target position in the sequence
-        hts_pos_t current_pos = 0;
-        char *current_ptr = seq_data;
+    for (int i = 0; i < 2; i++) fai_zwave_free(&w.waves[i], w.wave_size, w.n_threads);
+    free(w.gzi.entries);
+    free(w.hdr);
+    free(buf);
+    if (in) gzclose(in);
+    return ret;
+}
 
-        // Skip to start position
-        while (current_pos < p_beg_i && *current_ptr) {
-            if (*current_ptr != '\n' && *current_ptr != '\r' && *current_ptr != '>' && *current_ptr != '+') {
-                current_pos++;
-            }
-            current_ptr++;
-        }
+// Layout tag for an entry's .fai line lengths. A sequence that fits on its
+// first line is contiguous whatever the terminator.
+static uint16_t entry_layout(const faidx1_t *e) {
+    if (e->len <= e->line_blen) return FAI_LAYOUT_SINGLE;
+    if (e->line_len == e->line_blen + 1) return FAI_LAYOUT_LF;
+    if (e->line_len == e->line_blen + 2) return FAI_LAYOUT_CRLF;
+    return FAI_LAYOUT_IRREGULAR;
+}
 
-        // Read the sequence
-        hts_pos_t read_len = 0;
-        while (read_len < seq_len && *current_ptr && current_pos < p_end_i) {
-            if (*current_ptr == '\n' || *current_ptr == '\r') {
-                current_ptr++;
-                continue;
-            }
-            if (*current_ptr == '>' || *current_ptr == '+') {
-                break; // Hit next sequence
-            }
-            
-            seq[read_len++] = *current_ptr;
-            current_pos++;
-            current_ptr++;
-        }
-        
-        seq[read_len] = '\0';
-        if (len) *len = read_len;
-        
-        free(block_buffer);
-        return seq;
-    } else {
-        fseek(reader->fp, entry->seq_offset, SEEK_SET);
-        
-        // Skip to the correct position
-        hts_pos_t pos = 0;
-        hts_pos_t line_pos = 0;
-        int c;
+// De-lining kernels (fai_kernels): the common line widths get copies of the
+// strided kernel compiled with constant widths
+enum {
+    FAI_KERNEL_GENERIC,
+    FAI_KERNEL_SINGLE,
+    FAI_KERNEL_LF60, FAI_KERNEL_LF70, FAI_KERNEL_LF80,
+    FAI_KERNEL_CRLF60, FAI_KERNEL_CRLF70, FAI_KERNEL_CRLF80
+};
+
+static uint16_t entry_kernel(const faidx1_t *e) {
+    int width = e->line_blen == 60 ? 0 : e->line_blen == 70 ? 1 : e->line_blen == 80 ? 2 : -1;
+    switch (e->layout) {
+    case FAI_LAYOUT_SINGLE:
+        return FAI_KERNEL_SINGLE;
+    case FAI_LAYOUT_LF:
+        return width < 0 ? FAI_KERNEL_GENERIC : FAI_KERNEL_LF60 + width;
+    case FAI_LAYOUT_CRLF:
+        return width < 0 ? FAI_KERNEL_GENERIC : FAI_KERNEL_CRLF60 + width;
+    default:
+        return FAI_KERNEL_GENERIC;
+    }
+}
+
+// Parse a .fai into meta's hash; closes fp
+static int load_fai_stream(faidx_meta_t *meta, FILE *fp) {
+    // Lines are read whole, however long the names get
+    char *line = NULL;
+    size_t line_cap = 0;
+    int idx = 0;
+    
+    while (getline(&line, &line_cap, fp) > 0) {
+        char *name = strtok(line, "\t");
+        char *len_str = strtok(NULL, "\t");
+        char *offset_str = strtok(NULL, "\t");
+        char *line_blen_str = strtok(NULL, "\t");
+        char *line_len_str = strtok(NULL, "\t\r\n");
+        char *qual_offset_str = strtok(NULL, "\t\r\n");
         
-        while (pos < p_beg_i && (c = fgetc(reader->fp)) != EOF) {
-            if (c == '\n') {
-                line_pos = 0;
-            } else if (c != '\r') {
-                pos++;
-                line_pos++;
-            }
+        if (!name || !len_str || !offset_str || !line_blen_str || !line_len_str) {
+            continue;
         }
         
-        // Read the sequence
-        hts_pos_t read_len = 0;
-        while (read_len < seq_len && (c = fgetc(reader->fp)) != EOF) {
-            if (c == '\n' || c == '\r') {
-                continue;
-            }
-            if (c == '>' || c == '+') {
-                break; // Hit next sequence
-            }
-            seq[read_len++] = c;
+        faidx1_t val;
+        memset(&val, 0, sizeof(val));   // Entries are written verbatim to .fai.bin
+        val.id = idx;
+        val.len = atoll(len_str);
+        val.seq_offset = atoll(offset_str);
+        val.line_blen = atoi(line_blen_str);
+        val.line_len = atoi(line_len_str);
+        val.qual_offset = qual_offset_str ? atoll(qual_offset_str) : 0;
+        val.layout = entry_layout(&val);
+        val.kernel = entry_kernel(&val);
+        
+        if (hash_put(meta->hash, name, val) < 0) {
+            free(line);
+            fclose(fp);
+            return -1;
         }
         
-        seq[read_len] = '\0';
-        if (len) *len = read_len;
-        return seq;
+        idx++;
     }
+    free(line);
+    fclose(fp);
+    
+    if (hash_build(meta->hash) < 0) return -1;
+    
+    meta->n = idx;
+    return 0;
 }
 
-char *faidx_reader_fetch_qual(faidx_reader_t *reader, const char *c_name,
-                            hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
-    if (!reader || reader->meta->format != FAI_FASTQ) return NULL;
-    // Quality string fetching not implemented in this minimal version
-    if (len) *len = 0;
-    return NULL;
+static int load_fai_index(faidx_meta_t *meta, const char *fai_path) {
+    FILE *fp = fopen(fai_path, "r");
+    if (!fp) return -1;
+    return load_fai_stream(meta, fp);
 }
 
-// BGZF support functions
-gzi_index_t *load_gzi_index(const char *gzi_path) {
-    if (!gzi_path) return NULL;
-    
-    FILE *fp = fopen(gzi_path, "rb");
-    if (!fp) return NULL;
-    
-    gzi_index_t *index = malloc(sizeof(gzi_index_t));
+// Parse a .gzi block table; closes fp
+static gzi_index_t *load_gzi_stream(FILE *fp) {
+    gzi_index_t *index = calloc(1, sizeof(gzi_index_t));
     if (!index) {
         fclose(fp);
         return NULL;
@@ -603,107 +1540,4366 @@ gzi_index_t *load_gzi_index(const char *gzi_path) {
     
     // Read number of entries (uint64_t)
     uint64_t n_entries;
-    if (fread(&n_entries, sizeof(uint64_t), 1, fp) != 1) {
+    if (fread(&n_entries, sizeof(uint64_t), 1, fp) != 1 || n_entries >= INT32_MAX) {
         free(index);
         fclose(fp);
         return NULL;
     }
     
-    index->n_entries = (int)n_entries;
-    index->entries = malloc(sizeof(gzi_entry_t) * index->n_entries);
+    // The .gzi omits the first block, which always starts at (0, 0)
+    int m = (int)n_entries + 1;
+    index->entries = malloc(sizeof(gzi_entry_t) * m);
     if (!index->entries) {
         free(index);
         fclose(fp);
         return NULL;
     }
+    index->entries[0].compressed_offset = 0;
+    index->entries[0].uncompressed_offset = 0;
+    index->n_entries = 1;
     
     // Read all entries (pairs of uint64_t: compressed_offset, uncompressed_offset)
-    for (int i = 0; i < index->n_entries; i++) {
-        if (fread(&index->entries[i].compressed_offset, sizeof(uint64_t), 1, fp) != 1 ||
-            fread(&index->entries[i].uncompressed_offset, sizeof(uint64_t), 1, fp) != 1) {
-            free(index->entries);
-            free(index);
+    for (uint64_t i = 0; i < n_entries; i++) {
+        uint64_t pair[2];
+        if (fread(pair, sizeof(uint64_t), 2, fp) != 2) {
+            destroy_gzi_index(index);
             fclose(fp);
             return NULL;
         }
+        if (pair[0] == 0) continue;
+        gzi_push(index, &m, pair[0], pair[1]);
     }
     
     fclose(fp);
     return index;
 }
 
-void destroy_gzi_index(gzi_index_t *index) {
-    if (index) {
-        if (index->entries) {
-            free(index->entries);
-        }
-        free(index);
+// Block cache implementation
+#define BGZF_CACHE_SHARDS 16
+
+static bgzf_cache_t *bgzf_cache_init(int n_shards) {
+    bgzf_cache_t *c = calloc(1, sizeof(bgzf_cache_t));
+    if (!c) return NULL;
+    c->shards = calloc(n_shards, sizeof(bgzf_cache_shard_t));
+    if (!c->shards) {
+        free(c);
+        return NULL;
+    }
+    for (int i = 0; i < n_shards; i++) {
+        pthread_mutex_init(&c->shards[i].mutex, NULL);
     }
+    c->n_shards = n_shards;
+    return c;
 }
 
-uint64_t find_bgzf_block(gzi_index_t *index, uint64_t uncompressed_offset) {
-    if (!index || index->n_entries == 0) return 0;
-    
-    // Binary search for the appropriate block
-    int left = 0, right = index->n_entries - 1;
-    int best = 0;
-    
-    while (left <= right) {
-        int mid = left + (right - left) / 2;
-        
-        if (index->entries[mid].uncompressed_offset <= uncompressed_offset) {
-            best = mid;
-            left = mid + 1;
-        } else {
-            right = mid - 1;
+static void bgzf_cache_destroy(bgzf_cache_t *c) {
+    if (!c) return;
+    for (int i = 0; i < c->n_shards; i++) {
+        bgzf_cache_shard_t *sh = &c->shards[i];
+        for (bgzf_cache_entry_t *e = sh->head, *next; e; e = next) {
+            next = e->next;
+            free(e);
         }
+        free(sh->buckets);
+        pthread_mutex_destroy(&sh->mutex);
     }
-    
-    return index->entries[best].compressed_offset;
+    free(c->shards);
+    free(c);
 }
 
-int bgzf_read_block(gzFile fp, uint64_t coffset, char *buffer, int buffer_size) {
-    if (!fp || !buffer) return -1;
-    
-    // For this minimal implementation, we'll use a simplified approach:
-    // Since we're dealing with BGZF and we know the offset, we'll just read
-    // a large chunk of decompressed data from that point
-    
-    // Reset to beginning of file and read from there
-    if (gzseek(fp, 0, SEEK_SET) == -1) {
-        return -1;
+static inline bgzf_cache_shard_t *bgzf_cache_shard(const bgzf_cache_t *c, uint64_t coffset) {
+    return &c->shards[((coffset * 0x9e3779b97f4a7c15ULL) >> 32) % c->n_shards];
+}
+
+static inline uint32_t bgzf_cache_bucket(const bgzf_cache_shard_t *sh, uint64_t coffset) {
+    return (uint32_t)((coffset * 0x9e3779b97f4a7c15ULL) >> 40) & (sh->n_buckets - 1);
+}
+
+static bgzf_cache_entry_t *bgzf_cache_find(bgzf_cache_shard_t *sh, uint64_t coffset) {
+    if (!sh->buckets) return NULL;
+    bgzf_cache_entry_t *e = sh->buckets[bgzf_cache_bucket(sh, coffset)];
+    while (e && e->coffset != coffset) e = e->hnext;
+    return e;
+}
+
+static void bgzf_cache_unlink(bgzf_cache_shard_t *sh, bgzf_cache_entry_t *e) {
+    if (e->prev) e->prev->next = e->next; else sh->head = e->next;
+    if (e->next) e->next->prev = e->prev; else sh->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void bgzf_cache_push_front(bgzf_cache_shard_t *sh, bgzf_cache_entry_t *e) {
+    e->prev = NULL;
+    e->next = sh->head;
+    if (sh->head) sh->head->prev = e; else sh->tail = e;
+    sh->head = e;
+}
+
+// Drop least recently used entries until the shard fits its budget
+static void bgzf_cache_evict(bgzf_cache_shard_t *sh) {
+    while (sh->tail && sh->bytes > sh->capacity) {
+        bgzf_cache_entry_t *e = sh->tail;
+        bgzf_cache_entry_t **pp = &sh->buckets[bgzf_cache_bucket(sh, e->coffset)];
+        while (*pp != e) pp = &(*pp)->hnext;
+        *pp = e->hnext;
+        bgzf_cache_unlink(sh, e);
+        sh->bytes -= e->len;
+        sh->n_entries--;
+        sh->evictions++;
+        free(e);
     }
+}
+
+static int bgzf_cache_grow(bgzf_cache_shard_t *sh) {
+    uint32_t n_buckets = sh->n_buckets ? sh->n_buckets * 2 : 64;
+    bgzf_cache_entry_t **buckets = calloc(n_buckets, sizeof(*buckets));
+    if (!buckets) return -1;
     
-    // Read a large chunk of decompressed data
-    int decompressed_size = gzread(fp, buffer, buffer_size - 1);
-    if (decompressed_size < 0) {
-        return -1;
+    sh->n_buckets = n_buckets;
+    for (bgzf_cache_entry_t *e = sh->head; e; e = e->next) {
+        uint32_t b = bgzf_cache_bucket(sh, e->coffset);
+        e->hnext = buckets[b];
+        buckets[b] = e;
     }
-    
-    buffer[decompressed_size] = '\0';
-    return decompressed_size;
+    free(sh->buckets);
+    sh->buckets = buckets;
+    return 0;
 }
 
-int faidx_meta_nseq(const faidx_meta_t *meta) {
-    return meta ? meta->n : 0;
+static inline int bgzf_cache_enabled(const bgzf_cache_t *c) {
+    return c && __atomic_load_n(&c->capacity, __ATOMIC_RELAXED) > 0;
 }
 
-const char *faidx_meta_iseq(const faidx_meta_t *meta, int i) {
-    return (meta && i >= 0 && i < meta->n) ? meta->name[i] : NULL;
+// Copy n bytes at offset off of the cached block; returns 1 on a hit
+static int bgzf_cache_copy(bgzf_cache_t *c, uint64_t coffset, uint64_t off,
+                           char *dst, uint64_t n) {
+    bgzf_cache_shard_t *sh = bgzf_cache_shard(c, coffset);
+    pthread_mutex_lock(&sh->mutex);
+    bgzf_cache_entry_t *e = bgzf_cache_find(sh, coffset);
+    if (!e || off + n > (uint64_t)e->len) {
+        sh->misses++;
+        pthread_mutex_unlock(&sh->mutex);
+        return 0;
+    }
+    if (sh->head != e) {
+        bgzf_cache_unlink(sh, e);
+        bgzf_cache_push_front(sh, e);
+    }
+    sh->hits++;
+    memcpy(dst, e->data + off, n);
+    pthread_mutex_unlock(&sh->mutex);
+    return 1;
 }
 
-hts_pos_t faidx_meta_seq_len(const faidx_meta_t *meta, const char *seq) {
-    if (!meta || !seq) return -1;
-    
-    faidx1_t *entry = hash_get(meta->hash, seq);
-    return entry ? entry->len : -1;
+static int bgzf_cache_contains(bgzf_cache_t *c, uint64_t coffset) {
+    bgzf_cache_shard_t *sh = bgzf_cache_shard(c, coffset);
+    pthread_mutex_lock(&sh->mutex);
+    int found = bgzf_cache_find(sh, coffset) != NULL;
+    pthread_mutex_unlock(&sh->mutex);
+    return found;
 }
 
-int faidx_meta_has_seq(const faidx_meta_t *meta, const char *seq) {
-    if (!meta || !seq) return 0;
+static void bgzf_cache_put(bgzf_cache_t *c, uint64_t coffset, const char *data, int len) {
+    bgzf_cache_shard_t *sh = bgzf_cache_shard(c, coffset);
+    pthread_mutex_lock(&sh->mutex);
+    if ((uint64_t)len > sh->capacity || bgzf_cache_find(sh, coffset)) {
+        pthread_mutex_unlock(&sh->mutex);
+        return;
+    }
+    if (sh->n_entries >= sh->n_buckets && bgzf_cache_grow(sh) < 0) {
+        pthread_mutex_unlock(&sh->mutex);
+        return;
+    }
     
-    faidx1_t *entry = hash_get(meta->hash, seq);
-    return entry != NULL;
+    bgzf_cache_entry_t *e = malloc(sizeof(bgzf_cache_entry_t) + len);
+    if (!e) {
+        pthread_mutex_unlock(&sh->mutex);
+        return;
+    }
+    e->coffset = coffset;
+    e->len = len;
+    memcpy(e->data, data, len);
+    
+    uint32_t b = bgzf_cache_bucket(sh, coffset);
+    e->hnext = sh->buckets[b];
+    sh->buckets[b] = e;
+    bgzf_cache_push_front(sh, e);
+    sh->bytes += len;
+    sh->n_entries++;
+    bgzf_cache_evict(sh);
+    pthread_mutex_unlock(&sh->mutex);
+}
+
+static void bgzf_cache_set_capacity(bgzf_cache_t *c, uint64_t bytes) {
+    __atomic_store_n(&c->capacity, bytes, __ATOMIC_RELAXED);
+    for (int i = 0; i < c->n_shards; i++) {
+        bgzf_cache_shard_t *sh = &c->shards[i];
+        pthread_mutex_lock(&sh->mutex);
+        sh->capacity = bytes / c->n_shards;
+        bgzf_cache_evict(sh);
+        pthread_mutex_unlock(&sh->mutex);
+    }
+}
+
+static void bgzf_cache_stats(const bgzf_cache_t *c, faidx_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!c) return;
+    stats->capacity = __atomic_load_n(&c->capacity, __ATOMIC_RELAXED);
+    for (int i = 0; i < c->n_shards; i++) {
+        bgzf_cache_shard_t *sh = &c->shards[i];
+        pthread_mutex_lock(&sh->mutex);
+        stats->hits += sh->hits;
+        stats->misses += sh->misses;
+        stats->evictions += sh->evictions;
+        stats->bytes += sh->bytes;
+        pthread_mutex_unlock(&sh->mutex);
+    }
+}
+
+// Public API implementation
+// Packed sequence store
+#define FAI_PACK_CHUNK (1 << 20)
+
+static const uint8_t pack_code[256] = {
+    ['A'] = 1, ['C'] = 2, ['G'] = 3, ['T'] = 4,
+    ['a'] = 1, ['c'] = 2, ['g'] = 3, ['t'] = 4,
+};
+
+// Four bases for every packed byte, built once
+static char pack_lut[256][4];
+static pthread_once_t pack_lut_once = PTHREAD_ONCE_INIT;
+
+static void pack_lut_init(void) {
+    for (int b = 0; b < 256; b++) {
+        for (int k = 0; k < 4; k++) pack_lut[b][k] = "ACGT"[(b >> (2 * k)) & 3];
+    }
+}
+
+static void pack_destroy(fai_pack_t *pack) {
+    if (!pack) return;
+    free(pack->words);
+    free(pack->exc);
+    free(pack->mask);
+    free(pack->seqs);
+    free(pack);
+}
+
+// Extend the last run of a sequence if it ends at pos, otherwise append one
+static int pack_run_add(fai_pack_run_t **runs, uint64_t *n, uint64_t *m, uint64_t first,
+                        uint64_t pos, char base) {
+    if (*n > first && (*runs)[*n - 1].end == pos && (*runs)[*n - 1].base == base) {
+        (*runs)[*n - 1].end = pos + 1;
+        return 0;
+    }
+    if (*n == *m) {
+        uint64_t cap = *m ? *m * 2 : 64;
+        fai_pack_run_t *r = realloc(*runs, cap * sizeof(fai_pack_run_t));
+        if (!r) return -1;
+        *runs = r;
+        *m = cap;
+    }
+    (*runs)[(*n)++] = (fai_pack_run_t){ pos, pos + 1, base };
+    return 0;
+}
+
+// Pack bases [pos, pos + n) of sequence s
+static int pack_chunk(fai_pack_t *pack, fai_pack_seq_t *s, uint64_t pos, const char *buf,
+                      int64_t n) {
+    uint64_t *words = pack->words + s->word_off;
+    for (int64_t k = 0; k < n; k++, pos++) {
+        unsigned char c = buf[k];
+        int code = pack_code[c];
+        if (code) {
+            words[pos >> 5] |= (uint64_t)(code - 1) << (2 * (pos & 31));
+        } else if (pack_run_add(&pack->exc, &pack->n_exc, &pack->m_exc, s->exc_beg, pos,
+                                (char)toupper(c)) < 0) {
+            return -1;
+        }
+        if (islower(c) &&
+            pack_run_add(&pack->mask, &pack->n_mask, &pack->m_mask, s->mask_beg, pos, 0) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Defined with the fetch paths below
+static hts_pos_t fetch_entry(faidx_reader_t *reader, const faidx1_t *e, hts_pos_t beg,
+                             hts_pos_t end, char *buf);
+
+// Decode every sequence once through an ordinary reader
+static fai_pack_t *pack_build(faidx_meta_t *meta) {
+    const simple_hash_t *h = meta->hash;
+    fai_pack_t *pack = calloc(1, sizeof(fai_pack_t));
+    if (!pack) return NULL;
+
+    for (int i = 0; i < h->n_entries; i++) pack->n_words += (h->entries[i].len + 31) / 32;
+    pack->words = calloc(pack->n_words ? pack->n_words : 1, sizeof(uint64_t));
+    pack->seqs = calloc(h->n_entries ? h->n_entries : 1, sizeof(fai_pack_seq_t));
+    char *buf = malloc(FAI_PACK_CHUNK);
+    faidx_reader_t *reader = faidx_reader_create(meta);
+    if (!pack->words || !pack->seqs || !buf || !reader) goto fail;
+
+    uint64_t word_off = 0;
+    for (int i = 0; i < h->n_entries; i++) {
+        const faidx1_t *e = &h->entries[i];
+        fai_pack_seq_t *s = &pack->seqs[e->id];
+        s->word_off = word_off;
+        s->exc_beg = pack->n_exc;
+        s->mask_beg = pack->n_mask;
+        word_off += (e->len + 31) / 32;
+
+        for (uint64_t pos = 0; pos < e->len && e->line_blen; pos += FAI_PACK_CHUNK) {
+            uint64_t end = e->len - pos < FAI_PACK_CHUNK ? e->len : pos + FAI_PACK_CHUNK;
+            // By entry: a lookup by name finds only the first of records sharing one
+            hts_pos_t got = fetch_entry(reader, e, pos, end, buf);
+            if (got != (hts_pos_t)(end - pos) || pack_chunk(pack, s, pos, buf, got) < 0) {
+                goto fail;
+            }
+        }
+        s->exc_end = pack->n_exc;
+        s->mask_end = pack->n_mask;
+    }
+
+    faidx_reader_destroy(reader);
+    free(buf);
+    pthread_once(&pack_lut_once, pack_lut_init);
+    return pack;
+
+fail:
+    faidx_reader_destroy(reader);
+    free(buf);
+    pack_destroy(pack);
+    return NULL;
+}
+
+// First run in [lo, hi) that ends after pos
+static uint64_t pack_run_find(const fai_pack_run_t *runs, uint64_t lo, uint64_t hi, uint64_t pos) {
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (runs[mid].end <= pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Unpack [beg, end) of an entry into dst. Whole packed bytes expand through
+// the lookup table; exceptions and soft-masking are then laid over the top.
+static hts_pos_t pack_fetch(const fai_pack_t *pack, const faidx1_t *entry,
+                            uint64_t beg, uint64_t end, char *dst) {
+    const fai_pack_seq_t *s = &pack->seqs[entry->id];
+    const uint64_t *words = pack->words + s->word_off;
+
+    uint64_t pos = beg;
+    char *out = dst;
+    for (; pos < end && (pos & 3); pos++) {
+        *out++ = "ACGT"[(words[pos >> 5] >> (2 * (pos & 31))) & 3];
+    }
+    for (; end - pos >= 4; pos += 4, out += 4) {
+        memcpy(out, pack_lut[(words[pos >> 5] >> (2 * (pos & 31))) & 0xff], 4);
+    }
+    for (; pos < end; pos++) {
+        *out++ = "ACGT"[(words[pos >> 5] >> (2 * (pos & 31))) & 3];
+    }
+
+    for (uint64_t r = pack_run_find(pack->exc, s->exc_beg, s->exc_end, beg);
+         r < s->exc_end && pack->exc[r].beg < end; r++) {
+        uint64_t a = pack->exc[r].beg > beg ? pack->exc[r].beg : beg;
+        uint64_t b = pack->exc[r].end < end ? pack->exc[r].end : end;
+        memset(dst + (a - beg), pack->exc[r].base, b - a);
+    }
+    for (uint64_t r = pack_run_find(pack->mask, s->mask_beg, s->mask_end, beg);
+         r < s->mask_end && pack->mask[r].beg < end; r++) {
+        uint64_t a = pack->mask[r].beg > beg ? pack->mask[r].beg : beg;
+        uint64_t b = pack->mask[r].end < end ? pack->mask[r].end : end;
+        for (uint64_t k = a; k < b; k++) dst[k - beg] |= 0x20;
+    }
+    return end - beg;
+}
+
+// Binary index sidecar (filename.fai.bin). The header is followed by the
+// entry table, name offsets, hash slots, GZI block table and name arena, in
+// that order; every section but the arena starts on an 8-byte boundary.
+// Tables are stored in native layout, so the header records the byte order
+// and struct sizes and a sidecar from a different platform is ignored.
+#define FAI_BIN_MAGIC "FAIGZBIN"
+#define FAI_BIN_VERSION 3
+#define FAI_BIN_BOM 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;              // FAI_BIN_BOM in the writer's byte order
+    uint32_t entry_size, slot_size;   // sizeof(faidx1_t), sizeof(hash_slot_t)
+    uint32_t format;
+    uint32_t n_slots;
+    uint64_t n_entries, arena_len, n_gzi;
+    uint64_t src_size;                // Sequence file size and mtime when written
+    int64_t src_mtime;
+    uint64_t off_entries, off_name_off, off_slots, off_gzi, off_arena;
+    uint64_t file_size;
+} fai_bin_header_t;
+
+static inline uint64_t fai_bin_align(uint64_t off) {
+    return (off + 7) & ~(uint64_t)7;
+}
+
+// Derive the section offsets from the counts in h
+static void fai_bin_layout(fai_bin_header_t *h) {
+    uint64_t off = fai_bin_align(sizeof(*h));
+    h->off_entries = off;
+    off = fai_bin_align(off + h->n_entries * sizeof(faidx1_t));
+    h->off_name_off = off;
+    off = fai_bin_align(off + h->n_entries * sizeof(uint64_t));
+    h->off_slots = off;
+    off = fai_bin_align(off + (uint64_t)h->n_slots * sizeof(hash_slot_t));
+    h->off_gzi = off;
+    off += h->n_gzi * sizeof(gzi_entry_t);
+    h->off_arena = off;
+    h->file_size = off + h->arena_len;
+}
+
+static int fai_bin_path(const faidx_meta_t *meta, char *path, size_t size) {
+    int n = snprintf(path, size, "%s.bin", meta->fai_path);
+    return (n > 0 && (size_t)n < size) ? 0 : -1;
+}
+
+// Pad with zeros up to off, then write n bytes
+static int fai_bin_put(FILE *fp, uint64_t *pos, uint64_t off, const void *data, uint64_t n) {
+    static const char zero[8];
+    uint64_t pad = off - *pos;
+    if (pad && fwrite(zero, 1, pad, fp) != pad) return -1;
+    if (n && fwrite(data, 1, n, fp) != n) return -1;
+    *pos = off + n;
+    return 0;
+}
+
+int faidx_meta_write_bin(const faidx_meta_t *meta) {
+    if (!meta || !meta->hash || !meta->hash->slots) return -1;
+    if (meta->is_bgzf && !meta->gzi_index) return -1;
+
+    struct stat st;
+    if (stat(meta->fasta_path, &st) != 0) return -1;
+
+    const simple_hash_t *h = meta->hash;
+    const gzi_index_t *gzi = meta->is_bgzf ? meta->gzi_index : NULL;
+
+    fai_bin_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, FAI_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = FAI_BIN_VERSION;
+    hdr.byte_order = FAI_BIN_BOM;
+    hdr.entry_size = sizeof(faidx1_t);
+    hdr.slot_size = sizeof(hash_slot_t);
+    hdr.format = meta->format;
+    hdr.n_slots = h->n_slots;
+    hdr.n_entries = h->n_entries;
+    hdr.arena_len = h->arena_len;
+    hdr.n_gzi = gzi ? gzi->n_entries : 0;
+    hdr.src_size = st.st_size;
+    hdr.src_mtime = st.st_mtime;
+    fai_bin_layout(&hdr);
+
+    // Write to a private name and rename, so concurrent loaders only ever
+    // map a complete file
+    char path[1024], tmp[1100];
+    if (fai_bin_path(meta, path, sizeof(path)) < 0) return -1;
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+
+    uint64_t pos = 0;
+    int ret = -1;
+    if (fai_bin_put(fp, &pos, 0, &hdr, sizeof(hdr)) == 0 &&
+        fai_bin_put(fp, &pos, hdr.off_entries, h->entries, hdr.n_entries * sizeof(faidx1_t)) == 0 &&
+        fai_bin_put(fp, &pos, hdr.off_name_off, h->name_off, hdr.n_entries * sizeof(uint64_t)) == 0 &&
+        fai_bin_put(fp, &pos, hdr.off_slots, h->slots, (uint64_t)hdr.n_slots * sizeof(hash_slot_t)) == 0 &&
+        fai_bin_put(fp, &pos, hdr.off_gzi, gzi ? gzi->entries : NULL, hdr.n_gzi * sizeof(gzi_entry_t)) == 0 &&
+        fai_bin_put(fp, &pos, hdr.off_arena, h->arena, hdr.arena_len) == 0) {
+        ret = 0;
+    }
+    if (fclose(fp) != 0) ret = -1;
+    if (ret == 0 && rename(tmp, path) != 0) ret = -1;
+    if (ret < 0) unlink(tmp);
+    return ret;
+}
+
+// Check a mapped sidecar against the sequence file and its own layout. The
+// tables are used in place, so every offset a lookup follows is bounded here.
+static int fai_bin_valid(const faidx_meta_t *meta, const char *base, uint64_t size,
+                         const struct stat *src, int lazy) {
+    if (size < sizeof(fai_bin_header_t)) return 0;
+
+    const fai_bin_header_t *hdr = (const fai_bin_header_t *)base;
+    if (memcmp(hdr->magic, FAI_BIN_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != FAI_BIN_VERSION || hdr->byte_order != FAI_BIN_BOM ||
+        hdr->entry_size != sizeof(faidx1_t) || hdr->slot_size != sizeof(hash_slot_t)) {
+        return 0;
+    }
+    if (hdr->format != (uint32_t)meta->format ||
+        hdr->src_size != (uint64_t)src->st_size || hdr->src_mtime != (int64_t)src->st_mtime) {
+        return 0;
+    }
+
+    // Linear probing needs an empty slot to stop at
+    if (hdr->n_entries > INT_MAX || hdr->n_gzi > INT_MAX || hdr->arena_len > size ||
+        hdr->n_slots < 16 || (hdr->n_slots & (hdr->n_slots - 1)) ||
+        hdr->n_slots <= hdr->n_entries) {
+        return 0;
+    }
+    if (meta->is_bgzf ? hdr->n_gzi == 0 : hdr->n_gzi != 0) return 0;
+
+    fai_bin_header_t want = *hdr;
+    fai_bin_layout(&want);
+    if (want.off_entries != hdr->off_entries || want.off_name_off != hdr->off_name_off ||
+        want.off_slots != hdr->off_slots || want.off_gzi != hdr->off_gzi ||
+        want.off_arena != hdr->off_arena || want.file_size != hdr->file_size ||
+        hdr->file_size != size) {
+        return 0;
+    }
+    if (hdr->arena_len && base[size - 1] != '\0') return 0;
+    
+    // Checking every table entry would page the whole sidecar in; a lazy load
+    // leaves that to hash_key and hash_get
+    if (lazy) return 1;
+
+    const uint64_t *name_off = (const uint64_t *)(base + hdr->off_name_off);
+    for (uint64_t i = 0; i < hdr->n_entries; i++) {
+        if (name_off[i] >= hdr->arena_len) return 0;
+    }
+    const hash_slot_t *slots = (const hash_slot_t *)(base + hdr->off_slots);
+    for (uint32_t k = 0; k < hdr->n_slots; k++) {
+        if (slots[k].idx > hdr->n_entries) return 0;
+    }
+    return 1;
+}
+
+// Point meta's tables into a current filename.fai.bin. Returns -1, leaving
+// meta untouched, if there is none or it does not match the sequence file.
+static int load_bin_index(faidx_meta_t *meta, int lazy) {
+    char path[1024];
+    struct stat src, st;
+    if (fai_bin_path(meta, path, sizeof(path)) < 0 || stat(meta->fasta_path, &src) != 0) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(fai_bin_header_t)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const char *base = map;
+    gzi_index_t *gzi = NULL;
+    if (!fai_bin_valid(meta, base, st.st_size, &src, lazy)) goto fail;
+
+    const fai_bin_header_t *hdr = (const fai_bin_header_t *)base;
+    if (hdr->n_gzi) {
+        gzi = malloc(sizeof(gzi_index_t));
+        if (!gzi) goto fail;
+        gzi->entries = (gzi_entry_t *)(base + hdr->off_gzi);
+        gzi->n_entries = hdr->n_gzi;
+    }
+
+    // Read-only from here on: lookups never write to the tables
+    simple_hash_t *h = meta->hash;
+    h->entries = (faidx1_t *)(base + hdr->off_entries);
+    h->name_off = (uint64_t *)(base + hdr->off_name_off);
+    h->n_entries = h->m_entries = hdr->n_entries;
+    h->arena = (char *)(base + hdr->off_arena);
+    h->arena_len = h->arena_cap = hdr->arena_len;
+    h->slots = (hash_slot_t *)(base + hdr->off_slots);
+    h->n_slots = hdr->n_slots;
+
+    meta->n = hdr->n_entries;
+    meta->gzi_index = gzi;
+    meta->bin_map = base;
+    meta->bin_size = st.st_size;
+    return 0;
+
+fail:
+    free(gzi);
+    munmap(map, st.st_size);
+    return -1;
+}
+
+// Swap the heap tables of a text load for the sidecar just written, so
+// only the pages lookups touch stay resident. On failure meta is unchanged.
+static int meta_remap_bin(faidx_meta_t *meta) {
+    simple_hash_t *hash = meta->hash;
+    gzi_index_t *gzi = meta->gzi_index;
+    meta->hash = hash_init();
+    meta->gzi_index = NULL;
+    if (meta->hash && load_bin_index(meta, 1) == 0) {
+        hash_destroy(hash);
+        destroy_gzi_index(gzi);
+        return 0;
+    }
+    
+    free(meta->hash);
+    meta->hash = hash;
+    meta->gzi_index = gzi;
+    return -1;
+}
+
+// Table placement: FAI_HUGE, FAI_NUMA and custom allocators
+#define FAI_HUGE_MIN (2 << 20)           // Smaller tables gain nothing from huge pages
+
+struct fai_placed_t {
+    void *ptr;
+    size_t size;
+    void **field;                // Pointer in meta's own tables, NULL for copies
+};
+
+struct fai_replica_t {
+    simple_hash_t *hash;         // Name index and GZI table on this node
+    gzi_index_t *gzi;
+    bgzf_cache_t *cache;
+    int local;                   // The loading node: the fields are meta's own
+};
+
+static void *default_alloc(void *ctx, size_t size, int node, int huge) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (huge && size >= FAI_HUGE_MIN) madvise(p, size, MADV_HUGEPAGE);
+#endif
+#ifdef SYS_mbind
+    // MPOL_PREFERRED: the node's memory while it has some, any node after that
+    if (node >= 0 && node < 64) {
+        unsigned long mask = 1UL << node;
+        syscall(SYS_mbind, p, size, 1, &mask, sizeof(mask) * 8 + 1, 0);
+    }
+#endif
+    return p;
+}
+
+static void default_free(void *ctx, void *ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+static const faidx_allocator_t default_allocator = { default_alloc, default_free, NULL };
+static faidx_allocator_t fai_allocator = { default_alloc, default_free, NULL };
+
+void faidx_set_allocator(const faidx_allocator_t *allocator) {
+    fai_allocator = allocator && allocator->alloc && allocator->free ? *allocator : default_allocator;
+}
+
+static int allocator_is_default(void) {
+    return fai_allocator.alloc == default_alloc;
+}
+
+// Online NUMA nodes, as one more than the highest node id; 1 without NUMA
+static int numa_node_count(void) {
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    if (!fp) return 1;
+    
+    // A list of ranges such as "0-1" or "0,2-3"
+    int max = 0, lo, hi;
+    char sep;
+    while (fscanf(fp, "%d", &lo) == 1) {
+        hi = lo;
+        if (fscanf(fp, "%c", &sep) == 1 && sep == '-' && fscanf(fp, "%d%c", &hi, &sep) < 1) break;
+        if (hi > max) max = hi;
+        if (sep != ',' && sep != '-') break;
+    }
+    fclose(fp);
+    return max + 1;
+}
+
+static int numa_current_node(void) {
+#ifdef SYS_getcpu
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) return (int)node;
+#endif
+    return 0;
+}
+
+// Copy size bytes of src into allocator memory, recording it for release
+static void *place(faidx_meta_t *meta, const void *src, size_t size, int node, int huge,
+                   void **field) {
+    if (meta->n_placed == meta->m_placed) {
+        int m = meta->m_placed ? meta->m_placed * 2 : 16;
+        struct fai_placed_t *placed = realloc(meta->placed, m * sizeof(*placed));
+        if (!placed) return NULL;
+        meta->placed = placed;
+        meta->m_placed = m;
+    }
+    
+    size_t n = size ? size : 1;
+    void *p = meta->allocator.alloc(meta->allocator.ctx, n, node, huge);
+    if (!p) return NULL;
+    if (size) memcpy(p, src, size);
+    meta->placed[meta->n_placed++] = (struct fai_placed_t){ p, n, field };
+    return p;
+}
+
+static void placed_release(faidx_meta_t *meta) {
+    for (int i = 0; i < meta->n_placed; i++) {
+        struct fai_placed_t *t = &meta->placed[i];
+        if (t->field) *t->field = NULL;
+        meta->allocator.free(meta->allocator.ctx, t->ptr, t->size);
+    }
+    free(meta->placed);
+    meta->placed = NULL;
+    meta->n_placed = meta->m_placed = 0;
+}
+
+// Copy meta's tables into h and gzi, or into meta's own fields (replacing
+// the heap copies) when h is NULL. Heap blocks are only freed once every
+// copy has been made, so a failure leaves meta's tables as they were.
+static int place_tables(faidx_meta_t *meta, simple_hash_t *h, gzi_index_t *gzi, int node, int huge) {
+    simple_hash_t *src = meta->hash;
+    int own = h == NULL;
+    if (own) {
+        h = src;
+        gzi = meta->gzi_index;
+    } else {
+        *h = *src;
+        if (meta->gzi_index) *gzi = *meta->gzi_index;
+    }
+    
+    int first = meta->n_placed;
+    void *entries = place(meta, src->entries, src->n_entries * sizeof(faidx1_t), node, huge,
+                          own ? (void **)&h->entries : NULL);
+    void *name_off = entries ? place(meta, src->name_off, src->n_entries * sizeof(uint64_t), node,
+                                     huge, own ? (void **)&h->name_off : NULL) : NULL;
+    void *arena = name_off ? place(meta, src->arena, src->arena_len, node, huge,
+                                   own ? (void **)&h->arena : NULL) : NULL;
+    void *slots = arena ? place(meta, src->slots, (size_t)src->n_slots * sizeof(hash_slot_t), node,
+                                huge, own ? (void **)&h->slots : NULL) : NULL;
+    void *blocks = slots;
+    if (slots && meta->gzi_index) {
+        blocks = place(meta, meta->gzi_index->entries,
+                       meta->gzi_index->n_entries * sizeof(gzi_entry_t), node, huge,
+                       own ? (void **)&gzi->entries : NULL);
+    }
+    if (!blocks) {
+        for (int i = first; i < meta->n_placed; i++) {
+            meta->allocator.free(meta->allocator.ctx, meta->placed[i].ptr, meta->placed[i].size);
+        }
+        meta->n_placed = first;
+        return -1;
+    }
+    
+    // Sidecar-backed tables belong to the mapping
+    if (own && !meta->bin_map) {
+        free(h->entries);
+        free(h->name_off);
+        free(h->arena);
+        free(h->slots);
+        if (gzi) free(gzi->entries);
+    }
+    h->entries = entries;
+    h->name_off = name_off;
+    h->arena = arena;
+    h->slots = slots;
+    h->m_entries = h->n_entries;
+    h->arena_cap = h->arena_len;
+    if (gzi) gzi->entries = blocks;
+    return 0;
+}
+
+static void replicas_destroy(faidx_meta_t *meta) {
+    for (int i = 0; i < meta->n_replicas; i++) {
+        struct fai_replica_t *r = &meta->replicas[i];
+        if (r->local) continue;
+        free(r->hash);
+        free(r->gzi);
+        bgzf_cache_destroy(r->cache);
+    }
+    free(meta->replicas);
+    meta->replicas = NULL;
+    meta->n_replicas = 0;
+}
+
+// Copy the name index, GZI table and an empty block cache to every node
+static int replicate(faidx_meta_t *meta, int n_nodes, int huge) {
+    meta->replicas = calloc(n_nodes, sizeof(struct fai_replica_t));
+    if (!meta->replicas) return -1;
+    meta->n_replicas = n_nodes;
+    
+    int here = numa_current_node();
+    for (int node = 0; node < n_nodes; node++) {
+        struct fai_replica_t *r = &meta->replicas[node];
+        if (node == here) {
+            *r = (struct fai_replica_t){ meta->hash, meta->gzi_index, meta->cache, 1 };
+            continue;
+        }
+        r->hash = malloc(sizeof(simple_hash_t));
+        r->gzi = meta->gzi_index ? malloc(sizeof(gzi_index_t)) : NULL;
+        r->cache = meta->cache ? bgzf_cache_init(BGZF_CACHE_SHARDS) : NULL;
+        if (!r->hash || (meta->gzi_index && !r->gzi) || (meta->cache && !r->cache) ||
+            place_tables(meta, r->hash, r->gzi, node, huge) < 0) {
+            replicas_destroy(meta);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Move meta's large tables into allocator memory once loading is done.
+// Placement is an optimisation: on failure the heap tables stay.
+static void meta_place(faidx_meta_t *meta, int flags) {
+    int huge = (flags & FAI_HUGE) != 0;
+    if (!(flags & (FAI_HUGE | FAI_NUMA)) && allocator_is_default()) return;
+    meta->allocator = fai_allocator;
+    
+    if (!meta->bin_map) place_tables(meta, NULL, NULL, -1, huge);
+    if (meta->pack) {
+        uint64_t *words = place(meta, meta->pack->words, meta->pack->n_words * sizeof(uint64_t),
+                                -1, huge, (void **)&meta->pack->words);
+        if (words) {
+            free(meta->pack->words);
+            meta->pack->words = words;
+        }
+    }
+    
+    int n_nodes = numa_node_count();
+    if ((flags & FAI_NUMA) && n_nodes > 1) replicate(meta, n_nodes, huge);
+}
+
+int faidx_meta_numa_nodes(const faidx_meta_t *meta) {
+    return meta ? meta->n_replicas : 0;
+}
+
+// A meta with its paths and an empty hash, or NULL
+static faidx_meta_t *meta_alloc(const char *filename, fai_format_options format) {
+    faidx_meta_t *meta = calloc(1, sizeof(faidx_meta_t));
+    if (!meta) return NULL;
+    
+    meta->fd = -1;
+    meta->format = format;
+    meta->ref_count = 1;
+    pthread_mutex_init(&meta->stats_mutex, NULL);
+    pthread_mutex_init(&meta->lines_mutex, NULL);
+    
+    // Store file paths
+    meta->fasta_path = str_dup(filename);
+    
+    // Construct index paths
+    char fai_path[1024];
+    if (suffix_path(fai_path, sizeof(fai_path), filename, ".fai") == 0) {
+        meta->fai_path = str_dup(fai_path);
+    }
+    
+    char gzi_path[1024];
+    if (suffix_path(gzi_path, sizeof(gzi_path), filename, ".gzi") == 0) {
+        meta->gzi_path = str_dup(gzi_path);
+    }
+    
+    if (!meta->fasta_path || !meta->fai_path || !meta->gzi_path) {
+        faidx_meta_destroy(meta);
+        return NULL;
+    }
+    
+    // Initialize hash table
+    meta->hash = hash_init();
+    if (!meta->hash) {
+        faidx_meta_destroy(meta);
+        return NULL;
+    }
+    return meta;
+}
+
+// Whether filename names a remote file for faidx_meta_load_url
+static int is_url(const char *filename) {
+    return !strncmp(filename, "http://", 7) || !strncmp(filename, "https://", 8) ||
+           !strncmp(filename, "s3://", 5);
+}
+
+faidx_meta_t *faidx_meta_load(const char *filename, fai_format_options format, int flags) {
+    if (!filename) return NULL;
+    if (is_url(filename)) {
+        return faidx_meta_load_url(filename, getenv("FAIGZ_CACHE_DIR"), format, flags);
+    }
+    
+    faidx_meta_t *meta = meta_alloc(filename, format);
+    if (!meta) return NULL;
+    int compression = detect_compression(filename);
+    meta->is_bgzf = (compression == 2);
+    meta->is_gzip = (compression == 1);
+    
+    // Prefer a current binary sidecar; otherwise load the index, or create
+    // it if it doesn't exist and FAI_CREATE is set
+    if (flags & FAI_LAZY) flags |= FAI_BIN;
+    int from_bin = (flags & FAI_BIN) && load_bin_index(meta, (flags & FAI_LAZY) != 0) == 0;
+    if (!from_bin && load_fai_index(meta, meta->fai_path) < 0) {
+        if (flags & FAI_CREATE) {
+            // Try to create the index
+            if (faidx_build_index(meta->fasta_path, format, 0) < 0) {
+                faidx_meta_destroy(meta);
+                return NULL;
+            }
+            // Now try to load the newly created index
+            if (load_fai_index(meta, meta->fai_path) < 0) {
+                faidx_meta_destroy(meta);
+                return NULL;
+            }
+        } else {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+    }
+    
+    // Load the GZI block table if this is a BGZF file, or rebuild it
+    // from the block headers when no .gzi is present
+    if (meta->is_bgzf) {
+        struct stat st;
+        if (stat(meta->fasta_path, &st) != 0) {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+        meta->bgzf_size = st.st_size;
+        
+        if (!meta->gzi_index) {
+            meta->gzi_index = load_gzi_index(meta->gzi_path);
+        }
+        if (!meta->gzi_index) {
+            meta->gzi_index = scan_gzi_index(meta->fasta_path, meta->bgzf_size);
+        }
+        if (!meta->gzi_index) {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+        
+        meta->cache = bgzf_cache_init(BGZF_CACHE_SHARDS);
+        if (!meta->cache) {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+    } else if ((flags & FAI_MMAP) && !meta->is_gzip) {
+        // Readers share this mapping; if it fails they fall back to stdio
+        int fd = open(meta->fasta_path, O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                meta->map = map;
+                meta->map_size = st.st_size;
+            }
+        }
+        if (fd >= 0) close(fd);
+    }
+    
+    // Best effort: without a sidecar this load simply stays on the text path.
+    // A lazy load then maps the new sidecar in place of the parsed tables,
+    // and asks the kernel not to read ahead of the pages lookups touch.
+    if ((flags & FAI_BIN) && !from_bin && faidx_meta_write_bin(meta) == 0 && (flags & FAI_LAZY)) {
+        meta_remap_bin(meta);
+    }
+    if ((flags & FAI_LAZY) && meta->bin_map) {
+        madvise((void *)meta->bin_map, meta->bin_size, MADV_RANDOM);
+    }
+    
+    // Readers and stateless fetches all pread through this one descriptor
+    if (!meta->is_gzip && !meta->map) {
+        meta->fd = open(meta->fasta_path, O_RDONLY);
+        if (meta->fd < 0) {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+    }
+    
+    if ((flags & FAI_VERIFY) && faidx_meta_verify(meta) < 0) {
+        faidx_meta_destroy(meta);
+        return NULL;
+    }
+    if (flags & FAI_PACK) {
+        meta->pack = pack_build(meta);
+        if (!meta->pack) {
+            faidx_meta_destroy(meta);
+            return NULL;
+        }
+    }
+    
+    meta_place(meta, flags);
+    return meta;
+}
+
+// Read a whole index file from a backend and open it as a stream; *buf
+// holds the bytes and is freed by the caller once the stream is closed
+static FILE *io_stream(faidx_io_t *io, char **buf) {
+    *buf = NULL;
+    int64_t size = io->size(io);
+    if (size <= 0 || (uint64_t)size > SIZE_MAX) return NULL;
+    *buf = malloc(size);
+    if (!*buf || io->read(io, *buf, size, 0) != size) return NULL;
+    return fmemopen(*buf, size, "rb");
+}
+
+faidx_meta_t *faidx_meta_load_io(const char *name, faidx_io_t *data, faidx_io_t *fai,
+                                 faidx_io_t *gzi, fai_format_options format, int flags) {
+    faidx_meta_t *meta = name && data && fai ? meta_alloc(name, format) : NULL;
+    if (meta) {
+        meta->io = data;
+    } else if (data) {
+        data->close(data);
+    }
+    
+    // Plain gzip only allows sequential reads, which a backend can't give
+    uint8_t header[BGZF_BLOCK_HEADER_LEN];
+    int64_t n = meta ? data->read(data, header, sizeof(header), 0) : -1;
+    int ok = n >= 0 && compression_kind(header, n) != 1;
+    if (ok) meta->is_bgzf = compression_kind(header, n) == 2;
+    
+    char *buf = NULL;
+    FILE *fp = ok ? io_stream(fai, &buf) : NULL;
+    ok = fp && load_fai_stream(meta, fp) == 0;
+    free(buf);
+    
+    if (ok && meta->is_bgzf) {
+        int64_t size = data->size(data);
+        buf = NULL;
+        fp = gzi ? io_stream(gzi, &buf) : NULL;
+        meta->gzi_index = fp ? load_gzi_stream(fp) : NULL;
+        free(buf);
+        meta->bgzf_size = size > 0 ? size : 0;
+        meta->cache = bgzf_cache_init(BGZF_CACHE_SHARDS);
+        ok = size > 0 && meta->gzi_index && meta->cache;
+    }
+    if (fai) fai->close(fai);
+    if (gzi) gzi->close(gzi);
+    
+    if (ok && (flags & FAI_VERIFY)) ok = faidx_meta_verify(meta) >= 0;
+    if (ok && (flags & FAI_PACK)) {
+        meta->pack = pack_build(meta);
+        ok = meta->pack != NULL;
+    }
+    if (!ok) {
+        faidx_meta_destroy(meta);
+        return NULL;
+    }
+    meta_place(meta, flags);
+    return meta;
+}
+
+#ifdef FAIGZ_CURL
+// HTTP(S) range backend. Handles are pooled so that connections are kept
+// alive between requests; each read takes one and gives it back.
+#define FAI_HTTP_IDLE 8
+#define FAI_HTTP_TRIES 3
+
+typedef struct {
+    faidx_io_t io;
+    char *url;
+    int64_t size;
+    uint64_t tag;                // Hash of the ETag, or of Last-Modified
+    pthread_mutex_t mutex;       // Guards idle
+    CURL *idle[FAI_HTTP_IDLE];
+    int n_idle;
+    
+    // On-disk cache: data_fd is a sparse copy of the file and map_fd holds
+    // a header and one byte per chunk, set once the chunk is in data_fd
+    int data_fd, map_fd;
+    uint8_t *have;
+    uint64_t n_chunks;
+} fai_http_t;
+
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    uint64_t tag;
+} fai_http_map_t;
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    int overflow;                // The server sent more than asked for
+} http_sink_t;
+
+typedef struct {
+    uint64_t etag, modified;
+} http_tags_t;
+
+static pthread_once_t http_once = PTHREAD_ONCE_INIT;
+
+static void http_global_init(void) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+static uint64_t http_hash(const char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; i++) h = (h ^ (uint8_t)p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static size_t http_write(char *p, size_t size, size_t n, void *arg) {
+    http_sink_t *sink = arg;
+    size_t bytes = size * n;
+    if (bytes > sink->cap - sink->len) {
+        sink->overflow = 1;
+        return 0;
+    }
+    memcpy(sink->buf + sink->len, p, bytes);
+    sink->len += bytes;
+    return bytes;
+}
+
+static size_t http_header(char *p, size_t size, size_t n, void *arg) {
+    http_tags_t *tags = arg;
+    size_t len = size * n;
+    if (len > 5 && !strncasecmp(p, "etag:", 5)) {
+        tags->etag = http_hash(p + 5, len - 5);
+    } else if (len > 14 && !strncasecmp(p, "last-modified:", 14)) {
+        tags->modified = http_hash(p + 14, len - 14);
+    }
+    return len;
+}
+
+static CURL *http_handle(fai_http_t *h) {
+    pthread_mutex_lock(&h->mutex);
+    CURL *c = h->n_idle ? h->idle[--h->n_idle] : NULL;
+    pthread_mutex_unlock(&h->mutex);
+    
+    // A reset handle keeps its connections
+    if (c) {
+        curl_easy_reset(c);
+    } else if (!(c = curl_easy_init())) {
+        return NULL;
+    }
+    curl_easy_setopt(c, CURLOPT_URL, h->url);
+    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(c, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(c, CURLOPT_USERAGENT, "faigz");
+    return c;
+}
+
+static void http_release(fai_http_t *h, CURL *c) {
+    pthread_mutex_lock(&h->mutex);
+    if (h->n_idle < FAI_HTTP_IDLE) {
+        h->idle[h->n_idle++] = c;
+        c = NULL;
+    }
+    pthread_mutex_unlock(&h->mutex);
+    if (c) curl_easy_cleanup(c);
+}
+
+// Perform a request, retrying failures other than client errors. Returns
+// the HTTP status (0 for other protocols) or -1.
+static long http_perform(CURL *c, http_sink_t *sink) {
+    for (int t = 0;; t++) {
+        if (sink) sink->len = 0;
+        CURLcode rc = curl_easy_perform(c);
+        long code = 0;
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &code);
+        if (rc == CURLE_OK) return code;
+        if (t + 1 == FAI_HTTP_TRIES || (code >= 400 && code < 500) || (sink && sink->overflow)) {
+            return -1;
+        }
+        usleep(100000 << t);
+    }
+}
+
+// Size and validator of the remote file, from a HEAD request
+static int http_stat(fai_http_t *h) {
+    CURL *c = http_handle(h);
+    if (!c) return -1;
+    
+    http_tags_t tags = {0, 0};
+    curl_easy_setopt(c, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, http_header);
+    curl_easy_setopt(c, CURLOPT_HEADERDATA, &tags);
+    curl_off_t size = -1;
+    if (http_perform(c, NULL) >= 0) curl_easy_getinfo(c, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+    http_release(h, c);
+    
+    h->size = size;
+    h->tag = tags.etag ? tags.etag : tags.modified;
+    return size >= 0 ? 0 : -1;
+}
+
+// Fetch [beg, beg + len) with one range request; returns the bytes received or -1
+static int64_t http_range(fai_http_t *h, char *buf, uint64_t beg, uint64_t len) {
+    CURL *c = http_handle(h);
+    if (!c) return -1;
+    
+    char range[48];
+    snprintf(range, sizeof(range), "%" PRIu64 "-%" PRIu64, beg, beg + len - 1);
+    http_sink_t sink = {buf, 0, len, 0};
+    curl_easy_setopt(c, CURLOPT_RANGE, range);
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, http_write);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, &sink);
+    long code = http_perform(c, &sink);
+    http_release(h, c);
+    
+    // A server that ignores Range sends the whole file, which only fits
+    // the buffer when the read starts at 0 and covers the rest of it
+    if (code < 0 || (code != 206 && code != 0 && !(code == 200 && beg == 0))) return -1;
+    return sink.len;
+}
+
+// Open the sparse copy of the file in cache_dir, starting it over if the
+// remote file changed. Without it reads go straight to the server.
+static void http_cache_open(fai_http_t *h, const char *cache_dir) {
+    char path[PATH_MAX];
+    uint64_t key = http_hash(h->url, strlen(h->url));
+    // A path that does not fit would name some other file: read uncached
+    int n = snprintf(path, sizeof(path), "%s/%016" PRIx64 ".data", cache_dir, key);
+    h->data_fd = n > 0 && (size_t)n < sizeof(path) ? open(path, O_RDWR | O_CREAT, 0644) : -1;
+    n = snprintf(path, sizeof(path), "%s/%016" PRIx64 ".map", cache_dir, key);
+    h->map_fd = n > 0 && (size_t)n < sizeof(path) ? open(path, O_RDWR | O_CREAT, 0644) : -1;
+    h->n_chunks = ((uint64_t)h->size + FAI_REMOTE_CHUNK - 1) / FAI_REMOTE_CHUNK;
+    h->have = calloc(h->n_chunks + 1, 1);
+    
+    fai_http_map_t want, got;
+    memset(&want, 0, sizeof(want));
+    memcpy(want.magic, "FAIGZRC1", 8);
+    want.size = h->size;
+    want.tag = h->tag;
+    int ok = h->data_fd >= 0 && h->map_fd >= 0 && h->have;
+    if (ok && pread(h->map_fd, &got, sizeof(got), 0) == sizeof(got) &&
+        !memcmp(&got, &want, sizeof(want))) {
+        // A short map only means fewer chunks are known
+        if (pread(h->map_fd, h->have, h->n_chunks, sizeof(want)) < 0) memset(h->have, 0, h->n_chunks);
+    } else if (ok) {
+        ok = ftruncate(h->map_fd, 0) == 0 && ftruncate(h->data_fd, 0) == 0 &&
+             pwrite(h->map_fd, &want, sizeof(want), 0) == sizeof(want);
+    }
+    
+    if (!ok) {
+        if (h->data_fd >= 0) close(h->data_fd);
+        if (h->map_fd >= 0) close(h->map_fd);
+        h->data_fd = h->map_fd = -1;
+        free(h->have);
+        h->have = NULL;
+    }
+}
+
+// Download chunks [c, e] with one request into the cache
+static int http_fill(fai_http_t *h, uint64_t c, uint64_t e) {
+    uint64_t beg = c * FAI_REMOTE_CHUNK;
+    uint64_t end = (e + 1) * FAI_REMOTE_CHUNK;
+    if (end > (uint64_t)h->size) end = h->size;
+    char *buf = malloc(end - beg);
+    if (!buf) return -1;
+    
+    int ok = http_range(h, buf, beg, end - beg) == (int64_t)(end - beg);
+    for (uint64_t done = 0; ok && done < end - beg;) {
+        ssize_t n = pwrite(h->data_fd, buf + done, end - beg - done, beg + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = 0;
+        else done += n;
+    }
+    free(buf);
+    if (!ok) return -1;
+    
+    // Best effort: a map byte that doesn't make it to disk only means the
+    // chunk is downloaded again next time
+    static const uint8_t ones[64] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    };
+    for (uint64_t k = c; k <= e; k += sizeof(ones)) {
+        uint64_t n = e + 1 - k < sizeof(ones) ? e + 1 - k : sizeof(ones);
+        if (pwrite(h->map_fd, ones, n, sizeof(fai_http_map_t) + k) < 0) break;
+    }
+    for (uint64_t k = c; k <= e; k++) __atomic_store_n(&h->have[k], 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int64_t http_read(faidx_io_t *io, void *buf, size_t len, uint64_t offset) {
+    fai_http_t *h = (fai_http_t *)io;
+    if (offset >= (uint64_t)h->size) return 0;
+    if (len > (uint64_t)h->size - offset) len = h->size - offset;
+    if (len == 0) return 0;
+    
+    // Serve from the cache after fetching each run of missing chunks in one
+    // request; fall back to a direct request if the cache can't be used
+    if (h->data_fd >= 0) {
+        uint64_t first = offset / FAI_REMOTE_CHUNK, last = (offset + len - 1) / FAI_REMOTE_CHUNK;
+        int ok = 1;
+        for (uint64_t c = first; ok && c <= last; c++) {
+            if (__atomic_load_n(&h->have[c], __ATOMIC_ACQUIRE)) continue;
+            uint64_t e = c;
+            while (e < last && !__atomic_load_n(&h->have[e + 1], __ATOMIC_ACQUIRE)) e++;
+            ok = http_fill(h, c, e) == 0;
+            c = e;
+        }
+        size_t done = 0;
+        while (ok && done < len) {
+            ssize_t n = pread(h->data_fd, (char *)buf + done, len - done, offset + done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) ok = 0;
+            else done += n;
+        }
+        if (ok) return len;
+    }
+    
+    return http_range(h, buf, offset, len) == (int64_t)len ? (int64_t)len : -1;
+}
+
+static int64_t http_size(faidx_io_t *io) {
+    return ((fai_http_t *)io)->size;
+}
+
+static void http_close(faidx_io_t *io) {
+    fai_http_t *h = (fai_http_t *)io;
+    for (int i = 0; i < h->n_idle; i++) curl_easy_cleanup(h->idle[i]);
+    if (h->data_fd >= 0) close(h->data_fd);
+    if (h->map_fd >= 0) close(h->map_fd);
+    pthread_mutex_destroy(&h->mutex);
+    free(h->have);
+    free(h->url);
+    free(h);
+}
+
+// s3://bucket/key as an HTTPS URL; other URLs are used as they are
+static char *http_url(const char *url) {
+    if (strncmp(url, "s3://", 5)) return str_dup(url);
+    
+    const char *bucket = url + 5;
+    const char *key = strchr(bucket, '/');
+    if (!key) key = bucket + strlen(bucket);
+    const char *endpoint = getenv("AWS_ENDPOINT_URL");
+    size_t n = strlen(url) + (endpoint ? strlen(endpoint) : 0) + 32;
+    char *out = malloc(n);
+    if (!out) return NULL;
+    if (endpoint && *endpoint) {
+        snprintf(out, n, "%s/%.*s%s", endpoint, (int)(key - bucket), bucket, key);
+    } else {
+        snprintf(out, n, "https://%.*s.s3.amazonaws.com%s", (int)(key - bucket), bucket, key);
+    }
+    return out;
+}
+
+faidx_io_t *faidx_io_open_url(const char *url, const char *cache_dir) {
+    if (!url) return NULL;
+    pthread_once(&http_once, http_global_init);
+    
+    fai_http_t *h = calloc(1, sizeof(fai_http_t));
+    if (!h) return NULL;
+    h->io.read = http_read;
+    h->io.size = http_size;
+    h->io.close = http_close;
+    h->data_fd = h->map_fd = -1;
+    pthread_mutex_init(&h->mutex, NULL);
+    
+    h->url = http_url(url);
+    if (!h->url || http_stat(h) < 0) {
+        http_close(&h->io);
+        return NULL;
+    }
+    if (cache_dir && *cache_dir) http_cache_open(h, cache_dir);
+    return &h->io;
+}
+#else
+faidx_io_t *faidx_io_open_url(const char *url, const char *cache_dir) {
+    errno = ENOSYS;
+    return NULL;
+}
+#endif
+
+faidx_meta_t *faidx_meta_load_url(const char *url, const char *cache_dir,
+                                  fai_format_options format, int flags) {
+    if (!url) return NULL;
+    
+    size_t n = strlen(url) + 5;
+    char *sidecar = malloc(n);
+    if (!sidecar) return NULL;
+    
+    // Uncompressed files have no .gzi, so a missing one is left to the loader
+    faidx_io_t *data = faidx_io_open_url(url, cache_dir);
+    snprintf(sidecar, n, "%s.fai", url);
+    faidx_io_t *fai = data ? faidx_io_open_url(sidecar, cache_dir) : NULL;
+    snprintf(sidecar, n, "%s.gzi", url);
+    faidx_io_t *gzi = fai ? faidx_io_open_url(sidecar, cache_dir) : NULL;
+    free(sidecar);
+    
+    return faidx_meta_load_io(url, data, fai, gzi, format, flags);
+}
+
+// Line table of an irregular sequence: checkpoints pairing a count of bases
+// with the file offset of the next one, in order, the first at the
+// sequence's start and the last at its end
+struct fai_lines_t {
+    uint64_t n, m;
+    uint64_t *base, *offset;
+};
+
+// Stand in for the table of a sequence whose lines match its .fai, and of
+// one whose last base is where its .fai puts it but whose lines are unchecked
+static struct fai_lines_t fai_lines_regular;
+static struct fai_lines_t fai_lines_probed;
+
+static void lines_free(struct fai_lines_t *t) {
+    if (!t || t == &fai_lines_regular || t == &fai_lines_probed) return;
+    free(t->base);
+    free(t->offset);
+    free(t);
+}
+
+static void lines_destroy(faidx_meta_t *meta) {
+    if (!meta->lines) return;
+    for (int i = 0; i < meta->n; i++) lines_free(meta->lines[i]);
+    free(meta->lines);
+}
+
+faidx_meta_t *faidx_meta_ref(faidx_meta_t *meta) {
+    if (!meta) return NULL;
+    
+    __atomic_add_fetch(&meta->ref_count, 1, __ATOMIC_RELAXED);
+    return meta;
+}
+
+void faidx_meta_destroy(faidx_meta_t *meta) {
+    if (!meta) return;
+    
+    // The release/acquire pair orders every holder's last use before the free
+    int should_free = __atomic_sub_fetch(&meta->ref_count, 1, __ATOMIC_ACQ_REL) <= 0;
+    
+    if (should_free) {
+        // Placed tables go back to their allocator; the fields are cleared
+        // so the frees below skip them
+        replicas_destroy(meta);
+        placed_release(meta);
+        if (meta->bin_map) {
+            // The tables live in the sidecar mapping
+            free(meta->hash);
+            free(meta->gzi_index);
+            munmap((void *)meta->bin_map, meta->bin_size);
+        } else {
+            if (meta->hash) hash_destroy(meta->hash);
+            if (meta->gzi_index) destroy_gzi_index(meta->gzi_index);
+        }
+        
+        free(meta->fasta_path);
+        free(meta->fai_path);
+        free(meta->gzi_path);
+        
+        bgzf_cache_destroy(meta->cache);
+        pack_destroy(meta->pack);
+        if (meta->map) munmap((void *)meta->map, meta->map_size);
+        if (meta->fd >= 0) close(meta->fd);
+        if (meta->io) meta->io->close(meta->io);
+        lines_destroy(meta);
+        pthread_mutex_destroy(&meta->stats_mutex);
+        pthread_mutex_destroy(&meta->lines_mutex);
+        
+        free(meta);
+    }
+}
+
+static inline uint64_t gzi_block_end(const faidx_meta_t *meta, int k) {
+    const gzi_index_t *index = meta->gzi_index;
+    return k + 1 < index->n_entries ? index->entries[k + 1].compressed_offset : meta->bgzf_size;
+}
+
+// Positioned read of the FASTA file, through the backend if it has one.
+// Returns the bytes read, short only at the end of the file, or -1.
+static int64_t meta_pread(const faidx_meta_t *meta, void *buf, size_t len, uint64_t offset) {
+    if (meta->io) return meta->io->read(meta->io, buf, len, offset);
+    
+    size_t done = 0;
+    while (done < len) {
+        ssize_t got = pread(meta->fd, (char *)buf + done, len - done, offset + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) return -1;
+        if (got == 0) break;
+        done += got;
+    }
+    return done;
+}
+
+// Background BGZF readahead: one thread per reader keeps the blocks in
+// [beg, end) inflated in a ring of slots, block k living in slot k % n_slots
+enum { RA_EMPTY, RA_BUSY, RA_READY, RA_FAILED };
+
+typedef struct {
+    int k;                       // Block held, -1 if none
+    int state;
+    int len;
+    char *data;
+} fai_ra_slot_t;
+
+struct fai_readahead_t {
+    const faidx_meta_t *meta;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;         // The window moved, or stop was set
+    pthread_cond_t done;         // A block finished inflating
+    fai_ra_slot_t *slots;
+    int n_slots;
+    int beg, end;                // Blocks wanted ahead of the reader
+    int stop;
+    fai_inflater_t inflater;
+    uint8_t *cbuf;
+};
+
+static int readahead_inflate(struct fai_readahead_t *ra, int k, char *out) {
+    const faidx_meta_t *meta = ra->meta;
+    uint64_t c_off = meta->gzi_index->entries[k].compressed_offset;
+    uint64_t span = gzi_block_end(meta, k) - c_off;
+    if (span > BGZF_MAX_BLOCK_SIZE) span = BGZF_MAX_BLOCK_SIZE;
+
+    int64_t got = meta_pread(meta, ra->cbuf, span, c_off);
+    if (got < 0 || (uint64_t)got != span) return -1;
+    int bsize = bgzf_block_size(ra->cbuf, span);
+    if (bsize < 0) return -1;
+    return bgzf_inflate_block(&ra->inflater, ra->cbuf, bsize, out, BGZF_MAX_BLOCK_SIZE);
+}
+
+static void *readahead_main(void *arg) {
+    struct fai_readahead_t *ra = arg;
+    int n_blocks = ra->meta->gzi_index->n_entries;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->stop) {
+        // Lowest wanted block not yet in its slot
+        int k = ra->beg;
+        while (k < ra->end && k < n_blocks && ra->slots[k % ra->n_slots].k == k) k++;
+        if (k >= ra->end || k >= n_blocks) {
+            pthread_cond_wait(&ra->wake, &ra->mutex);
+            continue;
+        }
+
+        fai_ra_slot_t *slot = &ra->slots[k % ra->n_slots];
+        slot->k = k;
+        slot->state = RA_BUSY;
+        pthread_mutex_unlock(&ra->mutex);
+
+        int len = readahead_inflate(ra, k, slot->data);
+
+        pthread_mutex_lock(&ra->mutex);
+        slot->len = len;
+        slot->state = len < 0 ? RA_FAILED : RA_READY;
+        pthread_cond_broadcast(&ra->done);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return NULL;
+}
+
+static void readahead_free(struct fai_readahead_t *ra) {
+    for (int i = 0; i < ra->n_slots; i++) free(ra->slots[i].data);
+    free(ra->slots);
+    free(ra->cbuf);
+    fai_inflater_end(&ra->inflater);
+    pthread_cond_destroy(&ra->wake);
+    pthread_cond_destroy(&ra->done);
+    pthread_mutex_destroy(&ra->mutex);
+    free(ra);
+}
+
+static void readahead_destroy(struct fai_readahead_t *ra) {
+    if (!ra) return;
+    pthread_mutex_lock(&ra->mutex);
+    ra->stop = 1;
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->mutex);
+    pthread_join(ra->thread, NULL);
+    readahead_free(ra);
+}
+
+static struct fai_readahead_t *readahead_create(const faidx_meta_t *meta, int n_slots) {
+    struct fai_readahead_t *ra = calloc(1, sizeof(struct fai_readahead_t));
+    if (!ra) return NULL;
+    ra->meta = meta;
+    pthread_mutex_init(&ra->mutex, NULL);
+    pthread_cond_init(&ra->wake, NULL);
+    pthread_cond_init(&ra->done, NULL);
+
+    int ok = fai_inflater_init(&ra->inflater) == 0;
+    ra->slots = calloc(n_slots, sizeof(fai_ra_slot_t));
+    ra->cbuf = malloc(BGZF_MAX_BLOCK_SIZE);
+    ok = ok && ra->slots && ra->cbuf;
+    if (ra->slots) {
+        ra->n_slots = n_slots;
+        for (int i = 0; i < n_slots; i++) {
+            ra->slots[i].k = -1;
+            ra->slots[i].data = malloc(BGZF_MAX_BLOCK_SIZE);
+            ok = ok && ra->slots[i].data;
+        }
+    }
+    if (!ok || pthread_create(&ra->thread, NULL, readahead_main, ra) != 0) {
+        readahead_free(ra);
+        return NULL;
+    }
+    return ra;
+}
+
+// Ask for blocks [beg, beg + n) to be inflated; n == 0 pauses the thread
+static void readahead_move(struct fai_readahead_t *ra, int beg, int n) {
+    pthread_mutex_lock(&ra->mutex);
+    if (n > ra->n_slots) n = ra->n_slots;
+    ra->beg = beg;
+    ra->end = beg + n;
+    pthread_cond_signal(&ra->wake);
+    pthread_mutex_unlock(&ra->mutex);
+}
+
+// The reader is inflating blocks before k itself; stop wanting them
+static void readahead_skip(struct fai_readahead_t *ra, int k) {
+    pthread_mutex_lock(&ra->mutex);
+    if (ra->beg < k) ra->beg = k;
+    if (ra->end < ra->beg) ra->end = ra->beg;
+    pthread_mutex_unlock(&ra->mutex);
+}
+
+// Whether block k is inflated, or being inflated, in the ring
+static int readahead_has(struct fai_readahead_t *ra, int k) {
+    pthread_mutex_lock(&ra->mutex);
+    const fai_ra_slot_t *slot = &ra->slots[k % ra->n_slots];
+    int has = slot->k == k && (slot->state == RA_BUSY || slot->state == RA_READY);
+    pthread_mutex_unlock(&ra->mutex);
+    return has;
+}
+
+// Copy up to max bytes from offset off of block k; returns the number of
+// bytes copied, or -1 if the ring doesn't hold the block. A block still
+// being inflated is waited for rather than inflated twice.
+static int64_t readahead_copy(struct fai_readahead_t *ra, int k, uint64_t off,
+                              char *dst, uint64_t max) {
+    pthread_mutex_lock(&ra->mutex);
+    fai_ra_slot_t *slot = &ra->slots[k % ra->n_slots];
+    while (slot->k == k && slot->state == RA_BUSY) pthread_cond_wait(&ra->done, &ra->mutex);
+
+    int64_t got = -1;
+    if (slot->k == k && slot->state == RA_READY && off < (uint64_t)slot->len) {
+        uint64_t n = slot->len - off;
+        if (n > max) n = max;
+        memcpy(dst, slot->data + off, n);
+        got = n;
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return got;
+}
+
+// Fetch statistics. A reader's counters have a single writer, its owning
+// thread, so plain relaxed stores are enough for other threads to read them
+// at any time; scratch readers share meta->retired and add atomically.
+static inline void stat_add(const faidx_reader_t *reader, uint64_t *field, uint64_t v) {
+    if (reader->stats_shared) {
+        __atomic_fetch_add(field, v, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(field, *field + v, __ATOMIC_RELAXED);
+    }
+}
+
+#define STAT_ADD(reader, field, v) stat_add((reader), &(reader)->stats->field, (v))
+
+#define FAI_HIST_SUB_BITS __builtin_ctz(FAI_HIST_SUB)
+
+// Values below FAI_HIST_SUB get a bucket each; above, every power of two is
+// split into FAI_HIST_SUB buckets by the bits after the leading one
+static inline int hist_bucket(uint64_t ns) {
+    if (ns < FAI_HIST_SUB) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (e - FAI_HIST_SUB_BITS)) & (FAI_HIST_SUB - 1);
+    int b = (e - FAI_HIST_SUB_BITS + 1) * FAI_HIST_SUB + sub;
+    return b < FAI_HIST_BUCKETS ? b : FAI_HIST_BUCKETS - 1;
+}
+
+uint64_t faidx_hist_bucket_lower(int bucket) {
+    if (bucket < FAI_HIST_SUB) return bucket < 0 ? 0 : (uint64_t)bucket;
+    if (bucket >= FAI_HIST_BUCKETS) bucket = FAI_HIST_BUCKETS - 1;
+    int e = bucket / FAI_HIST_SUB + FAI_HIST_SUB_BITS - 1;
+    return (uint64_t)(FAI_HIST_SUB + bucket % FAI_HIST_SUB) << (e - FAI_HIST_SUB_BITS);
+}
+
+static void hist_add(const faidx_reader_t *reader, faidx_hist_t *h, uint64_t ns) {
+    stat_add(reader, &h->count, 1);
+    stat_add(reader, &h->sum_ns, ns);
+    stat_add(reader, &h->buckets[hist_bucket(ns)], 1);
+    uint64_t max = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&h->max_ns, &max, ns, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static inline uint64_t stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Start a fetch of n regions, timing it if the fetch count is about to
+// cross a multiple of FAI_STATS_SAMPLE. A sample that ends without data (a
+// size query or an error) carries over to the next fetch; a batch is timed
+// as one fetch.
+static inline void stats_begin(faidx_reader_t *reader, uint64_t n) {
+    if (!reader->stats_timing) {
+        uint64_t seen = __atomic_load_n(&reader->stats->fetches, __ATOMIC_RELAXED);
+        reader->stats_timing = (seen + FAI_STATS_SAMPLE - 1) / FAI_STATS_SAMPLE !=
+                               (seen + n + FAI_STATS_SAMPLE - 1) / FAI_STATS_SAMPLE;
+    }
+    if (reader->stats_timing) {
+        memset(reader->stats_acc, 0, sizeof(reader->stats_acc));
+        reader->stats_t = stats_now();
+    }
+}
+
+// Charge the time since the last boundary to phase
+static inline void stats_lap(faidx_reader_t *reader, int phase) {
+    if (!reader->stats_timing) return;
+    uint64_t t = stats_now();
+    reader->stats_acc[phase] += t - reader->stats_t;
+    reader->stats_t = t;
+}
+
+// Finish a fetch of n regions that returned bases
+static void stats_end(faidx_reader_t *reader, uint64_t n, int64_t bases) {
+    STAT_ADD(reader, fetches, n);
+    if (bases > 0) STAT_ADD(reader, bases, bases);
+    if (!reader->stats_timing) return;
+    reader->stats_timing = 0;
+    STAT_ADD(reader, timed, 1);
+    for (int p = 0; p < FAI_N_PHASES; p++) {
+        hist_add(reader, &reader->stats->phases[p], reader->stats_acc[p]);
+    }
+}
+
+// Add src into dst; dst may be shared, src is read with relaxed loads
+static void stats_merge(faidx_stats_t *dst, const faidx_stats_t *src) {
+    const uint64_t *from = (const uint64_t *)src;
+    uint64_t *to = (uint64_t *)dst;
+    size_t counters = offsetof(faidx_stats_t, phases) / sizeof(uint64_t);
+    for (size_t i = 0; i < counters; i++) {
+        __atomic_fetch_add(&to[i], __atomic_load_n(&from[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    for (int p = 0; p < FAI_N_PHASES; p++) {
+        const faidx_hist_t *hs = &src->phases[p];
+        faidx_hist_t *hd = &dst->phases[p];
+        if (!__atomic_load_n(&hs->count, __ATOMIC_RELAXED)) continue;
+        __atomic_fetch_add(&hd->count, __atomic_load_n(&hs->count, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&hd->sum_ns, __atomic_load_n(&hs->sum_ns, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        uint64_t ns = __atomic_load_n(&hs->max_ns, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&hd->max_ns, __ATOMIC_RELAXED);
+        while (ns > max && !__atomic_compare_exchange_n(&hd->max_ns, &max, ns, 1,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        for (int b = 0; b < FAI_HIST_BUCKETS; b++) {
+            uint64_t v = __atomic_load_n(&hs->buckets[b], __ATOMIC_RELAXED);
+            if (v) __atomic_fetch_add(&hd->buckets[b], v, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void faidx_reader_stats(const faidx_reader_t *reader, faidx_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (reader && reader->stats) stats_merge(stats, reader->stats);
+}
+
+void faidx_meta_stats(faidx_meta_t *meta, faidx_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!meta) return;
+    pthread_mutex_lock(&meta->stats_mutex);
+    stats_merge(stats, &meta->retired);
+    for (const faidx_reader_t *r = meta->stats_readers; r; r = r->stats_next) {
+        stats_merge(stats, r->stats);
+    }
+    pthread_mutex_unlock(&meta->stats_mutex);
+}
+
+// Smallest arena chunk; a reader's first fetch sizes the arena from there
+#define FAI_ARENA_MIN (64 << 10)
+
+struct fai_arena_chunk_t {
+    fai_arena_chunk_t *next;
+    size_t size;
+    uint64_t data[];
+};
+
+// A point to return the arena to; everything carved after it is released
+typedef struct {
+    fai_arena_chunk_t *chunk;
+    size_t used, live;
+} arena_mark_t;
+
+static void arena_free_chunks(fai_arena_chunk_t *c) {
+    while (c) {
+        fai_arena_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+// size bytes, 8-byte aligned, valid until the arena is released past them
+static void *arena_alloc(fai_arena_t *a, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (!a->cur || a->cur->size - a->used < size) {
+        // Move on to the next chunk, replacing it (and those after it) if it
+        // is too small for this request
+        fai_arena_chunk_t *next = a->cur ? a->cur->next : NULL;
+        if (!next || next->size < size) {
+            size_t want = a->cur ? a->cur->size * 2 : FAI_ARENA_MIN;
+            if (want < size) want = size;
+            fai_arena_chunk_t *c = malloc(sizeof(*c) + want);
+            if (!c) return NULL;
+            c->size = want;
+            c->next = NULL;
+            arena_free_chunks(next);
+            if (a->cur) a->cur->next = c;
+            else a->first = c;
+            next = c;
+        }
+        a->cur = next;
+        a->used = 0;
+    }
+    void *p = (char *)a->cur->data + a->used;
+    a->used += size;
+    a->live += size;
+    if (a->live > a->peak) a->peak = a->live;
+    return p;
+}
+
+static arena_mark_t arena_mark(const fai_arena_t *a) {
+    arena_mark_t m = {a->cur, a->used, a->live};
+    return m;
+}
+
+static void arena_release(fai_arena_t *a, arena_mark_t m) {
+    a->cur = m.chunk ? m.chunk : a->first;
+    a->used = m.used;
+    a->live = m.live;
+    if (!a->live && a->first && a->first->next) {
+        // A fetch outgrew the first chunk: keep one chunk that fits it
+        arena_free_chunks(a->first);
+        a->first = a->cur = malloc(sizeof(fai_arena_chunk_t) + a->peak);
+        if (a->first) {
+            a->first->size = a->peak;
+            a->first->next = NULL;
+        }
+    }
+}
+
+// Start a fetch of n regions, releasing the previous fetch's scratch
+static void reader_begin(faidx_reader_t *reader, uint64_t n) {
+    arena_mark_t empty = {NULL, 0, 0};
+    arena_release(&reader->arena, empty);
+    stats_begin(reader, n);
+}
+
+// Resolve a sequence name, starting a fetch
+static faidx1_t *reader_lookup(faidx_reader_t *reader, const char *c_name) {
+    reader_begin(reader, 1);
+    faidx1_t *entry = hash_get(reader->hash, c_name);
+    stats_lap(reader, FAI_PHASE_LOOKUP);
+    return entry;
+}
+
+// Point a scratch reader's statistics at the meta totals
+static void reader_share_stats(faidx_reader_t *reader) {
+    reader->stats = &reader->meta->retired;
+    reader->stats_shared = 1;
+}
+
+// Set up per-reader state. BGZF and uncompressed files are read with pread
+// on meta's shared descriptor, so only plain gzip needs a stream of its own.
+static int reader_init(faidx_reader_t *reader, faidx_meta_t *meta) {
+    memset(reader, 0, sizeof(*reader));
+    reader->meta = meta;
+    reader->fd = meta->fd;
+    reader->ublock_len = -1;
+    reader->ra_mode = -1;
+    reader->hash = meta->hash;
+    reader->gzi = meta->gzi_index;
+    reader->node_cache = meta->cache;
+    if (meta->n_replicas) {
+        int node = numa_current_node();
+        if (node >= 0 && node < meta->n_replicas && meta->replicas[node].hash) {
+            reader->hash = meta->replicas[node].hash;
+            reader->gzi = meta->replicas[node].gzi;
+            reader->node_cache = meta->replicas[node].cache;
+        }
+    }
+    
+    if (meta->pack && meta->format == FAI_FASTA) {
+        // Packed FASTA is fetched from memory only
+    } else if (meta->is_bgzf) {
+        reader->ublock = malloc(BGZF_MAX_BLOCK_SIZE);
+        if (!reader->ublock || fai_inflater_init(&reader->inflater) < 0) return -1;
+        reader->inflater_init = 1;
+    } else if (meta->is_gzip) {
+        reader->gzfp = gzopen(meta->fasta_path, "r");
+        if (!reader->gzfp) return -1;
+    }
+    return 0;
+}
+
+// Free per-reader state; the descriptor belongs to meta
+static void reader_release(faidx_reader_t *reader) {
+    readahead_destroy(reader->ra);
+    if (reader->gzfp) gzclose(reader->gzfp);
+    if (reader->inflater_init) fai_inflater_end(&reader->inflater);
+    free(reader->ublock);
+    arena_free_chunks(reader->arena.first);
+    bgzf_cache_destroy(reader->cache);
+    if (!reader->stats_shared) free(reader->stats);
+}
+
+faidx_reader_t *faidx_reader_create(faidx_meta_t *meta) {
+    if (!meta) return NULL;
+    
+    faidx_reader_t *reader = malloc(sizeof(faidx_reader_t));
+    if (!reader) return NULL;
+    
+    if (reader_init(reader, faidx_meta_ref(meta)) < 0 ||
+        !(reader->stats = calloc(1, sizeof(faidx_stats_t)))) {
+        faidx_reader_destroy(reader);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&meta->stats_mutex);
+    reader->stats_next = meta->stats_readers;
+    if (meta->stats_readers) meta->stats_readers->stats_prev = reader;
+    meta->stats_readers = reader;
+    pthread_mutex_unlock(&meta->stats_mutex);
+    return reader;
+}
+
+void faidx_reader_destroy(faidx_reader_t *reader) {
+    if (!reader) return;
+    
+    // Fold the reader's counters into the meta totals
+    faidx_meta_t *meta = reader->meta;
+    if (reader->stats) {
+        pthread_mutex_lock(&meta->stats_mutex);
+        if (reader->stats_prev) reader->stats_prev->stats_next = reader->stats_next;
+        else if (meta->stats_readers == reader) meta->stats_readers = reader->stats_next;
+        if (reader->stats_next) reader->stats_next->stats_prev = reader->stats_prev;
+        stats_merge(&meta->retired, reader->stats);
+        pthread_mutex_unlock(&meta->stats_mutex);
+    }
+    
+    reader_release(reader);
+    faidx_meta_destroy(reader->meta);
+    free(reader);
+}
+
+// Largest compressed span fetched by a single pread
+#define BGZF_READ_SPAN (64 * BGZF_MAX_BLOCK_SIZE)
+
+// Largest run of merged batch regions read at once (uncompressed bytes)
+#define FAI_BATCH_SPAN (16 << 20)
+
+// Index of the block holding uncompressed_offset
+static int gzi_find_block(const gzi_index_t *index, uint64_t uncompressed_offset) {
+    int left = 0, right = index->n_entries - 1;
+    int best = 0;
+    
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (index->entries[mid].uncompressed_offset <= uncompressed_offset) {
+            best = mid;
+            left = mid + 1;
+        } else {
+            right = mid - 1;
+        }
+    }
+    return best;
+}
+
+// Copy len decompressed bytes starting at uoffset into dst. Only the blocks
+// covering the range are read (one pread per run of blocks) and each block
+// is inflated on its own; blocks that lie wholly inside the range are
+// inflated straight into dst. Partially used blocks are the ones that
+// neighbouring fetches share, so only those go into the block cache.
+static int64_t bgzf_read_range(faidx_reader_t *reader, uint64_t uoffset,
+                               char *dst, int64_t len) {
+    const faidx_meta_t *meta = reader->meta;
+    const gzi_index_t *index = reader->gzi;
+    bgzf_cache_t *cache = reader->cache ? reader->cache : reader->node_cache;
+    if (!bgzf_cache_enabled(cache)) cache = NULL;
+    uint64_t uend = uoffset + len;
+    int k = gzi_find_block(index, uoffset);
+    
+    int64_t done = 0;
+    while (done < len && k < index->n_entries) {
+        uint64_t c_beg = index->entries[k].compressed_offset;
+        uint64_t block_u = index->entries[k].uncompressed_offset;
+        uint64_t copy_beg = uoffset + done;
+        
+        // Neighbouring fetches (and consecutive groups of a batch) often
+        // start in the block decompressed last time
+        if (reader->ublock_len >= 0 && reader->ublock_coffset == c_beg &&
+            copy_beg < block_u + reader->ublock_len) {
+            uint64_t copy_end = block_u + reader->ublock_len;
+            if (copy_end > uend) copy_end = uend;
+            memcpy(dst + done, reader->ublock + (copy_beg - block_u), copy_end - copy_beg);
+            STAT_ADD(reader, blocks_reused, 1);
+            done = copy_end - uoffset;
+            k++;
+            continue;
+        }
+        
+        // Blocks inflated ahead by the readahead thread
+        if (reader->ra) {
+            int64_t got = readahead_copy(reader->ra, k, copy_beg - block_u, dst + done,
+                                         uend - copy_beg);
+            if (got >= 0) {
+                STAT_ADD(reader, blocks_reused, 1);
+                done += got;
+                k++;
+                continue;
+            }
+        }
+        
+        // A cached block can't tell its own length, so only ask for the
+        // bytes up to the next block's start
+        if (cache) {
+            uint64_t copy_end = uend;
+            if (k + 1 < index->n_entries && index->entries[k + 1].uncompressed_offset < copy_end) {
+                copy_end = index->entries[k + 1].uncompressed_offset;
+            }
+            if (copy_end > copy_beg &&
+                bgzf_cache_copy(cache, c_beg, copy_beg - block_u, dst + done, copy_end - copy_beg)) {
+                STAT_ADD(reader, cache_hits, 1);
+                done = copy_end - uoffset;
+                k++;
+                continue;
+            }
+            STAT_ADD(reader, cache_misses, 1);
+        }
+        
+        // Gather the run of uncached blocks covering the rest of the range
+        int last = k;
+        while (last + 1 < index->n_entries &&
+               index->entries[last + 1].uncompressed_offset < uend &&
+               gzi_block_end(meta, last + 1) - c_beg <= BGZF_READ_SPAN &&
+               !(cache && bgzf_cache_contains(cache, index->entries[last + 1].compressed_offset)) &&
+               !(reader->ra && readahead_has(reader->ra, last + 1))) {
+            last++;
+        }
+        if (reader->ra) readahead_skip(reader->ra, last + 1);
+        uint64_t span = gzi_block_end(meta, last) - c_beg;
+        arena_mark_t mark = arena_mark(&reader->arena);
+        uint8_t *cbuf = arena_alloc(&reader->arena, span);
+        if (!cbuf) return -1;
+        
+        int64_t got = meta_pread(meta, cbuf, span, c_beg);
+        if (got < 0 || (uint64_t)got != span) return -1;
+        STAT_ADD(reader, compressed_bytes, span);
+        stats_lap(reader, FAI_PHASE_READ);
+        
+        int inflated = 0;
+        uint64_t inflated_bytes = 0;
+        for (; k <= last && done < len; k++) {
+            uint64_t c_off = index->entries[k].compressed_offset;
+            const uint8_t *block = cbuf + (c_off - c_beg);
+            int bsize = bgzf_block_size(block, gzi_block_end(meta, k) - c_off);
+            if (bsize < 0) return -1;
+            
+            uint64_t block_u = index->entries[k].uncompressed_offset;
+            uint64_t block_uend = block_u + le32(block + bsize - 4);
+            if (block_uend <= uoffset) continue;
+            
+            uint64_t copy_beg = block_u > uoffset ? block_u : uoffset;
+            uint64_t copy_end = block_uend < uend ? block_uend : uend;
+            
+            inflated++;
+            inflated_bytes += block_uend - block_u;
+            if (copy_beg == block_u && copy_end == block_uend) {
+                if (bgzf_inflate_block(&reader->inflater, block, bsize, dst + (block_u - uoffset),
+                                       (int)(block_uend - block_u)) < 0) return -1;
+            } else {
+                int ulen = bgzf_inflate_block(&reader->inflater, block, bsize,
+                                              reader->ublock, BGZF_MAX_BLOCK_SIZE);
+                if (ulen < 0) {
+                    reader->ublock_len = -1;
+                    return -1;
+                }
+                reader->ublock_coffset = c_off;
+                reader->ublock_len = ulen;
+                if (cache) bgzf_cache_put(cache, c_off, reader->ublock, ulen);
+                memcpy(dst + (copy_beg - uoffset), reader->ublock + (copy_beg - block_u),
+                       copy_end - copy_beg);
+            }
+            done = copy_end - uoffset;
+        }
+        STAT_ADD(reader, blocks_inflated, inflated);
+        STAT_ADD(reader, bytes_inflated, inflated_bytes);
+        stats_lap(reader, FAI_PHASE_INFLATE);
+        arena_release(&reader->arena, mark);
+    }
+    
+    return done;
+}
+
+// Read len bytes at an uncompressed file offset; returns bytes read or -1
+static int64_t reader_read(faidx_reader_t *reader, uint64_t offset, char *buf, int64_t len) {
+    if (reader->meta->is_bgzf) {
+        return bgzf_read_range(reader, offset, buf, len);
+    }
+    
+    if (reader->meta->map) {
+        const faidx_meta_t *meta = reader->meta;
+        if (offset >= meta->map_size) return 0;
+        if (len > meta->map_size - offset) len = meta->map_size - offset;
+        memcpy(buf, meta->map + offset, len);
+        return len;
+    }
+    
+    if (reader->gzfp) {
+        if (gzseek(reader->gzfp, offset, SEEK_SET) == -1) return -1;
+        return gzread(reader->gzfp, buf, len);
+    }
+    
+    return meta_pread(reader->meta, buf, len, offset);
+}
+
+// Clip [*p_beg_i, *p_end_i) to the sequence; returns 0 if the region is empty
+static int clip_region(const faidx1_t *entry, hts_pos_t *p_beg_i, hts_pos_t *p_end_i) {
+    if (*p_beg_i < 0) *p_beg_i = 0;
+    if (*p_end_i < 0 || *p_end_i > entry->len) *p_end_i = entry->len;
+    return *p_beg_i < *p_end_i;
+}
+
+// Base transforms applied while fetched bases are copied out (FAI_FETCH_*).
+// xform_lut[flags] maps every byte; the SSSE3 kernel does the same sixteen
+// bytes at a time. Complements cover the IUPAC codes and keep case; other
+// bytes pass through.
+#define FAI_FETCH_MASK (FAI_FETCH_REVCOMP | FAI_FETCH_UPPER | FAI_FETCH_MASK_N)
+
+static uint8_t xform_lut[FAI_FETCH_MASK + 1][256];
+static pthread_once_t xform_lut_once = PTHREAD_ONCE_INIT;
+
+// Uppercase complement of every letter, indexed by its low five bits
+static const char xform_comp[32] = "@TVGHEFCDIJMLKNOPQYSAABWXRZ[\\]^_";
+
+static void xform_lut_init(void) {
+    for (int f = 0; f <= FAI_FETCH_MASK; f++) {
+        for (int c = 0; c < 256; c++) {
+            int v = c;
+            int letter = (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+            if (letter && (f & FAI_FETCH_REVCOMP)) v = xform_comp[c & 0x1f] | (c & 0x20);
+            if (letter && (c & 0x20)) {
+                if (f & FAI_FETCH_MASK_N) v = 'N';
+                else if (f & FAI_FETCH_UPPER) v &= ~0x20;
+            }
+            xform_lut[f][c] = (uint8_t)v;
+        }
+    }
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FAI_XFORM_SSSE3
+
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i xform_vec(__m128i v, int flags, __m128i lo, __m128i hi) {
+    const __m128i lower_bit = _mm_set1_epi8(0x20);
+    __m128i t = _mm_sub_epi8(_mm_or_si128(v, lower_bit), _mm_set1_epi8('a'));
+    __m128i letter = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+
+    if (flags & FAI_FETCH_REVCOMP) {
+        __m128i idx = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+        __m128i upper_half = _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8(0x10)),
+                                            _mm_set1_epi8(0x10));
+        __m128i comp = _mm_or_si128(_mm_and_si128(upper_half, _mm_shuffle_epi8(hi, idx)),
+                                    _mm_andnot_si128(upper_half, _mm_shuffle_epi8(lo, idx)));
+        comp = _mm_or_si128(comp, _mm_and_si128(v, lower_bit));
+        v = _mm_or_si128(_mm_and_si128(letter, comp), _mm_andnot_si128(letter, v));
+    }
+    if (flags & (FAI_FETCH_UPPER | FAI_FETCH_MASK_N)) {
+        __m128i lower = _mm_and_si128(letter, _mm_cmpeq_epi8(_mm_and_si128(v, lower_bit), lower_bit));
+        if (flags & FAI_FETCH_MASK_N) {
+            v = _mm_or_si128(_mm_and_si128(lower, _mm_set1_epi8('N')), _mm_andnot_si128(lower, v));
+        } else {
+            v = _mm_andnot_si128(_mm_and_si128(lower, lower_bit), v);
+        }
+    }
+    return v;
+}
+
+// Copy n >= 16 transformed bytes; with FAI_FETCH_REVCOMP, dst receives them
+// in reverse order. A ragged tail is covered by one last vector overlapping
+// the previous one, except in place, where it would be transformed twice.
+// Returns the number of bytes handled. Inlined once per flags value so the
+// flag tests fold away.
+__attribute__((target("ssse3"), always_inline))
+static inline size_t xform_copy_vec(char *dst, const char *src, size_t n, int flags) {
+    const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i lo = _mm_loadu_si128((const __m128i *)xform_comp);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)(xform_comp + 16));
+    size_t i = 0;
+    for (;;) {
+        __m128i v = xform_vec(_mm_loadu_si128((const __m128i *)(src + i)), flags, lo, hi);
+        if (flags & FAI_FETCH_REVCOMP) {
+            _mm_storeu_si128((__m128i *)(dst + n - i - 16), _mm_shuffle_epi8(v, rev));
+        } else {
+            _mm_storeu_si128((__m128i *)(dst + i), v);
+        }
+        if (i + 16 == n) return n;
+        i += 16;
+        if (i + 16 > n) {
+            if (dst == src) return i;
+            i = n - 16;
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+static size_t xform_copy_ssse3(char *dst, const char *src, size_t n, int flags) {
+    switch (flags) {
+    case 1: return xform_copy_vec(dst, src, n, 1);
+    case 2: return xform_copy_vec(dst, src, n, 2);
+    case 3: return xform_copy_vec(dst, src, n, 3);
+    case 4: return xform_copy_vec(dst, src, n, 4);
+    case 5: return xform_copy_vec(dst, src, n, 5);
+    case 6: return xform_copy_vec(dst, src, n, 6);
+    default: return xform_copy_vec(dst, src, n, 7);
+    }
+}
+#endif
+
+// Copy n bases from src to dst applying flags; with FAI_FETCH_REVCOMP the
+// bases land in reverse order, so dst[n - 1] receives src[0]
+static void xform_copy(char *dst, const char *src, size_t n, int flags) {
+    flags &= FAI_FETCH_MASK;
+    if (!flags) {
+        memcpy(dst, src, n);
+        return;
+    }
+
+    size_t i = 0;
+#ifdef FAI_XFORM_SSSE3
+    if (n >= 16 && __builtin_cpu_supports("ssse3")) i = xform_copy_ssse3(dst, src, n, flags);
+#endif
+    pthread_once(&xform_lut_once, xform_lut_init);
+    const uint8_t *lut = xform_lut[flags];
+    if (flags & FAI_FETCH_REVCOMP) {
+        for (; i < n; i++) dst[n - 1 - i] = (char)lut[(uint8_t)src[i]];
+    } else {
+        for (; i < n; i++) dst[i] = (char)lut[(uint8_t)src[i]];
+    }
+}
+
+// Apply flags to n bases in place (for bases that are not copied out of a
+// raw buffer, such as the packed store's)
+static void xform_inplace(char *buf, size_t n, int flags) {
+    flags &= FAI_FETCH_MASK;
+    if (!flags) return;
+    pthread_once(&xform_lut_once, xform_lut_init);
+    const uint8_t *lut = xform_lut[flags];
+    if (flags & FAI_FETCH_REVCOMP) {
+        for (size_t i = 0, j = n; i < j--; i++) {
+            char a = buf[i];
+            buf[i] = (char)lut[(uint8_t)buf[j]];
+            buf[j] = (char)lut[(uint8_t)a];
+        }
+    } else {
+        xform_copy(buf, buf, n, flags);
+    }
+}
+
+// Copy run bases from src to where they belong in a region's dst (reverse
+// complemented runs fill it from the end), transformed by flags
+static inline void deline_copy(char *dst, const char *src, hts_pos_t written, hts_pos_t run,
+                               hts_pos_t seq_len, int flags) {
+    if (flags & FAI_FETCH_REVCOMP) {
+        xform_copy(dst + seq_len - written - run, src, run, flags);
+    } else {
+        xform_copy(dst + written, src, run, flags);
+    }
+}
+
+static inline int has_terminator(const char *s, size_t n) {
+    return memchr(s, '\n', n) || memchr(s, '\r', n);
+}
+
+// Copy bases out of raw using the .fai line layout: runs of line_blen bases
+// (the first one shortened by the start column) separated by
+// line_len - line_blen terminator bytes; len is the whole sequence's length.
+// Returns the number of bases written, or -1 if raw runs out or (when check
+// is set) a terminator is not where the layout puts it: between runs, inside
+// one, or in the byte after the last, if raw holds it. Always inlined, so
+// that the kernels below that pass constant widths get constant column
+// arithmetic and full-line copies.
+static inline __attribute__((always_inline)) hts_pos_t
+deline_lines(const char *raw, int64_t n, hts_pos_t p_beg_i, uint32_t line_blen,
+             uint32_t line_len, uint64_t len, char *dst, hts_pos_t seq_len, int flags,
+             int check) {
+    uint32_t term = line_len - line_blen;
+    int plain = !(flags & FAI_FETCH_MASK);
+    hts_pos_t run = line_blen - p_beg_i % line_blen;
+    if (run > seq_len) run = seq_len;
+    if (run > n) return -1;
+    deline_copy(dst, raw, 0, run, seq_len, flags);
+    
+    hts_pos_t written = run;
+    int64_t pos = run;
+    while (written < seq_len) {
+        run = seq_len - written < line_blen ? seq_len - written : line_blen;
+        if (pos + term + run > n) return -1;
+        for (uint32_t i = 0; check && i < term; i++) {
+            if (raw[pos + i] != '\n' && raw[pos + i] != '\r') return -1;
+        }
+        pos += term;
+        if (plain && run == line_blen) {
+            memcpy(dst + written, raw + pos, line_blen);
+        } else {
+            deline_copy(dst, raw + pos, written, run, seq_len, flags);
+        }
+        written += run;
+        pos += run;
+    }
+    
+    if (!check) return written;
+    
+    // The flags leave terminators as they are, so any copied one is still
+    // in dst; a line ends after the last base only at a full column or the
+    // sequence's end
+    if (has_terminator(dst, written)) return -1;
+    if (pos < n) {
+        hts_pos_t end = p_beg_i + seq_len;
+        int at_end = end % line_blen == 0 || (uint64_t)end == len;
+        if ((raw[pos] == '\n' || raw[pos] == '\r') != at_end) return -1;
+    }
+    return written;
+}
+
+// File bytes covering [p_beg_i, p_end_i) of the sequence (or, with the
+// quality offset as base, the quality string) of an entry, newlines included
+static inline __attribute__((always_inline)) void
+span_lines(uint64_t base, uint32_t line_blen, uint32_t line_len,
+           hts_pos_t p_beg_i, hts_pos_t p_end_i, uint64_t *file_beg, uint64_t *file_end) {
+    // .fai gives us: line_blen (bases per line), line_len (bytes per line with \n)
+    *file_beg = base + (p_beg_i / line_blen) * line_len + p_beg_i % line_blen;
+    *file_end = base + (p_end_i / line_blen) * line_len + p_end_i % line_blen;
+}
+
+// A kernel de-lines a region with deline_lines and finds its bytes with
+// span_lines, for one layout
+typedef struct {
+    hts_pos_t (*deline)(const faidx1_t *e, hts_pos_t p_beg_i, const char *raw, int64_t n,
+                        char *dst, hts_pos_t seq_len, int flags, int check);
+    void (*span)(const faidx1_t *e, uint64_t base, hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                 uint64_t *file_beg, uint64_t *file_end);
+} fai_kernel_t;
+
+static hts_pos_t deline_generic(const faidx1_t *e, hts_pos_t p_beg_i, const char *raw,
+                                int64_t n, char *dst, hts_pos_t seq_len, int flags, int check) {
+    if (e->line_len <= e->line_blen) return -1;
+    return deline_lines(raw, n, p_beg_i, e->line_blen, e->line_len, e->len, dst, seq_len, flags,
+                        check);
+}
+
+static void span_generic(const faidx1_t *e, uint64_t base, hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                         uint64_t *file_beg, uint64_t *file_end) {
+    span_lines(base, e->line_blen, e->line_len, p_beg_i, p_end_i, file_beg, file_end);
+}
+
+// A single-line region is contiguous: one copy
+static hts_pos_t deline_single(const faidx1_t *e, hts_pos_t p_beg_i, const char *raw,
+                               int64_t n, char *dst, hts_pos_t seq_len, int flags, int check) {
+    (void)e;
+    (void)p_beg_i;
+    (void)check;
+    if (n < seq_len) return -1;
+    xform_copy(dst, raw, seq_len, flags);
+    return seq_len;
+}
+
+static void span_single(const faidx1_t *e, uint64_t base, hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                        uint64_t *file_beg, uint64_t *file_end) {
+    (void)e;
+    *file_beg = base + p_beg_i;
+    *file_end = base + p_end_i;
+}
+
+#define FAI_KERNEL(name, blen, term)                                                         \
+    static hts_pos_t deline_##name(const faidx1_t *e, hts_pos_t p_beg_i, const char *raw,   \
+                                   int64_t n, char *dst, hts_pos_t seq_len, int flags,      \
+                                   int check) {                                             \
+        return deline_lines(raw, n, p_beg_i, blen, blen + term, e->len, dst, seq_len,      \
+                            flags, check);                                                  \
+    }                                                                                       \
+    static void span_##name(const faidx1_t *e, uint64_t base, hts_pos_t p_beg_i,            \
+                            hts_pos_t p_end_i, uint64_t *file_beg, uint64_t *file_end) {    \
+        (void)e;                                                                            \
+        span_lines(base, blen, blen + term, p_beg_i, p_end_i, file_beg, file_end);          \
+    }
+
+FAI_KERNEL(lf60, 60, 1)
+FAI_KERNEL(lf70, 70, 1)
+FAI_KERNEL(lf80, 80, 1)
+FAI_KERNEL(crlf60, 60, 2)
+FAI_KERNEL(crlf70, 70, 2)
+FAI_KERNEL(crlf80, 80, 2)
+
+// Indexed by FAI_KERNEL_*
+static const fai_kernel_t fai_kernels[] = {
+    {deline_generic, span_generic},
+    {deline_single, span_single},
+    {deline_lf60, span_lf60},
+    {deline_lf70, span_lf70},
+    {deline_lf80, span_lf80},
+    {deline_crlf60, span_crlf60},
+    {deline_crlf70, span_crlf70},
+    {deline_crlf80, span_crlf80},
+};
+
+static inline void region_file_span(const faidx1_t *entry, uint64_t base,
+                                    hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                    uint64_t *file_beg, uint64_t *file_end) {
+    fai_kernels[entry->kernel].span(entry, base, p_beg_i, p_end_i, file_beg, file_end);
+}
+
+// Note a raw read of [offset, offset + len) and return how many blocks to
+// read ahead of it: reads that start at or after the previous one and no
+// more than a block past its end count as moving forward
+static int readahead_window(faidx_reader_t *reader, uint64_t offset, int64_t len) {
+    int forward = offset >= reader->ra_ubeg && offset <= reader->ra_uend + BGZF_MAX_BLOCK_SIZE;
+    reader->ra_streak = forward ? reader->ra_streak + 1 : 0;
+    reader->ra_ubeg = offset;
+    reader->ra_uend = offset + len;
+
+    if (reader->ra_mode > 0) return reader->ra_mode;
+    if (reader->ra_mode < 0 && reader->ra_streak >= FAI_READAHEAD_STREAK) {
+        return FAI_READAHEAD_BLOCKS;
+    }
+    return 0;
+}
+
+// Start reading ahead of uend, the end of the bytes just read
+static void readahead_after(faidx_reader_t *reader, uint64_t uend, int window) {
+    faidx_meta_t *meta = reader->meta;
+
+    if (meta->is_bgzf) {
+        if (!window) {
+            if (reader->ra) readahead_move(reader->ra, 0, 0);
+            return;
+        }
+        if (!reader->ra) {
+            // Without a spare CPU the thread would only compete with the reader
+            if (reader->ra_mode < 0 && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+                reader->ra_mode = 0;
+                return;
+            }
+            int n = reader->ra_mode > 0 ? reader->ra_mode : FAI_READAHEAD_BLOCKS;
+            reader->ra = readahead_create(meta, n);
+            if (!reader->ra) {
+                reader->ra_mode = 0;
+                return;
+            }
+        }
+        // The block holding uend - 1 is in ublock already
+        const gzi_index_t *index = meta->gzi_index;
+        int k = gzi_find_block(index, uend);
+        if (uend > index->entries[k].uncompressed_offset) k++;
+        readahead_move(reader->ra, k, window);
+        return;
+    }
+
+    // Uncompressed files: hint the next span once half the last one is used
+    uint64_t span = (uint64_t)window * BGZF_MAX_BLOCK_SIZE;
+    if (!window || (uend < reader->ra_advised && reader->ra_advised - uend > span / 2)) return;
+    if (meta->map) {
+        long page = sysconf(_SC_PAGESIZE);
+        uint64_t beg = uend & ~(uint64_t)(page - 1);
+        if (beg >= meta->map_size) return;
+        if (span > meta->map_size - beg) span = meta->map_size - beg;
+        madvise((void *)(meta->map + beg), span, MADV_WILLNEED);
+        reader->ra_advised = beg + span;
+    } else if (reader->fd >= 0 && !reader->gzfp) {
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(reader->fd, uend, span, POSIX_FADV_WILLNEED);
+#endif
+        reader->ra_advised = uend + span;
+    }
+}
+
+// Point *raw at len file bytes starting at offset: straight into the mapping
+// when there is one, otherwise read into the reader's raw buffer. Returns
+// the number of bytes available or -1.
+static int64_t reader_raw_span(faidx_reader_t *reader, uint64_t offset, int64_t len,
+                               const char **raw) {
+    const faidx_meta_t *meta = reader->meta;
+    int window = readahead_window(reader, offset, len);
+    if (meta->map) {
+        // Mapped files are de-lined straight from the page cache
+        int64_t avail = offset < meta->map_size ? meta->map_size - offset : 0;
+        *raw = meta->map + offset;
+        if (avail > len) avail = len;
+        readahead_after(reader, offset + avail, window);
+        STAT_ADD(reader, bytes_read, avail);
+        stats_lap(reader, FAI_PHASE_READ);
+        return avail;
+    }
+
+    // The raw bytes (newlines included) live until the fetch ends
+    char *buf = arena_alloc(&reader->arena, len);
+    if (!buf) return -1;
+
+    *raw = buf;
+    int64_t got = reader_read(reader, offset, buf, len);
+    if (got > 0) {
+        readahead_after(reader, offset + got, window);
+        STAT_ADD(reader, bytes_read, got);
+    }
+    stats_lap(reader, FAI_PHASE_READ);
+    return got;
+}
+
+// Copy a region's bases out of the n raw bytes the .fai puts it in with the
+// entry's kernel. Returns the number of bases written, or -1 if the layout
+// does not explain raw; terminators are only looked at when check is set.
+static inline hts_pos_t deline_layout(const faidx1_t *entry, hts_pos_t p_beg_i,
+                                      const char *raw, int64_t n, char *dst,
+                                      hts_pos_t seq_len, int flags, int check) {
+    return fai_kernels[entry->kernel].deline(entry, p_beg_i, raw, n, dst, seq_len, flags, check);
+}
+
+// Line tables are checkpointed at least this many file bytes apart, and
+// sequences are checked this many bytes at a time
+#define FAI_LINES_STEP (64 << 10)
+#define FAI_LINES_READ (1 << 20)
+
+static inline int lines_irregular(const struct fai_lines_t *t) {
+    return t && t != &fai_lines_regular && t != &fai_lines_probed;
+}
+
+static inline int lines_checked(const struct fai_lines_t *t) {
+    return t && t != &fai_lines_probed;
+}
+
+static int lines_push(struct fai_lines_t *t, uint64_t base, uint64_t offset) {
+    if (t->n == t->m) {
+        uint64_t m = t->m ? t->m * 2 : 64;
+        uint64_t *b = realloc(t->base, m * sizeof(uint64_t));
+        if (!b) return -1;
+        t->base = b;
+        uint64_t *o = realloc(t->offset, m * sizeof(uint64_t));
+        if (!o) return -1;
+        t->offset = o;
+        t->m = m;
+    }
+    t->base[t->n] = base;
+    t->offset[t->n] = offset;
+    t->n++;
+    return 0;
+}
+
+// Read an entry's sequence and check every line against its .fai line
+// lengths. Returns the regular marker if they all match, a line table if
+// one does not (or the file ends early), or NULL on a read error.
+static struct fai_lines_t *lines_scan(faidx_reader_t *reader, const faidx1_t *e) {
+    struct fai_lines_t *t = calloc(1, sizeof(*t));
+    arena_mark_t mark = arena_mark(&reader->arena);
+    char *buf = t ? arena_alloc(&reader->arena, FAI_LINES_READ) : NULL;
+    int ok = buf && lines_push(t, 0, e->seq_offset) == 0;
+    int regular = 1;
+    uint64_t offset = e->seq_offset, bases = 0;
+    uint64_t col = 0, width = 0;        // Bases and bytes on the current line
+    
+    while (ok && bases < e->len) {
+        int64_t got = reader_read(reader, offset, buf, FAI_LINES_READ);
+        if (got <= 0) {
+            ok = got == 0;
+            regular = 0;
+            break;
+        }
+        for (int64_t i = 0; i < got && bases < e->len; i++) {
+            char c = buf[i];
+            if (c == '\n') {
+                // Every line before the last must be a full one
+                if (col != e->line_blen || width + 1 != e->line_len) regular = 0;
+                col = width = 0;
+                continue;
+            }
+            width++;
+            if (c == '\r') continue;
+            if (offset + i - t->offset[t->n - 1] >= FAI_LINES_STEP &&
+                lines_push(t, bases, offset + i) < 0) {
+                ok = 0;
+                break;
+            }
+            if (++col > e->line_blen) regular = 0;
+            bases++;
+            if (bases == e->len) offset += i + 1;
+        }
+        if (bases < e->len) offset += got;
+    }
+    arena_release(&reader->arena, mark);
+    
+    if (ok && !regular) ok = lines_push(t, bases, offset) == 0;
+    if (!ok || regular) {
+        lines_free(t);
+        return ok ? &fai_lines_regular : NULL;
+    }
+    return t;
+}
+
+// Look at the bytes around the last base of an entry's sequence: a base
+// where the .fai puts it, then a line end and a record start (or the end of
+// the file). Returns the probed marker if they are there, what lines_scan
+// makes of the sequence if not, or NULL on a read error. Ragged lines that
+// move the sequence's end fail this; ragged lines that add up to the .fai's
+// layout do not.
+static struct fai_lines_t *lines_probe(faidx_reader_t *reader, const faidx1_t *e) {
+    uint64_t file_beg, file_end;
+    region_file_span(e, e->seq_offset, e->len - 1, e->len, &file_beg, &file_end);
+    char b[4];
+    int64_t got = reader_read(reader, file_beg, b, sizeof(b));
+    if (got < 0) return NULL;
+    
+    int64_t i = 1;
+    int ok = got > 0 && b[0] != '\n' && b[0] != '\r';
+    if (ok && i < got && b[i] == '\r') i++;
+    if (ok && i < got) ok = b[i++] == '\n';
+    if (ok && i < got) ok = b[i] == '>' || b[i] == '+' || b[i] == '\n' || b[i] == '\r';
+    return ok ? &fai_lines_probed : lines_scan(reader, e);
+}
+
+// The layout of an entry's sequence as far as it is known. An unchecked one
+// is checked now if check is set, and otherwise probed, if it has more than
+// one line; the result is NULL if it cannot be.
+static const struct fai_lines_t *entry_lines(faidx_reader_t *reader, const faidx1_t *e,
+                                             int check) {
+    faidx_meta_t *meta = reader->meta;
+    struct fai_lines_t **slots = __atomic_load_n(&meta->lines, __ATOMIC_ACQUIRE);
+    struct fai_lines_t *t = slots ? __atomic_load_n(&slots[e->id], __ATOMIC_ACQUIRE) : NULL;
+    if (lines_checked(t) || (t && !check)) return t;
+    if (!check && e->layout == FAI_LAYOUT_SINGLE) return NULL;
+    
+    // Scan outside the lock; a reader that loses the race keeps the
+    // winner's, unless it checked what the winner only probed
+    t = check ? lines_scan(reader, e) : lines_probe(reader, e);
+    if (!t) return NULL;
+    pthread_mutex_lock(&meta->lines_mutex);
+    if (!meta->lines) {
+        __atomic_store_n(&meta->lines, calloc(meta->n, sizeof(*meta->lines)), __ATOMIC_RELEASE);
+    }
+    struct fai_lines_t *had = meta->lines ? meta->lines[e->id] : NULL;
+    if (!meta->lines) {
+        lines_free(t);
+        t = NULL;
+    } else if (lines_checked(had) || (had && !lines_checked(t))) {
+        lines_free(t);
+        t = had;
+    } else {
+        __atomic_store_n(&meta->lines[e->id], t, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&meta->lines_mutex);
+    return t;
+}
+
+// Fetch [p_beg_i, p_end_i) of an irregular sequence through its line table:
+// one read from the last checkpoint before the region to the first after it
+static hts_pos_t fetch_irregular(faidx_reader_t *reader, const struct fai_lines_t *t,
+                                 hts_pos_t p_beg_i, hts_pos_t p_end_i, char *dst, int flags) {
+    uint64_t lo = 0, hi = t->n - 1;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi + 1) / 2;
+        if (t->base[mid] <= (uint64_t)p_beg_i) lo = mid;
+        else hi = mid - 1;
+    }
+    uint64_t first = lo;
+    hi = t->n - 1;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (t->base[mid] >= (uint64_t)p_end_i) hi = mid;
+        else lo = mid + 1;
+    }
+    
+    const char *raw;
+    int64_t got = reader_raw_span(reader, t->offset[first], t->offset[lo] - t->offset[first], &raw);
+    if (got < 0) return -1;
+    
+    uint64_t skip = p_beg_i - t->base[first];
+    hts_pos_t want = p_end_i - p_beg_i, written = 0;
+    for (int64_t i = 0; i < got && written < want; i++) {
+        char c = raw[i];
+        if (c == '\n' || c == '\r') continue;
+        if (skip) {
+            skip--;
+            continue;
+        }
+        dst[written++] = c;
+    }
+    xform_inplace(dst, written, flags);
+    return written;
+}
+
+// Strip newlines from the n raw bytes the .fai puts [p_beg_i,
+// p_beg_i + seq_len) of an entry's sequence (base is seq_offset) or quality
+// in, applying flags; returns the number of bases written (at most seq_len).
+// raw may run past those bytes; the byte after them is checked if it is
+// there. lines is the sequence's layout as far as it is known: regular lines
+// are copied without looking at their terminators, irregular ones are
+// fetched through their table. An unchecked sequence the layout does not
+// explain is checked here.
+static hts_pos_t deline_region(faidx_reader_t *reader, const faidx1_t *entry, uint64_t base,
+                               const struct fai_lines_t *lines, hts_pos_t p_beg_i,
+                               const char *raw, int64_t n, char *dst, hts_pos_t seq_len,
+                               int flags) {
+    int is_seq = base == entry->seq_offset;
+    if (is_seq && lines_irregular(lines)) {
+        return fetch_irregular(reader, lines, p_beg_i, p_beg_i + seq_len, dst, flags);
+    }
+    
+    hts_pos_t written = deline_layout(entry, p_beg_i, raw, n, dst, seq_len, flags,
+                                      !(is_seq && lines == &fai_lines_regular));
+    if (written >= 0) return written;
+    
+    if (is_seq && !lines_checked(lines)) {
+        lines = entry_lines(reader, entry, 1);
+        if (lines_irregular(lines)) {
+            return fetch_irregular(reader, lines, p_beg_i, p_beg_i + seq_len, dst, flags);
+        }
+    }
+    
+    // No layout explains the bytes (a quality string, a file cut short, or
+    // one that changed since its check): strip newlines in one pass
+    uint64_t file_beg, file_end;
+    region_file_span(entry, base, p_beg_i, p_beg_i + seq_len, &file_beg, &file_end);
+    if (n > (int64_t)(file_end - file_beg)) n = file_end - file_beg;
+    hts_pos_t write_pos = 0;
+    for (int64_t i = 0; i < n && write_pos < seq_len; i++) {
+        char c = raw[i];
+        if (c != '\n' && c != '\r') {
+            dst[write_pos++] = c;
+        }
+    }
+
+    xform_inplace(dst, write_pos, flags);
+    return write_pos;
+}
+
+// De-line [p_beg_i, p_end_i) of an entry's sequence (or quality, with
+// qual_offset as base) into dst, which must hold p_end_i - p_beg_i bytes,
+// applying the FAI_FETCH_* flags, and finish the fetch's statistics.
+// Returns the number of bases written or -1.
+static hts_pos_t fetch_region(faidx_reader_t *reader, const faidx1_t *entry, uint64_t base,
+                              hts_pos_t p_beg_i, hts_pos_t p_end_i, char *dst, int flags) {
+    if (reader->meta->pack && base == entry->seq_offset) {
+        hts_pos_t n = pack_fetch(reader->meta->pack, entry, p_beg_i, p_end_i, dst);
+        xform_inplace(dst, n, flags);
+        stats_lap(reader, FAI_PHASE_DELINE);
+        stats_end(reader, 1, n);
+        return n;
+    }
+
+    // Line lengths no layout fits give no file span: check those first
+    const struct fai_lines_t *lines = NULL;
+    if (base == entry->seq_offset) {
+        lines = entry_lines(reader, entry, entry->layout == FAI_LAYOUT_IRREGULAR);
+        if (!lines && entry->layout == FAI_LAYOUT_IRREGULAR) return -1;
+    }
+    if (lines_irregular(lines)) {
+        hts_pos_t n = fetch_irregular(reader, lines, p_beg_i, p_end_i, dst, flags);
+        if (n < 0) return -1;
+        stats_lap(reader, FAI_PHASE_DELINE);
+        stats_end(reader, 1, n);
+        return n;
+    }
+
+    uint64_t file_beg, file_end;
+    region_file_span(entry, base, p_beg_i, p_end_i, &file_beg, &file_end);
+
+    // ONE read of all bytes, and the one after them for an unchecked layout
+    int64_t span = file_end - file_beg + (lines != &fai_lines_regular);
+    const char *raw;
+    int64_t bytes_read = reader_raw_span(reader, file_beg, span, &raw);
+    if (bytes_read < 0) return -1;
+
+    hts_pos_t n = deline_region(reader, entry, base, lines, p_beg_i, raw, bytes_read, dst,
+                                p_end_i - p_beg_i, flags);
+    if (n < 0) return -1;
+    stats_lap(reader, FAI_PHASE_DELINE);
+    stats_end(reader, 1, n);
+    return n;
+}
+
+char *faidx_reader_fetch_seq(faidx_reader_t *reader, const char *c_name,
+                           hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
+    if (!reader || !c_name) return NULL;
+
+    faidx1_t *entry = reader_lookup(reader, c_name);
+    if (!entry || entry->line_blen == 0) return NULL;
+
+    // Adjust coordinates
+    if (!clip_region(entry, &p_beg_i, &p_end_i)) return NULL;
+
+    char *seq = malloc(p_end_i - p_beg_i + 1);
+    if (!seq) return NULL;
+
+    hts_pos_t write_pos = fetch_region(reader, entry, entry->seq_offset, p_beg_i, p_end_i, seq, 0);
+    if (write_pos <= 0) {
+        free(seq);
+        return NULL;
+    }
+    seq[write_pos] = '\0';
+
+    if (len) *len = write_pos;
+    return seq;
+}
+
+hts_pos_t faidx_reader_fetch_seq_into(faidx_reader_t *reader, const char *c_name,
+                                      hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                      char *buf, size_t buf_size) {
+    return faidx_reader_fetch_seq_into_flags(reader, c_name, p_beg_i, p_end_i, buf, buf_size, 0);
+}
+
+hts_pos_t faidx_reader_fetch_seq_into_flags(faidx_reader_t *reader, const char *c_name,
+                                            hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                            char *buf, size_t buf_size, int flags) {
+    if (!reader || !c_name) return -1;
+
+    faidx1_t *entry = reader_lookup(reader, c_name);
+    if (!entry) return -1;
+    if (entry->line_blen == 0 || !clip_region(entry, &p_beg_i, &p_end_i)) return 0;
+
+    hts_pos_t seq_len = p_end_i - p_beg_i;
+    if ((size_t)seq_len > buf_size) return seq_len;
+    if (!buf) return -1;
+
+    return fetch_region(reader, entry, entry->seq_offset, p_beg_i, p_end_i, buf, flags);
+}
+
+// Fetch [beg, end) of an entry's sequence into buf, which must hold it, for
+// callers that walk the entries rather than look them up by name
+static hts_pos_t fetch_entry(faidx_reader_t *reader, const faidx1_t *e, hts_pos_t beg,
+                             hts_pos_t end, char *buf) {
+    reader_begin(reader, 1);
+    return fetch_region(reader, e, e->seq_offset, beg, end, buf, 0);
+}
+
+char *faidx_meta_fetch_seq(faidx_meta_t *meta, const char *c_name,
+                           hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
+    if (!meta) return NULL;
+
+    faidx_reader_t scratch;
+    char *seq = NULL;
+    if (reader_init(&scratch, meta) == 0) {
+        scratch.ra_mode = 0;
+        reader_share_stats(&scratch);
+        seq = faidx_reader_fetch_seq(&scratch, c_name, p_beg_i, p_end_i, len);
+    }
+    reader_release(&scratch);
+    return seq;
+}
+
+hts_pos_t faidx_meta_fetch_seq_into(faidx_meta_t *meta, const char *c_name,
+                                    hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                    char *buf, size_t buf_size) {
+    return faidx_meta_fetch_seq_into_flags(meta, c_name, p_beg_i, p_end_i, buf, buf_size, 0);
+}
+
+hts_pos_t faidx_meta_fetch_seq_into_flags(faidx_meta_t *meta, const char *c_name,
+                                          hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                          char *buf, size_t buf_size, int flags) {
+    if (!meta) return -1;
+
+    faidx_reader_t scratch;
+    hts_pos_t ret = -1;
+    if (reader_init(&scratch, meta) == 0) {
+        scratch.ra_mode = 0;
+        reader_share_stats(&scratch);
+        ret = faidx_reader_fetch_seq_into_flags(&scratch, c_name, p_beg_i, p_end_i,
+                                                buf, buf_size, flags);
+    }
+    reader_release(&scratch);
+    return ret;
+}
+
+// Parallel fetches cut a region into about FAI_PARALLEL_SPLIT chunks per
+// thread, so that threads finishing early take more, of at least
+// FAI_PARALLEL_MIN bases each
+#define FAI_PARALLEL_SPLIT 4
+#define FAI_PARALLEL_MIN (1 << 20)
+
+// A region fetched in chunks by several threads; chunk c is
+// [cuts[c], cuts[c + 1])
+typedef struct {
+    faidx_meta_t *meta;
+    const faidx1_t *entry;
+    const hts_pos_t *cuts;
+    int n_chunks;
+    int next;                    // Next chunk to claim
+    int failed;
+    hts_pos_t beg, end;
+    char *dst;
+    int flags;
+} fai_pfetch_t;
+
+static void *pfetch_main(void *arg) {
+    fai_pfetch_t *p = arg;
+    faidx_reader_t reader;
+    if (reader_init(&reader, p->meta) < 0) {
+        __atomic_store_n(&p->failed, 1, __ATOMIC_RELAXED);
+        reader_release(&reader);
+        return NULL;
+    }
+    reader.ra_mode = 0;
+    reader_share_stats(&reader);
+    
+    int c;
+    while (!__atomic_load_n(&p->failed, __ATOMIC_RELAXED) &&
+           (c = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < p->n_chunks) {
+        hts_pos_t beg = p->cuts[c], end = p->cuts[c + 1];
+        // Reverse complemented chunks land in mirror order
+        char *dst = p->flags & FAI_FETCH_REVCOMP ? p->dst + (p->end - end) : p->dst + (beg - p->beg);
+        reader_begin(&reader, 1);
+        if (fetch_region(&reader, p->entry, p->entry->seq_offset, beg, end, dst, p->flags) != end - beg) {
+            __atomic_store_n(&p->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    reader_release(&reader);
+    return NULL;
+}
+
+// Cut [beg, end) of an entry into at most n chunks, moving each cut back to
+// the first base of the BGZF block it falls in so that no block is inflated
+// by two threads. Returns the number of chunks.
+static int parallel_cuts(const faidx_meta_t *meta, const faidx1_t *e,
+                         hts_pos_t beg, hts_pos_t end, int n, hts_pos_t *cuts) {
+    int snap = meta->is_bgzf && !meta->pack &&
+               (e->layout == FAI_LAYOUT_LF || e->layout == FAI_LAYOUT_CRLF);
+    int k = 0;
+    cuts[k++] = beg;
+    for (int i = 1; i < n; i++) {
+        hts_pos_t cut = beg + (end - beg) * i / n;
+        if (snap) {
+            uint64_t file_beg, file_end;
+            region_file_span(e, e->seq_offset, cut, cut, &file_beg, &file_end);
+            const gzi_index_t *index = meta->gzi_index;
+            uint64_t block = index->entries[gzi_find_block(index, file_beg)].uncompressed_offset;
+            if (block > e->seq_offset) {
+                // The first base at or after the block start
+                uint64_t rel = block - e->seq_offset;
+                uint64_t col = rel % e->line_len;
+                cut = rel / e->line_len * e->line_blen + (col < e->line_blen ? col : e->line_blen);
+            }
+        }
+        if (cut > cuts[k - 1] && cut < end) cuts[k++] = cut;
+    }
+    cuts[k] = end;
+    return k;
+}
+
+hts_pos_t faidx_meta_fetch_seq_parallel(faidx_meta_t *meta, const char *c_name,
+                                        hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                        char *buf, size_t buf_size, int flags,
+                                        int n_threads) {
+    if (!meta || !c_name) return -1;
+    
+    const faidx1_t *entry = hash_get(meta->hash, c_name);
+    if (!entry) return -1;
+    if (entry->line_blen == 0 || !clip_region(entry, &p_beg_i, &p_end_i)) return 0;
+    
+    hts_pos_t seq_len = p_end_i - p_beg_i;
+    if ((size_t)seq_len > buf_size) return seq_len;
+    if (!buf) return -1;
+    
+    if (n_threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n > 0 ? (int)n : 1;
+    }
+    if (meta->is_gzip) n_threads = 1;
+    hts_pos_t max_chunks = (seq_len + FAI_PARALLEL_MIN - 1) / FAI_PARALLEL_MIN;
+    int n_chunks = max_chunks < (hts_pos_t)n_threads * FAI_PARALLEL_SPLIT
+        ? (int)max_chunks : n_threads * FAI_PARALLEL_SPLIT;
+    
+    hts_pos_t *cuts = malloc((n_chunks + 1) * sizeof(hts_pos_t));
+    pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+    int *started = calloc(n_threads, sizeof(int));
+    if (!cuts || !threads || !started) {
+        free(cuts);
+        free(threads);
+        free(started);
+        return -1;
+    }
+    
+    fai_pfetch_t p = {meta, entry, cuts, 0, 0, 0, p_beg_i, p_end_i, buf, flags};
+    p.n_chunks = parallel_cuts(meta, entry, p_beg_i, p_end_i, n_chunks, cuts);
+    if (n_threads > p.n_chunks) n_threads = p.n_chunks;
+    
+    // The calling thread is worker 0
+    for (int t = 1; t < n_threads; t++) {
+        started[t] = pthread_create(&threads[t], NULL, pfetch_main, &p) == 0;
+    }
+    pfetch_main(&p);
+    for (int t = 1; t < n_threads; t++) {
+        if (started[t]) pthread_join(threads[t], NULL);
+    }
+    
+    free(cuts);
+    free(threads);
+    free(started);
+    return p.failed ? -1 : seq_len;
+}
+
+int faidx_meta_verify(faidx_meta_t *meta) {
+    if (!meta) return -1;
+    // Packed sequences are fetched from memory
+    if (meta->pack && meta->format == FAI_FASTA) return 0;
+    
+    // The check's reads are not fetches, so they get statistics of their own
+    faidx_reader_t scratch;
+    int irregular = reader_init(&scratch, meta) == 0 &&
+                    (scratch.stats = calloc(1, sizeof(faidx_stats_t))) ? 0 : -1;
+    scratch.ra_mode = 0;
+    for (int i = 0; irregular >= 0 && i < meta->n; i++) {
+        // By position, so that records sharing a name are all checked
+        const faidx1_t *e = &meta->hash->entries[i];
+        if (e->len == 0 || e->line_blen == 0) continue;
+        
+        const struct fai_lines_t *lines = entry_lines(&scratch, e, 1);
+        if (!lines) irregular = -1;
+        else if (lines_irregular(lines)) irregular++;
+    }
+    reader_release(&scratch);
+    return irregular;
+}
+
+// A resolved batch region and where its bytes sit in the file
+typedef struct {
+    uint64_t file_beg, file_end;
+    const faidx1_t *entry;
+    const struct fai_lines_t *lines;
+    hts_pos_t beg, end;
+    size_t idx;                  // Position in the caller's array
+} batch_span_t;
+
+static int batch_span_cmp(const void *a, const void *b) {
+    const batch_span_t *x = a, *y = b;
+    if (x->file_beg != y->file_beg) return x->file_beg < y->file_beg ? -1 : 1;
+    if (x->file_end != y->file_end) return x->file_end < y->file_end ? -1 : 1;
+    return 0;
+}
+
+// Grow a batch result to hold n regions and len bytes of strings
+static int batch_reserve(faidx_batch_t *batch, size_t n, size_t len) {
+    if (n > batch->n_cap) {
+        size_t cap = batch->n_cap ? batch->n_cap : 64;
+        while (cap < n) cap *= 2;
+        size_t *off = realloc(batch->off, cap * sizeof(size_t));
+        if (!off) return -1;
+        batch->off = off;
+        hts_pos_t *lens = realloc(batch->len, cap * sizeof(hts_pos_t));
+        if (!lens) return -1;
+        batch->len = lens;
+        batch->n_cap = cap;
+    }
+    if (len > batch->seq_cap) {
+        size_t cap = batch->seq_cap ? batch->seq_cap : 4096;
+        while (cap < len) cap *= 2;
+        char *seq = realloc(batch->seq, cap);
+        if (!seq) return -1;
+        batch->seq = seq;
+        batch->seq_cap = cap;
+    }
+    return 0;
+}
+
+// Where region idx of a batch, of size bases, is written: into the
+// contiguous result if there is one, otherwise a malloc'd string of its own
+static char *batch_dst(char **seqs, faidx_batch_t *batch, size_t idx, hts_pos_t size) {
+    if (batch) return batch->seq + batch->off[idx];
+    return seqs[idx] = malloc(size + 1);
+}
+
+// A region of a batch that came back without bases
+static void batch_fail(char **seqs, faidx_batch_t *batch, size_t idx) {
+    if (batch) {
+        batch->seq[batch->off[idx]] = '\0';
+    } else {
+        free(seqs[idx]);
+        seqs[idx] = NULL;
+    }
+}
+
+// Shared by both batch entry points: results go to seqs, or to batch when
+// it is set (lens is then batch->len)
+static int64_t reader_fetch_batch(faidx_reader_t *reader, const faidx_region_t *regions,
+                                  size_t n, char **seqs, hts_pos_t *lens, faidx_batch_t *batch) {
+    reader_begin(reader, n);
+    batch_span_t *spans = arena_alloc(&reader->arena, n * sizeof(batch_span_t));
+    if (!spans) return -1;
+
+    // Resolve names and layout first; empty regions need no I/O, and the
+    // contiguous result is sized before anything is written to it
+    int64_t fetched = 0;
+    int64_t bases = 0;
+    size_t n_spans = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (seqs) seqs[i] = NULL;
+        lens[i] = -1;
+        if (batch) batch->off[i] = total++;
+        if (!regions[i].name) continue;
+
+        const faidx1_t *entry = hash_get(reader->hash, regions[i].name);
+        if (!entry) continue;
+
+        hts_pos_t beg = regions[i].beg, end = regions[i].end;
+        if (entry->line_blen == 0 || !clip_region(entry, &beg, &end)) {
+            if (seqs && !(seqs[i] = calloc(1, 1))) continue;
+            lens[i] = 0;
+            fetched++;
+            continue;
+        }
+
+        batch_span_t *span = &spans[n_spans];
+        span->lines = NULL;
+        if (!reader->meta->pack) {
+            // Irregular sequences are read through their line tables, so
+            // they need no bytes of the group
+            span->lines = entry_lines(reader, entry, entry->layout == FAI_LAYOUT_IRREGULAR);
+            if (!span->lines && entry->layout == FAI_LAYOUT_IRREGULAR) continue;
+            if (lines_irregular(span->lines)) {
+                span->file_beg = span->file_end = entry->seq_offset;
+            } else {
+                region_file_span(entry, entry->seq_offset, beg, end, &span->file_beg, &span->file_end);
+            }
+        }
+        n_spans++;
+        span->entry = entry;
+        span->beg = beg;
+        span->end = end;
+        span->idx = i;
+        total += end - beg;
+    }
+
+    if (batch) {
+        if (batch_reserve(batch, n, total) < 0) {
+            stats_end(reader, 0, 0);
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++) batch->seq[batch->off[i]] = '\0';
+        batch->n = n;
+        batch->seq_len = total;
+    }
+
+    if (reader->meta->pack) {
+        // Packed sequences need no I/O, so there is nothing to group
+        for (size_t g = 0; g < n_spans; g++) {
+            const batch_span_t *span = &spans[g];
+            char *seq = batch_dst(seqs, batch, span->idx, span->end - span->beg);
+            if (!seq) continue;
+            hts_pos_t written = pack_fetch(reader->meta->pack, span->entry, span->beg, span->end, seq);
+            seq[written] = '\0';
+            lens[span->idx] = written;
+            bases += written;
+            fetched++;
+        }
+        n_spans = 0;
+    }
+
+    qsort(spans, n_spans, sizeof(batch_span_t), batch_span_cmp);
+    stats_lap(reader, FAI_PHASE_LOOKUP);
+
+    // Walk the regions in file order, reading each run of overlapping or
+    // adjacent regions with one read. Consecutive runs that share a BGZF
+    // block reuse the reader's last decompressed block.
+    size_t g = 0;
+    while (g < n_spans) {
+        uint64_t group_beg = spans[g].file_beg, group_end = spans[g].file_end;
+        size_t last = g + 1;
+        while (last < n_spans && spans[last].file_beg <= group_end &&
+               (spans[last].file_end <= group_end ||
+                spans[last].file_end - group_beg <= FAI_BATCH_SPAN)) {
+            if (spans[last].file_end > group_end) group_end = spans[last].file_end;
+            last++;
+        }
+
+        arena_mark_t mark = arena_mark(&reader->arena);
+        // One byte more, for the end check of the last region's layout
+        const char *raw;
+        int64_t got = reader_raw_span(reader, group_beg, group_end - group_beg + 1, &raw);
+
+        for (; g < last; g++) {
+            const batch_span_t *span = &spans[g];
+            if (got < 0) continue;
+
+            hts_pos_t seq_len = span->end - span->beg;
+            char *seq = batch_dst(seqs, batch, span->idx, seq_len);
+            if (!seq) continue;
+
+            int64_t off = span->file_beg - group_beg;
+            int64_t avail = got > off ? got - off : 0;
+            hts_pos_t written = deline_region(reader, span->entry, span->entry->seq_offset,
+                                              span->lines, span->beg, raw + off, avail,
+                                              seq, seq_len, 0);
+            if (written <= 0) {
+                batch_fail(seqs, batch, span->idx);
+                continue;
+            }
+            seq[written] = '\0';
+            lens[span->idx] = written;
+            bases += written;
+            fetched++;
+        }
+        arena_release(&reader->arena, mark);
+        stats_lap(reader, FAI_PHASE_DELINE);
+    }
+
+    stats_end(reader, fetched, bases);
+    return fetched;
+}
+
+int64_t faidx_reader_fetch_batch(faidx_reader_t *reader, const faidx_region_t *regions,
+                                 size_t n, char **seqs, hts_pos_t *lens) {
+    if (!reader || (n > 0 && (!regions || !seqs || !lens))) return -1;
+    if (n == 0) return 0;
+    return reader_fetch_batch(reader, regions, n, seqs, lens, NULL);
+}
+
+int64_t faidx_reader_fetch_batch_into(faidx_reader_t *reader, const faidx_region_t *regions,
+                                      size_t n, faidx_batch_t *batch) {
+    if (!reader || !batch || (n > 0 && !regions)) return -1;
+    // The offsets array must exist before resolution fills it in
+    if (batch_reserve(batch, n, 0) < 0) return -1;
+    batch->n = batch->seq_len = 0;
+    if (n == 0) return 0;
+    return reader_fetch_batch(reader, regions, n, NULL, batch->len, batch);
+}
+
+void faidx_batch_free(faidx_batch_t *batch) {
+    if (!batch) return;
+    free(batch->seq);
+    free(batch->off);
+    free(batch->len);
+    memset(batch, 0, sizeof(*batch));
+}
+
+// Entry of a FASTQ record with quality, or NULL
+static const faidx1_t *qual_entry(faidx_reader_t *reader, const char *c_name) {
+    if (!reader || !c_name || reader->meta->format != FAI_FASTQ) return NULL;
+    
+    const faidx1_t *entry = reader_lookup(reader, c_name);
+    if (!entry || entry->qual_offset == 0 || entry->line_blen == 0) return NULL;
+    return entry;
+}
+
+char *faidx_reader_fetch_qual(faidx_reader_t *reader, const char *c_name,
+                            hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
+    const faidx1_t *entry = qual_entry(reader, c_name);
+    if (!entry || !clip_region(entry, &p_beg_i, &p_end_i)) return NULL;
+    
+    char *qual = malloc(p_end_i - p_beg_i + 1);
+    if (!qual) return NULL;
+    
+    hts_pos_t write_pos = fetch_region(reader, entry, entry->qual_offset, p_beg_i, p_end_i, qual, 0);
+    if (write_pos <= 0) {
+        free(qual);
+        return NULL;
+    }
+    qual[write_pos] = '\0';
+    
+    if (len) *len = write_pos;
+    return qual;
+}
+
+int faidx_reader_fetch_seq_qual(faidx_reader_t *reader, const char *c_name,
+                                hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                char **seq, char **qual, hts_pos_t *len) {
+    if (!seq || !qual) return -1;
+    *seq = *qual = NULL;
+    
+    const faidx1_t *entry = qual_entry(reader, c_name);
+    if (!entry || !clip_region(entry, &p_beg_i, &p_end_i)) return -1;
+    
+    // The quality follows the sequence, so one read covers both, unless the
+    // sequence is irregular and read through its line table
+    const struct fai_lines_t *lines = entry_lines(reader, entry,
+                                                  entry->layout == FAI_LAYOUT_IRREGULAR);
+    if (!lines && entry->layout == FAI_LAYOUT_IRREGULAR) return -1;
+    uint64_t seq_beg, seq_end, qual_beg, qual_end;
+    region_file_span(entry, entry->qual_offset, p_beg_i, p_end_i, &qual_beg, &qual_end);
+    if (lines_irregular(lines)) {
+        seq_beg = seq_end = qual_beg;
+    } else {
+        region_file_span(entry, entry->seq_offset, p_beg_i, p_end_i, &seq_beg, &seq_end);
+    }
+    if (qual_beg < seq_end) return -1;
+    
+    const char *raw;
+    int64_t got = reader_raw_span(reader, seq_beg, qual_end - seq_beg, &raw);
+    if (got < 0) return -1;
+    
+    hts_pos_t seq_len = p_end_i - p_beg_i;
+    char *s = malloc(seq_len + 1);
+    char *q = malloc(seq_len + 1);
+    if (!s || !q) {
+        free(s);
+        free(q);
+        return -1;
+    }
+    
+    // The sequence's bytes and the line end after them
+    int64_t seq_span = seq_end - seq_beg + (qual_beg > seq_end);
+    int64_t seq_avail = got < seq_span ? got : seq_span;
+    int64_t qual_off = qual_beg - seq_beg;
+    int64_t qual_avail = got > qual_off ? got - qual_off : 0;
+    hts_pos_t n_seq = deline_region(reader, entry, entry->seq_offset, lines, p_beg_i,
+                                    raw, seq_avail, s, seq_len, 0);
+    hts_pos_t n_qual = deline_region(reader, entry, entry->qual_offset, NULL, p_beg_i,
+                                     raw + qual_off, qual_avail, q, seq_len, 0);
+    stats_lap(reader, FAI_PHASE_DELINE);
+    if (n_seq != seq_len || n_qual != seq_len) {
+        free(s);
+        free(q);
+        return -1;
+    }
+    stats_end(reader, 1, seq_len);
+    s[seq_len] = q[seq_len] = '\0';
+    
+    *seq = s;
+    *qual = q;
+    if (len) *len = seq_len;
+    return 0;
+}
+
+// Asynchronous fetch engine
+typedef struct {
+    const faidx1_t *entry;
+    hts_pos_t beg, end;
+    uint64_t tag;
+    char *seq;
+    hts_pos_t len;
+} async_job_t;
+
+// FIFO ring; pushes never allocate, capacity is reserved beforehand
+typedef struct {
+    async_job_t *jobs;
+    size_t head, n, cap;
+} async_queue_t;
+
+struct faidx_async_t {
+    faidx_meta_t *meta;
+    pthread_mutex_t mutex;
+    pthread_cond_t work;         // Signalled when a request is queued
+    pthread_cond_t done;         // Signalled when a completion is queued
+    async_queue_t requests, completions;
+    size_t pending;              // Submitted and not yet collected
+    int shutdown;
+    void (*notify)(void *);
+    void *notify_data;
+    int n_threads;
+    pthread_t *threads;
+    faidx_reader_t **readers;
+};
+
+typedef struct {
+    faidx_async_t *ctx;
+    faidx_reader_t *reader;
+} async_worker_t;
+
+static int async_queue_reserve(async_queue_t *q, size_t n) {
+    if (n <= q->cap) return 0;
+    size_t cap = q->cap ? q->cap : 64;
+    while (cap < n) cap *= 2;
+    async_job_t *jobs = malloc(cap * sizeof(async_job_t));
+    if (!jobs) return -1;
+    for (size_t i = 0; i < q->n; i++) jobs[i] = q->jobs[(q->head + i) % q->cap];
+    free(q->jobs);
+    q->jobs = jobs;
+    q->head = 0;
+    q->cap = cap;
+    return 0;
+}
+
+static void async_queue_push(async_queue_t *q, const async_job_t *job) {
+    q->jobs[(q->head + q->n++) % q->cap] = *job;
+}
+
+static async_job_t async_queue_pop(async_queue_t *q) {
+    async_job_t job = q->jobs[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->n--;
+    return job;
+}
+
+static void *async_worker_main(void *arg) {
+    async_worker_t *w = arg;
+    faidx_async_t *ctx = w->ctx;
+
+    pthread_mutex_lock(&ctx->mutex);
+    for (;;) {
+        while (!ctx->requests.n && !ctx->shutdown) pthread_cond_wait(&ctx->work, &ctx->mutex);
+        if (ctx->shutdown) break;
+        async_job_t job = async_queue_pop(&ctx->requests);
+        pthread_mutex_unlock(&ctx->mutex);
+
+        // Read and decompress outside the lock
+        reader_begin(w->reader, 1);
+        job.seq = malloc(job.end - job.beg + 1);
+        job.len = job.seq ? fetch_region(w->reader, job.entry, job.entry->seq_offset,
+                                         job.beg, job.end, job.seq, 0) : -1;
+        if (job.len <= 0) {
+            free(job.seq);
+            job.seq = NULL;
+            job.len = -1;
+        } else {
+            job.seq[job.len] = '\0';
+        }
+
+        pthread_mutex_lock(&ctx->mutex);
+        async_queue_push(&ctx->completions, &job);
+        pthread_cond_broadcast(&ctx->done);
+        if (ctx->notify) {
+            pthread_mutex_unlock(&ctx->mutex);
+            ctx->notify(ctx->notify_data);
+            pthread_mutex_lock(&ctx->mutex);
+        }
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    free(w);
+    return NULL;
+}
+
+faidx_async_t *faidx_async_create(faidx_meta_t *meta, int n_threads,
+                                  void (*notify)(void *), void *notify_data) {
+    if (!meta) return NULL;
+    if (n_threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = n > 0 ? (int)n : 1;
+    }
+
+    faidx_async_t *ctx = calloc(1, sizeof(faidx_async_t));
+    if (!ctx) return NULL;
+    ctx->meta = faidx_meta_ref(meta);
+    ctx->notify = notify;
+    ctx->notify_data = notify_data;
+    pthread_mutex_init(&ctx->mutex, NULL);
+    pthread_cond_init(&ctx->work, NULL);
+    pthread_cond_init(&ctx->done, NULL);
+
+    ctx->threads = calloc(n_threads, sizeof(pthread_t));
+    ctx->readers = calloc(n_threads, sizeof(faidx_reader_t *));
+    if (!ctx->threads || !ctx->readers) {
+        faidx_async_destroy(ctx);
+        return NULL;
+    }
+
+    // Each worker keeps its own reader; all share the index's descriptor
+    for (int t = 0; t < n_threads; t++) {
+        async_worker_t *w = malloc(sizeof(async_worker_t));
+        ctx->readers[t] = faidx_reader_create(meta);
+        if (!w || !ctx->readers[t]) {
+            free(w);
+            faidx_reader_destroy(ctx->readers[t]);
+            ctx->readers[t] = NULL;
+            faidx_async_destroy(ctx);
+            return NULL;
+        }
+        w->ctx = ctx;
+        w->reader = ctx->readers[t];
+        if (pthread_create(&ctx->threads[t], NULL, async_worker_main, w) != 0) {
+            free(w);
+            faidx_reader_destroy(ctx->readers[t]);
+            ctx->readers[t] = NULL;
+            faidx_async_destroy(ctx);
+            return NULL;
+        }
+        ctx->n_threads++;
+    }
+    return ctx;
+}
+
+int faidx_async_submit(faidx_async_t *ctx, const char *c_name,
+                       hts_pos_t p_beg_i, hts_pos_t p_end_i, uint64_t tag) {
+    if (!ctx || !c_name) return -1;
+
+    // Unknown sequences and empty regions complete at once, without I/O
+    async_job_t job = { hash_get(ctx->meta->hash, c_name), p_beg_i, p_end_i, tag, NULL, -1 };
+    int immediate = 1;
+    if (job.entry && (job.entry->line_blen == 0 || !clip_region(job.entry, &job.beg, &job.end))) {
+        job.seq = calloc(1, 1);
+        if (!job.seq) return -1;
+        job.len = 0;
+    } else if (job.entry) {
+        immediate = 0;
+    }
+
+    // Reserve room for every outstanding completion so workers never allocate
+    pthread_mutex_lock(&ctx->mutex);
+    if (async_queue_reserve(&ctx->completions, ctx->pending + 1) < 0 ||
+        (!immediate && async_queue_reserve(&ctx->requests, ctx->requests.n + 1) < 0)) {
+        pthread_mutex_unlock(&ctx->mutex);
+        free(job.seq);
+        return -1;
+    }
+    ctx->pending++;
+    if (immediate) {
+        async_queue_push(&ctx->completions, &job);
+        pthread_cond_broadcast(&ctx->done);
+    } else {
+        async_queue_push(&ctx->requests, &job);
+        pthread_cond_signal(&ctx->work);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (immediate && ctx->notify) ctx->notify(ctx->notify_data);
+    return 0;
+}
+
+// Move up to max completions out; called with the mutex held
+static size_t async_collect(faidx_async_t *ctx, faidx_completion_t *out, size_t max) {
+    size_t k = 0;
+    while (k < max && ctx->completions.n) {
+        async_job_t job = async_queue_pop(&ctx->completions);
+        out[k].tag = job.tag;
+        out[k].seq = job.seq;
+        out[k].len = job.len;
+        k++;
+    }
+    ctx->pending -= k;
+    return k;
+}
+
+size_t faidx_async_poll(faidx_async_t *ctx, faidx_completion_t *out, size_t max) {
+    if (!ctx || !out) return 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    size_t k = async_collect(ctx, out, max);
+    pthread_mutex_unlock(&ctx->mutex);
+    return k;
+}
+
+size_t faidx_async_wait(faidx_async_t *ctx, faidx_completion_t *out, size_t max) {
+    if (!ctx || !out || max == 0) return 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    while (!ctx->completions.n && ctx->pending) pthread_cond_wait(&ctx->done, &ctx->mutex);
+    size_t k = async_collect(ctx, out, max);
+    pthread_mutex_unlock(&ctx->mutex);
+    return k;
+}
+
+size_t faidx_async_pending(faidx_async_t *ctx) {
+    if (!ctx) return 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    size_t n = ctx->pending;
+    pthread_mutex_unlock(&ctx->mutex);
+    return n;
+}
+
+void faidx_async_destroy(faidx_async_t *ctx) {
+    if (!ctx) return;
+
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->shutdown = 1;
+    pthread_cond_broadcast(&ctx->work);
+    pthread_mutex_unlock(&ctx->mutex);
+
+    // Workers finish the fetch in hand; queued requests are dropped
+    for (int t = 0; t < ctx->n_threads; t++) pthread_join(ctx->threads[t], NULL);
+    for (int t = 0; t < ctx->n_threads; t++) faidx_reader_destroy(ctx->readers[t]);
+    while (ctx->completions.n) free(async_queue_pop(&ctx->completions).seq);
+
+    free(ctx->requests.jobs);
+    free(ctx->completions.jobs);
+    free(ctx->threads);
+    free(ctx->readers);
+    pthread_cond_destroy(&ctx->work);
+    pthread_cond_destroy(&ctx->done);
+    pthread_mutex_destroy(&ctx->mutex);
+    faidx_meta_destroy(ctx->meta);
+    free(ctx);
+}
+
+// Streaming sequential reader
+typedef struct {
+    char *buf;
+    uint64_t ticket;             // Chunk number the slot holds
+    int seq_id;
+    hts_pos_t pos, len;          // len < 0: read error
+    int ready;
+} stream_slot_t;
+
+struct faidx_stream_t {
+    faidx_meta_t *meta;
+    size_t chunk_size;
+    pthread_mutex_t mutex;
+    pthread_cond_t filled;       // A slot became ready
+    pthread_cond_t freed;        // The consumer released a slot
+    stream_slot_t *slots;
+    int n_slots;
+    int next_seq;                // Next chunk to hand to a worker
+    hts_pos_t next_pos;
+    uint64_t next_ticket;
+    uint64_t returned;           // Chunks handed to the consumer
+    uint64_t released;           // Chunks the consumer is done with
+    int done_assigning;
+    int shutdown;
+    int n_threads;
+    pthread_t *threads;
+    faidx_reader_t **readers;    // One per worker, or one for inline reads
+};
+
+typedef struct {
+    faidx_stream_t *s;
+    faidx_reader_t *reader;
+} stream_worker_t;
+
+// Claim the next chunk of the walk; called with the mutex held
+static int stream_claim(faidx_stream_t *s, uint64_t *ticket, int *seq_id, hts_pos_t *pos,
+                        hts_pos_t *len) {
+    const simple_hash_t *h = s->meta->hash;
+    if (s->next_seq >= h->n_entries) {
+        s->done_assigning = 1;
+        return 0;
+    }
+
+    const faidx1_t *e = &h->entries[s->next_seq];
+    hts_pos_t seq_len = e->line_blen ? (hts_pos_t)e->len : 0;
+    hts_pos_t n = seq_len - s->next_pos;
+    if (n > (hts_pos_t)s->chunk_size) n = s->chunk_size;
+
+    *ticket = s->next_ticket++;
+    *seq_id = s->next_seq;
+    *pos = s->next_pos;
+    *len = n;
+
+    // Empty records still yield one (empty) chunk
+    s->next_pos += n;
+    if (s->next_pos >= seq_len) {
+        s->next_seq++;
+        s->next_pos = 0;
+    }
+    return 1;
+}
+
+static void stream_fill(faidx_stream_t *s, faidx_reader_t *reader, stream_slot_t *slot) {
+    const faidx1_t *e = &s->meta->hash->entries[slot->seq_id];
+    if (slot->len > 0) {
+        reader_begin(reader, 1);
+        hts_pos_t got = fetch_region(reader, e, e->seq_offset, slot->pos,
+                                     slot->pos + slot->len, slot->buf, 0);
+        if (got != slot->len) slot->len = -1;
+    }
+}
+
+static void *stream_worker_main(void *arg) {
+    stream_worker_t *w = arg;
+    faidx_stream_t *s = w->s;
+
+    pthread_mutex_lock(&s->mutex);
+    for (;;) {
+        // Stay at most n_slots chunks ahead of the consumer
+        while (!s->shutdown && !s->done_assigning &&
+               s->next_ticket >= s->released + s->n_slots) {
+            pthread_cond_wait(&s->freed, &s->mutex);
+        }
+        uint64_t ticket;
+        int seq_id;
+        hts_pos_t pos, len;
+        if (s->shutdown || !stream_claim(s, &ticket, &seq_id, &pos, &len)) break;
+
+        stream_slot_t *slot = &s->slots[ticket % s->n_slots];
+        slot->ticket = ticket;
+        slot->seq_id = seq_id;
+        slot->pos = pos;
+        slot->len = len;
+        pthread_mutex_unlock(&s->mutex);
+
+        stream_fill(s, w->reader, slot);
+
+        pthread_mutex_lock(&s->mutex);
+        slot->ready = 1;
+        pthread_cond_broadcast(&s->filled);
+    }
+    pthread_cond_broadcast(&s->filled);
+    pthread_mutex_unlock(&s->mutex);
+    free(w);
+    return NULL;
+}
+
+faidx_stream_t *faidx_stream_create(faidx_meta_t *meta, size_t chunk_size, int n_threads) {
+    if (!meta || chunk_size == 0) return NULL;
+    if (n_threads < 0) n_threads = 0;
+
+    faidx_stream_t *s = calloc(1, sizeof(faidx_stream_t));
+    if (!s) return NULL;
+    s->meta = faidx_meta_ref(meta);
+    s->chunk_size = chunk_size;
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->filled, NULL);
+    pthread_cond_init(&s->freed, NULL);
+
+    // Workers keep up to two chunks each in flight; inline reads need one
+    s->n_slots = n_threads ? 2 * n_threads : 1;
+    s->slots = calloc(s->n_slots, sizeof(stream_slot_t));
+    s->threads = calloc(n_threads ? n_threads : 1, sizeof(pthread_t));
+    s->readers = calloc(n_threads ? n_threads : 1, sizeof(faidx_reader_t *));
+    if (!s->slots || !s->threads || !s->readers) goto fail;
+    for (int i = 0; i < s->n_slots; i++) {
+        s->slots[i].buf = malloc(chunk_size);
+        if (!s->slots[i].buf) goto fail;
+    }
+
+    if (n_threads == 0) {
+        s->readers[0] = faidx_reader_create(meta);
+        if (!s->readers[0]) goto fail;
+        return s;
+    }
+
+    for (int t = 0; t < n_threads; t++) {
+        stream_worker_t *w = malloc(sizeof(stream_worker_t));
+        s->readers[t] = faidx_reader_create(meta);
+        if (!w || !s->readers[t]) {
+            free(w);
+            goto fail;
+        }
+        w->s = s;
+        w->reader = s->readers[t];
+        if (pthread_create(&s->threads[t], NULL, stream_worker_main, w) != 0) {
+            free(w);
+            goto fail;
+        }
+        s->n_threads++;
+    }
+    return s;
+
+fail:
+    faidx_stream_destroy(s);
+    return NULL;
+}
+
+int faidx_stream_next(faidx_stream_t *s, faidx_stream_chunk_t *chunk) {
+    if (!s || !chunk) return -1;
+
+    stream_slot_t *slot = &s->slots[s->returned % s->n_slots];
+    pthread_mutex_lock(&s->mutex);
+
+    // The previously returned chunk is released now
+    if (s->returned > 0) {
+        s->slots[(s->returned - 1) % s->n_slots].ready = 0;
+        s->released = s->returned;
+        pthread_cond_broadcast(&s->freed);
+    }
+
+    if (s->n_threads == 0) {
+        // Inline: read the next chunk on the caller's thread
+        uint64_t ticket;
+        if (!stream_claim(s, &ticket, &slot->seq_id, &slot->pos, &slot->len)) {
+            pthread_mutex_unlock(&s->mutex);
+            return 0;
+        }
+        slot->ticket = ticket;
+        stream_fill(s, s->readers[0], slot);
+        slot->ready = 1;
+    } else {
+        while (!(slot->ready && slot->ticket == s->returned) &&
+               !(s->done_assigning && s->next_ticket <= s->returned)) {
+            pthread_cond_wait(&s->filled, &s->mutex);
+        }
+        if (!slot->ready || slot->ticket != s->returned) {
+            pthread_mutex_unlock(&s->mutex);
+            return 0;
+        }
+    }
+    s->returned++;
+    pthread_mutex_unlock(&s->mutex);
+
+    if (slot->len < 0) return -1;
+
+    const faidx1_t *e = &s->meta->hash->entries[slot->seq_id];
+    chunk->seq_id = slot->seq_id;
+    chunk->name = hash_key(s->meta->hash, slot->seq_id);
+    chunk->pos = slot->pos;
+    chunk->len = slot->len;
+    chunk->seq_len = e->line_blen ? (hts_pos_t)e->len : 0;
+    chunk->bases = slot->buf;
+    return 1;
+}
+
+void faidx_stream_destroy(faidx_stream_t *s) {
+    if (!s) return;
+
+    pthread_mutex_lock(&s->mutex);
+    s->shutdown = 1;
+    pthread_cond_broadcast(&s->freed);
+    pthread_mutex_unlock(&s->mutex);
+
+    for (int t = 0; t < s->n_threads; t++) pthread_join(s->threads[t], NULL);
+    if (s->readers) {
+        for (int t = 0; t < (s->n_threads ? s->n_threads : 1); t++) {
+            faidx_reader_destroy(s->readers[t]);
+        }
+    }
+    if (s->slots) {
+        for (int i = 0; i < s->n_slots; i++) free(s->slots[i].buf);
+    }
+    free(s->slots);
+    free(s->threads);
+    free(s->readers);
+    pthread_cond_destroy(&s->filled);
+    pthread_cond_destroy(&s->freed);
+    pthread_mutex_destroy(&s->mutex);
+    faidx_meta_destroy(s->meta);
+    free(s);
+}
+
+// BGZF support functions
+gzi_index_t *load_gzi_index(const char *gzi_path) {
+    if (!gzi_path) return NULL;
+    
+    FILE *fp = fopen(gzi_path, "rb");
+    if (!fp) return NULL;
+    return load_gzi_stream(fp);
+}
+
+void destroy_gzi_index(gzi_index_t *index) {
+    if (index) {
+        if (index->entries) {
+            free(index->entries);
+        }
+        free(index);
+    }
+}
+
+uint64_t find_bgzf_block(gzi_index_t *index, uint64_t uncompressed_offset) {
+    if (!index || index->n_entries == 0) return 0;
+    return index->entries[gzi_find_block(index, uncompressed_offset)].compressed_offset;
+}
+
+int bgzf_read_block(int fd, uint64_t coffset, char *buffer, int buffer_size) {
+    if (fd < 0 || !buffer) return -1;
+    
+    uint8_t *block = malloc(BGZF_MAX_BLOCK_SIZE);
+    if (!block) return -1;
+    
+    fai_inflater_t inflater;
+    if (fai_inflater_init(&inflater) < 0) {
+        free(block);
+        return -1;
+    }
+    
+    int ret = -1;
+    ssize_t got = pread(fd, block, BGZF_MAX_BLOCK_SIZE, coffset);
+    if (got > 0) {
+        int bsize = bgzf_block_size(block, got);
+        if (bsize > 0 && bsize <= got) {
+            ret = bgzf_inflate_block(&inflater, block, bsize, buffer, buffer_size);
+        }
+    }
+    
+    fai_inflater_end(&inflater);
+    free(block);
+    return ret;
+}
+
+int faidx_meta_nseq(const faidx_meta_t *meta) {
+    return meta ? meta->n : 0;
+}
+
+const char *faidx_meta_iseq(const faidx_meta_t *meta, int i) {
+    return (meta && i >= 0 && i < meta->n) ? hash_key(meta->hash, i) : NULL;
+}
+
+hts_pos_t faidx_meta_seq_len(const faidx_meta_t *meta, const char *seq) {
+    if (!meta || !seq) return -1;
+    
+    faidx1_t *entry = hash_get(meta->hash, seq);
+    return entry ? entry->len : -1;
+}
+
+int faidx_meta_has_seq(const faidx_meta_t *meta, const char *seq) {
+    if (!meta || !seq) return 0;
+    
+    faidx1_t *entry = hash_get(meta->hash, seq);
+    return entry != NULL;
+}
+
+int faidx_meta_is_mmap(const faidx_meta_t *meta) {
+    return meta && meta->map != NULL;
+}
+
+int faidx_meta_is_bin(const faidx_meta_t *meta) {
+    return meta && meta->bin_map != NULL;
+}
+
+int faidx_meta_is_packed(const faidx_meta_t *meta) {
+    return meta && meta->pack != NULL;
+}
+
+const uint64_t *faidx_meta_packed_seq(const faidx_meta_t *meta, const char *seq, hts_pos_t *len) {
+    if (!meta || !meta->pack || !seq) return NULL;
+
+    faidx1_t *entry = hash_get(meta->hash, seq);
+    if (!entry) return NULL;
+    if (len) *len = entry->len;
+    return meta->pack->words + meta->pack->seqs[entry->id].word_off;
+}
+
+int faidx_meta_set_cache_size(faidx_meta_t *meta, size_t bytes) {
+    if (!meta) return -1;
+    if (meta->cache) bgzf_cache_set_capacity(meta->cache, bytes);
+    for (int i = 0; i < meta->n_replicas; i++) {
+        if (!meta->replicas[i].local && meta->replicas[i].cache) {
+            bgzf_cache_set_capacity(meta->replicas[i].cache, bytes);
+        }
+    }
+    return 0;
+}
+
+int faidx_reader_set_cache_size(faidx_reader_t *reader, size_t bytes) {
+    if (!reader) return -1;
+    if (!reader->meta->is_bgzf) return 0;
+    
+    if (bytes == 0) {
+        bgzf_cache_destroy(reader->cache);
+        reader->cache = NULL;
+        return 0;
+    }
+    if (!reader->cache) {
+        reader->cache = bgzf_cache_init(1);
+        if (!reader->cache) return -1;
+    }
+    bgzf_cache_set_capacity(reader->cache, bytes);
+    return 0;
+}
+
+// Node caches add up, budgets included
+void faidx_meta_cache_stats(const faidx_meta_t *meta, faidx_cache_stats_t *stats) {
+    if (!stats) return;
+    bgzf_cache_stats(meta ? meta->cache : NULL, stats);
+    for (int i = 0; meta && i < meta->n_replicas; i++) {
+        if (meta->replicas[i].local || !meta->replicas[i].cache) continue;
+        faidx_cache_stats_t node;
+        bgzf_cache_stats(meta->replicas[i].cache, &node);
+        stats->hits += node.hits;
+        stats->misses += node.misses;
+        stats->evictions += node.evictions;
+        stats->bytes += node.bytes;
+        stats->capacity += node.capacity;
+    }
+}
+
+void faidx_reader_cache_stats(const faidx_reader_t *reader, faidx_cache_stats_t *stats) {
+    if (!stats) return;
+    if (!reader) {
+        bgzf_cache_stats(NULL, stats);
+        return;
+    }
+    bgzf_cache_stats(reader->cache ? reader->cache : reader->node_cache, stats);
+}
+
+int faidx_reader_set_readahead(faidx_reader_t *reader, int n_blocks) {
+    if (!reader) return -1;
+
+    // The ring is sized on creation, so a new window starts a new thread
+    readahead_destroy(reader->ra);
+    reader->ra = NULL;
+    reader->ra_mode = n_blocks < 0 ? -1 : n_blocks;
+    reader->ra_streak = 0;
+    reader->ra_advised = 0;
+    return 0;
+}
+
+// Descriptors of collection files, opened on first read and closed least
+// recently used first to stay within max_open. The pool outlives the
+// collection for as long as any of its metas does.
+typedef struct fai_fd_pool_t fai_fd_pool_t;
+
+typedef struct fai_pool_file_t {
+    faidx_io_t io;
+    fai_fd_pool_t *pool;
+    char *path;
+    int64_t size;
+    int fd;                      // -1 while closed
+    int busy;                    // Reads in progress; never closed while set
+    struct fai_pool_file_t *prev, *next;  // Open files, most recent first
+} fai_pool_file_t;
+
+struct fai_fd_pool_t {
+    pthread_mutex_t mutex;
+    fai_pool_file_t *head, *tail;
+    int n_open, max_open;
+    int refs;                    // The collection plus one per file
+};
+
+static void pool_unlink(fai_fd_pool_t *pool, fai_pool_file_t *f) {
+    if (f->prev) f->prev->next = f->next;
+    else pool->head = f->next;
+    if (f->next) f->next->prev = f->prev;
+    else pool->tail = f->prev;
+    f->prev = f->next = NULL;
+}
+
+static void pool_push(fai_fd_pool_t *pool, fai_pool_file_t *f) {
+    f->next = pool->head;
+    if (pool->head) pool->head->prev = f;
+    else pool->tail = f;
+    pool->head = f;
+}
+
+// Close idle descriptors from the cold end until a new one fits. Files in
+// use are skipped, so a burst of concurrent reads can exceed the cap.
+static void pool_trim(fai_fd_pool_t *pool, int max_open) {
+    fai_pool_file_t *f = pool->tail;
+    while (f && pool->n_open > max_open) {
+        fai_pool_file_t *prev = f->prev;
+        if (!f->busy) {
+            pool_unlink(pool, f);
+            close(f->fd);
+            f->fd = -1;
+            pool->n_open--;
+        }
+        f = prev;
+    }
+}
+
+static void pool_release(fai_fd_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    int last = --pool->refs == 0;
+    pthread_mutex_unlock(&pool->mutex);
+    if (!last) return;
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+static int64_t pool_file_read(faidx_io_t *io, void *buf, size_t len, uint64_t offset) {
+    fai_pool_file_t *f = (fai_pool_file_t *)io;
+    fai_fd_pool_t *pool = f->pool;
+    
+    pthread_mutex_lock(&pool->mutex);
+    if (f->fd < 0) {
+        pool_trim(pool, pool->max_open - 1);
+        f->fd = open(f->path, O_RDONLY);
+        if (f->fd < 0) {
+            pthread_mutex_unlock(&pool->mutex);
+            return -1;
+        }
+        pool->n_open++;
+    } else {
+        pool_unlink(pool, f);
+    }
+    pool_push(pool, f);
+    f->busy++;
+    int fd = f->fd;
+    pthread_mutex_unlock(&pool->mutex);
+    
+    size_t done = 0;
+    int64_t ret = 0;
+    while (done < len) {
+        ssize_t got = pread(fd, (char *)buf + done, len - done, offset + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) ret = -1;
+        if (got <= 0) break;
+        done += got;
+    }
+    
+    pthread_mutex_lock(&pool->mutex);
+    f->busy--;
+    pthread_mutex_unlock(&pool->mutex);
+    return ret < 0 ? -1 : (int64_t)done;
+}
+
+static int64_t pool_file_size(faidx_io_t *io) {
+    return ((fai_pool_file_t *)io)->size;
+}
+
+static void pool_file_close(faidx_io_t *io) {
+    fai_pool_file_t *f = (fai_pool_file_t *)io;
+    fai_fd_pool_t *pool = f->pool;
+    
+    pthread_mutex_lock(&pool->mutex);
+    if (f->fd >= 0) {
+        pool_unlink(pool, f);
+        close(f->fd);
+        pool->n_open--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    pool_release(pool);
+    free(f->path);
+    free(f);
+}
+
+// Move a loaded meta's descriptor into the pool. Metas without one (memory
+// maps, plain gzip, remote files) are left as they are.
+static int pool_adopt(fai_fd_pool_t *pool, faidx_meta_t *meta) {
+    if (meta->fd < 0 || meta->io) return 0;
+    
+    struct stat st;
+    fai_pool_file_t *f = calloc(1, sizeof(fai_pool_file_t));
+    if (!f || fstat(meta->fd, &st) != 0 || !(f->path = str_dup(meta->fasta_path))) {
+        free(f);
+        return -1;
+    }
+    f->io.read = pool_file_read;
+    f->io.size = pool_file_size;
+    f->io.close = pool_file_close;
+    f->pool = pool;
+    f->size = st.st_size;
+    f->fd = -1;
+    
+    pthread_mutex_lock(&pool->mutex);
+    pool->refs++;
+    pthread_mutex_unlock(&pool->mutex);
+    close(meta->fd);
+    meta->fd = -1;
+    meta->io = &f->io;
+    return 0;
+}
+
+// Where a collection sequence lives: the file and its entry index there
+typedef struct {
+    uint32_t file;
+    uint32_t entry;
+} coll_seq_t;
+
+struct faidx_coll_t {
+    faidx_meta_t **metas;
+    int n_files;
+    coll_seq_t *seqs;            // Every file's sequences, in file order
+    int n_seqs;
+    hash_slot_t *slots;          // Open-addressing table over seqs
+    uint32_t n_slots;
+    fai_fd_pool_t *pool;
+    int ref_count;
+};
+
+struct faidx_coll_reader_t {
+    faidx_coll_t *coll;
+    faidx_reader_t **readers;    // Per file, created on first use
+    uint64_t *used;              // Tick of each reader's last fetch
+    uint64_t tick;
+    int n_live;
+};
+
+static inline const char *coll_name(const faidx_coll_t *coll, int i) {
+    const coll_seq_t *s = &coll->seqs[i];
+    return hash_key(coll->metas[s->file]->hash, s->entry);
+}
+
+// Build the merged name table, the same way hash_build does for one file
+static int coll_build(faidx_coll_t *coll) {
+    for (int i = 0; i < coll->n_files; i++) coll->n_seqs += coll->metas[i]->hash->n_entries;
+    coll->seqs = malloc((coll->n_seqs ? coll->n_seqs : 1) * sizeof(coll_seq_t));
+    if (!coll->seqs) return -1;
+    
+    int n = 0;
+    for (int i = 0; i < coll->n_files; i++) {
+        for (int e = 0; e < coll->metas[i]->hash->n_entries; e++) {
+            coll->seqs[n].file = i;
+            coll->seqs[n++].entry = e;
+        }
+    }
+    
+    uint32_t n_slots = 16;
+    while (n_slots < (uint64_t)coll->n_seqs * 2) n_slots <<= 1;
+    coll->slots = calloc(n_slots, sizeof(hash_slot_t));
+    if (!coll->slots) return -1;
+    coll->n_slots = n_slots;
+    
+    uint32_t mask = n_slots - 1;
+    for (int i = 0; i < coll->n_seqs; i++) {
+        const char *key = coll_name(coll, i);
+        uint32_t hv = hash_name(key);
+        uint32_t k = hv & mask;
+        while (coll->slots[k].idx) {
+            if (coll->slots[k].hash == hv && strcmp(coll_name(coll, coll->slots[k].idx - 1), key) == 0) break;
+            k = (k + 1) & mask;
+        }
+        if (!coll->slots[k].idx) {
+            coll->slots[k].hash = hv;
+            coll->slots[k].idx = i + 1;
+        }
+    }
+    return 0;
+}
+
+static const coll_seq_t *coll_find(const faidx_coll_t *coll, const char *name) {
+    if (!coll || !name || !coll->slots) return NULL;
+    
+    uint32_t hv = hash_name(name);
+    uint32_t mask = coll->n_slots - 1;
+    for (uint32_t k = hv & mask; coll->slots[k].idx; k = (k + 1) & mask) {
+        const hash_slot_t *slot = &coll->slots[k];
+        if (slot->hash == hv && strcmp(coll_name(coll, slot->idx - 1), name) == 0) {
+            return &coll->seqs[slot->idx - 1];
+        }
+    }
+    return NULL;
+}
+
+faidx_coll_t *faidx_coll_load(const char *const *paths, int n, fai_format_options format, int flags) {
+    if (!paths || n <= 0) return NULL;
+    
+    faidx_coll_t *coll = calloc(1, sizeof(faidx_coll_t));
+    if (!coll) return NULL;
+    coll->ref_count = 1;
+    coll->metas = calloc(n, sizeof(faidx_meta_t *));
+    coll->pool = calloc(1, sizeof(fai_fd_pool_t));
+    if (!coll->metas || !coll->pool) {
+        free(coll->metas);
+        free(coll->pool);
+        free(coll);
+        return NULL;
+    }
+    pthread_mutex_init(&coll->pool->mutex, NULL);
+    coll->pool->max_open = FAI_COLL_MAX_OPEN;
+    coll->pool->refs = 1;
+    
+    for (int i = 0; i < n; i++) {
+        faidx_meta_t *meta = faidx_meta_load(paths[i], format, flags);
+        if (!meta) {
+            faidx_coll_destroy(coll);
+            return NULL;
+        }
+        coll->metas[coll->n_files++] = meta;
+        if (pool_adopt(coll->pool, meta) < 0) {
+            faidx_coll_destroy(coll);
+            return NULL;
+        }
+    }
+    
+    if (coll_build(coll) < 0) {
+        faidx_coll_destroy(coll);
+        return NULL;
+    }
+    return coll;
+}
+
+faidx_coll_t *faidx_coll_ref(faidx_coll_t *coll) {
+    if (!coll) return NULL;
+    
+    __atomic_add_fetch(&coll->ref_count, 1, __ATOMIC_RELAXED);
+    return coll;
+}
+
+void faidx_coll_destroy(faidx_coll_t *coll) {
+    if (!coll) return;
+    if (__atomic_sub_fetch(&coll->ref_count, 1, __ATOMIC_ACQ_REL) > 0) return;
+    
+    for (int i = 0; i < coll->n_files; i++) faidx_meta_destroy(coll->metas[i]);
+    pool_release(coll->pool);
+    free(coll->metas);
+    free(coll->seqs);
+    free(coll->slots);
+    free(coll);
+}
+
+int faidx_coll_set_max_open(faidx_coll_t *coll, int max_open) {
+    if (!coll || max_open < 1) return -1;
+    
+    pthread_mutex_lock(&coll->pool->mutex);
+    coll->pool->max_open = max_open;
+    pool_trim(coll->pool, max_open);
+    pthread_mutex_unlock(&coll->pool->mutex);
+    return 0;
+}
+
+int faidx_coll_open_files(const faidx_coll_t *coll) {
+    if (!coll) return 0;
+    
+    pthread_mutex_lock(&coll->pool->mutex);
+    int n = coll->pool->n_open;
+    pthread_mutex_unlock(&coll->pool->mutex);
+    return n;
+}
+
+int faidx_coll_nfiles(const faidx_coll_t *coll) {
+    return coll ? coll->n_files : 0;
+}
+
+faidx_meta_t *faidx_coll_meta(const faidx_coll_t *coll, int file) {
+    if (!coll || file < 0 || file >= coll->n_files) return NULL;
+    return coll->metas[file];
+}
+
+int faidx_coll_nseq(const faidx_coll_t *coll) {
+    return coll ? coll->n_seqs : 0;
+}
+
+const char *faidx_coll_iseq(const faidx_coll_t *coll, int i) {
+    if (!coll || i < 0 || i >= coll->n_seqs) return NULL;
+    return coll_name(coll, i);
+}
+
+int faidx_coll_file_of(const faidx_coll_t *coll, const char *name) {
+    const coll_seq_t *s = coll_find(coll, name);
+    return s ? (int)s->file : -1;
+}
+
+hts_pos_t faidx_coll_seq_len(const faidx_coll_t *coll, const char *name) {
+    const coll_seq_t *s = coll_find(coll, name);
+    return s ? (hts_pos_t)coll->metas[s->file]->hash->entries[s->entry].len : -1;
+}
+
+hts_pos_t faidx_coll_fetch_seq_into_flags(faidx_coll_t *coll, const char *c_name,
+                                          hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                          char *buf, size_t buf_size, int flags) {
+    const coll_seq_t *s = coll_find(coll, c_name);
+    if (!s) return -1;
+    return faidx_meta_fetch_seq_into_flags(coll->metas[s->file], c_name, p_beg_i, p_end_i,
+                                           buf, buf_size, flags);
+}
+
+faidx_coll_reader_t *faidx_coll_reader_create(faidx_coll_t *coll) {
+    if (!coll) return NULL;
+    
+    faidx_coll_reader_t *r = calloc(1, sizeof(faidx_coll_reader_t));
+    if (!r) return NULL;
+    r->readers = calloc(coll->n_files, sizeof(faidx_reader_t *));
+    r->used = calloc(coll->n_files, sizeof(uint64_t));
+    if (!r->readers || !r->used) {
+        free(r->readers);
+        free(r->used);
+        free(r);
+        return NULL;
+    }
+    r->coll = faidx_coll_ref(coll);
+    return r;
+}
+
+void faidx_coll_reader_destroy(faidx_coll_reader_t *r) {
+    if (!r) return;
+    
+    for (int i = 0; i < r->coll->n_files; i++) faidx_reader_destroy(r->readers[i]);
+    faidx_coll_destroy(r->coll);
+    free(r->readers);
+    free(r->used);
+    free(r);
+}
+
+// The reader for a file, created on first use. Past FAI_COLL_READERS live
+// readers the least recently used one is dropped, along with its buffers.
+static faidx_reader_t *coll_reader_get(faidx_coll_reader_t *r, int file) {
+    r->used[file] = ++r->tick;
+    if (r->readers[file]) return r->readers[file];
+    
+    if (r->n_live >= FAI_COLL_READERS) {
+        int lru = -1;
+        for (int i = 0; i < r->coll->n_files; i++) {
+            if (r->readers[i] && (lru < 0 || r->used[i] < r->used[lru])) lru = i;
+        }
+        faidx_reader_destroy(r->readers[lru]);
+        r->readers[lru] = NULL;
+        r->n_live--;
+    }
+    
+    r->readers[file] = faidx_reader_create(r->coll->metas[file]);
+    if (r->readers[file]) r->n_live++;
+    return r->readers[file];
+}
+
+faidx_reader_t *faidx_coll_reader_get(faidx_coll_reader_t *r, const char *c_name) {
+    if (!r) return NULL;
+    const coll_seq_t *s = coll_find(r->coll, c_name);
+    return s ? coll_reader_get(r, s->file) : NULL;
+}
+
+char *faidx_coll_reader_fetch_seq(faidx_coll_reader_t *r, const char *c_name,
+                                  hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
+    faidx_reader_t *reader = faidx_coll_reader_get(r, c_name);
+    return reader ? faidx_reader_fetch_seq(reader, c_name, p_beg_i, p_end_i, len) : NULL;
+}
+
+char *faidx_coll_reader_fetch_qual(faidx_coll_reader_t *r, const char *c_name,
+                                   hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len) {
+    faidx_reader_t *reader = faidx_coll_reader_get(r, c_name);
+    return reader ? faidx_reader_fetch_qual(reader, c_name, p_beg_i, p_end_i, len) : NULL;
+}
+
+hts_pos_t faidx_coll_reader_fetch_seq_into_flags(faidx_coll_reader_t *r, const char *c_name,
+                                                 hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                                 char *buf, size_t buf_size, int flags) {
+    faidx_reader_t *reader = faidx_coll_reader_get(r, c_name);
+    return reader ? faidx_reader_fetch_seq_into_flags(reader, c_name, p_beg_i, p_end_i,
+                                                      buf, buf_size, flags) : -1;
 }
 
 faidx1_t *faidx_meta_get_entry(faidx_meta_t *meta, const char *seq_name) {
@@ -9,6 +9,15 @@
 #include <inttypes.h>
 #include <zlib.h>
 
+// BGZF blocks are inflated with libdeflate when built with FAIGZ_LIBDEFLATE
+// (the `libdeflate` Cargo feature) and with zlib otherwise
+#ifdef FAIGZ_LIBDEFLATE
+#include <libdeflate.h>
+typedef struct libdeflate_decompressor *fai_inflater_t;
+#else
+typedef z_stream fai_inflater_t;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,46 +35,198 @@ typedef enum {
 
 // Flags for faidx_meta_load
 #define FAI_CREATE 0x01
+#define FAI_MMAP   0x02           // Map uncompressed files once, shared by all readers
+#define FAI_BIN    0x04           // Load from (or write) the filename.fai.bin sidecar
+#define FAI_PACK   0x08           // Decode every sequence once into a packed in-memory store
+#define FAI_LAZY   0x10           // FAI_BIN, and page the index in only as lookups touch it
+#define FAI_NUMA   0x20           // Copy the name index, GZI table and block cache to every NUMA node
+#define FAI_HUGE   0x40           // Back large tables and packed sequences with huge pages
+#define FAI_VERIFY 0x80           // Check every sequence's line layout at load (reads the whole file)
+
+// Byte source for a file served by something other than the local file
+// system (faidx_meta_load_io). Backends embed this as their first member.
+// read is called from every reader thread at once and returns the bytes
+// read, short only at the end of the file, or -1.
+typedef struct faidx_io_t faidx_io_t;
+struct faidx_io_t {
+    int64_t (*read)(faidx_io_t *io, void *buf, size_t len, uint64_t offset);
+    int64_t (*size)(faidx_io_t *io);
+    void (*close)(faidx_io_t *io);
+};
 
 // Position type
 typedef int64_t hts_pos_t;
 
+// BGZF block layout limits
+#define BGZF_MAX_BLOCK_SIZE 0x10000
+#define BGZF_BLOCK_HEADER_LEN 18
+#define BGZF_BLOCK_FOOTER_LEN 8
+
 // GZI index structures for BGZF random access
 typedef struct {
     uint64_t compressed_offset;
     uint64_t uncompressed_offset;
 } gzi_entry_t;
 
+// Block table; entries[0] is always the implicit first block at (0, 0)
 typedef struct {
     gzi_entry_t *entries;
     int n_entries;
 } gzi_index_t;
 
+// Decompressed BGZF block cache, keyed by compressed offset. Split into
+// independently locked shards, each with its own LRU list, so concurrent
+// readers only contend when they touch the same shard.
+typedef struct bgzf_cache_entry_t {
+    uint64_t coffset;
+    struct bgzf_cache_entry_t *hnext;         // Bucket chain
+    struct bgzf_cache_entry_t *prev, *next;   // LRU list, most recent first
+    int len;
+    char data[];
+} bgzf_cache_entry_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    bgzf_cache_entry_t **buckets;
+    uint32_t n_buckets, n_entries;
+    bgzf_cache_entry_t *head, *tail;
+    uint64_t bytes, capacity;     // Shard budget in bytes
+    uint64_t hits, misses, evictions;
+} bgzf_cache_shard_t;
+
+typedef struct {
+    bgzf_cache_shard_t *shards;
+    int n_shards;
+    uint64_t capacity;            // Total budget; 0 disables the cache
+} bgzf_cache_t;
+
+// Cache counters reported to callers
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t bytes;               // Decompressed bytes currently cached
+    uint64_t capacity;            // Configured budget
+} faidx_cache_stats_t;
+
+// Fetch instrumentation. Counters are exact; phase times are taken on one
+// fetch in FAI_STATS_SAMPLE per reader and kept in log-linear histograms
+// with FAI_HIST_SUB buckets per power of two of nanoseconds, so a bucket's
+// bounds are within 1/FAI_HIST_SUB of each other (faidx_hist_bucket_lower).
+// Times beyond half an hour share the last bucket.
+#define FAI_STATS_SAMPLE 64
+#define FAI_HIST_SUB 4
+#define FAI_HIST_BUCKETS 160
+
+enum {
+    FAI_PHASE_LOOKUP,             // Name lookup and region resolution
+    FAI_PHASE_READ,               // pread, mapping and cache copies
+    FAI_PHASE_INFLATE,            // BGZF block inflation
+    FAI_PHASE_DELINE,             // Newline stripping, transforms, unpacking
+    FAI_N_PHASES
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[FAI_HIST_BUCKETS];
+} faidx_hist_t;
+
+typedef struct {
+    uint64_t fetches;             // Regions fetched (size queries don't count)
+    uint64_t bases;               // Bases returned
+    uint64_t bytes_read;          // File bytes read, newlines included
+    uint64_t compressed_bytes;    // BGZF bytes read from disk
+    uint64_t blocks_inflated;
+    uint64_t bytes_inflated;      // Decompressed size of those blocks
+    uint64_t blocks_reused;       // Served by the last block or readahead
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t timed;               // Fetches whose phases were timed
+    faidx_hist_t phases[FAI_N_PHASES];
+} faidx_stats_t;
+
+// Line layout of an entry's sequence, from its .fai line lengths
+enum {
+    FAI_LAYOUT_LF,               // Lines of line_blen bases ending in "\n"
+    FAI_LAYOUT_CRLF,             // Lines of line_blen bases ending in "\r\n"
+    FAI_LAYOUT_SINGLE,           // The whole sequence on one line
+    FAI_LAYOUT_IRREGULAR         // Line lengths no layout fits
+};
+
 // Index entry structure
 typedef struct {
     int id;
     uint32_t line_len, line_blen;
+    uint16_t layout;             // FAI_LAYOUT_*
+    uint16_t kernel;             // De-lining kernel, picked at load by layout and width
     uint64_t len;
     uint64_t seq_offset;
-    uint64_t qual_offset;
+    uint64_t qual_offset;        // FASTQ quality start, 0 if there is none
 } faidx1_t;
 
-// Simple string hash table
+// Hash slot: cached name hash plus entry index + 1 (0 marks an empty slot)
 typedef struct {
-    char *key;
-    faidx1_t val;
-} hash_entry_t;
+    uint32_t hash;
+    uint32_t idx;
+} hash_slot_t;
 
+// Open-addressing name index. Names are stored back to back in one arena;
+// the slot table is built once after loading and is read-only afterwards,
+// so concurrent lookups need no locking.
 typedef struct {
-    hash_entry_t *entries;
-    int n_entries;
-    int capacity;
+    faidx1_t *entries;           // Index entries in .fai order
+    uint64_t *name_off;          // Offset of each entry's name in the arena
+    int n_entries, m_entries;    // Entry count and allocation size
+    char *arena;                 // NUL-terminated names
+    uint64_t arena_len, arena_cap;
+    hash_slot_t *slots;          // Open-addressing table (linear probing)
+    uint32_t n_slots;            // Power of two, at least 2 * n_entries
 } simple_hash_t;
 
+// Packed in-memory sequence store (FAI_PACK). Bases are 2-bit codes (A=0,
+// C=1, G=2, T=3), 32 per word with the first base in the low bits, and each
+// sequence starts on a fresh word. Other characters are packed as A and
+// restored from the exception runs; soft-masked bases are listed in the
+// mask runs. Runs of a sequence are sorted and never overlap.
+typedef struct {
+    uint64_t beg, end;           // Half-open base range
+    char base;                   // Exception runs: the uppercase character
+} fai_pack_run_t;
+
+typedef struct {
+    uint64_t word_off;           // First word of the sequence
+    uint64_t exc_beg, exc_end;   // Exception runs [exc_beg, exc_end)
+    uint64_t mask_beg, mask_end; // Mask runs [mask_beg, mask_end)
+} fai_pack_seq_t;
+
+typedef struct {
+    uint64_t *words;
+    uint64_t n_words;
+    fai_pack_run_t *exc, *mask;
+    uint64_t n_exc, m_exc, n_mask, m_mask;
+    fai_pack_seq_t *seqs;        // Indexed by faidx1_t.id
+} fai_pack_t;
+
+// Memory for the large long-lived tables of a meta: the name index, the GZI
+// block table and packed sequences, plus their per-node copies. alloc
+// returns size bytes, placed on NUMA node `node` when it is >= 0 and backed
+// by huge pages when `huge` is set, or NULL; free gets the same size back.
+// The tables are copied into it once loading is done, so it never sees a
+// realloc. Contents need not be zeroed.
+typedef struct {
+    void *(*alloc)(void *ctx, size_t size, int node, int huge);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+} faidx_allocator_t;
+
+struct fai_placed_t;
+struct fai_replica_t;
+
 // Shared metadata structure
 struct faidx_meta_t {
-    int n, m;                     // Sequence count and allocation size
-    char **name;                  // Array of sequence names
+    int n;                        // Sequence count
     simple_hash_t *hash;          // Hash table mapping names to positions
     fai_format_options format;    // FAI_FASTA or FAI_FASTQ
     
@@ -74,43 +235,459 @@ struct faidx_meta_t {
     char *fai_path;              // Path to the .fai index
     char *gzi_path;              // Path to the .gzi index (if using BGZF)
     
-    // Reference count and mutex for thread safety
+    // Reference count, updated atomically by faidx_meta_ref/destroy
     int ref_count;
-    pthread_mutex_t mutex;
     
     // Flag indicating if the source is BGZF compressed
     int is_bgzf;
     
+    // Plain (non-BGZF) gzip source: only sequential gzseek access is possible
+    int is_gzip;
+    
     // GZI index for BGZF random access
     gzi_index_t *gzi_index;
+    uint64_t bgzf_size;          // Compressed file size (end of the last block)
+    
+    // Block cache shared by every reader (BGZF only, disabled by default)
+    bgzf_cache_t *cache;
+    
+    // Read-only mapping of an uncompressed file (FAI_MMAP), NULL otherwise
+    const char *map;
+    uint64_t map_size;
+    
+    // Mapping of a .fai.bin sidecar (FAI_BIN), NULL otherwise. When set, the
+    // hash and GZI tables point into it instead of owning their memory.
+    const char *bin_map;
+    uint64_t bin_size;
+    
+    // Packed copy of every sequence (FAI_PACK), NULL otherwise
+    fai_pack_t *pack;
+    
+    // Descriptor shared by every reader for positioned reads (BGZF and
+    // unmapped uncompressed files), -1 otherwise
+    int fd;
+    
+    // Backend of a file loaded with faidx_meta_load_io (owned), NULL for
+    // local files; reads go through it instead of fd
+    faidx_io_t *io;
+    
+    // Fetch statistics: live readers are summed on demand; destroyed
+    // readers and stateless fetches add into retired atomically
+    pthread_mutex_t stats_mutex;  // Guards the reader list
+    faidx_reader_t *stats_readers;
+    faidx_stats_t retired;
+    
+    // Tables moved into allocator memory (FAI_HUGE, FAI_NUMA or a custom
+    // allocator), released through the allocator they came from
+    faidx_allocator_t allocator;
+    struct fai_placed_t *placed;
+    int n_placed, m_placed;
+    
+    // Per-node copies (FAI_NUMA on a multi-node machine), indexed by node;
+    // the loading node's entry points at the tables above
+    struct fai_replica_t *replicas;
+    int n_replicas;
+    
+    // Line layouts by entry id, NULL until the first fetch or check: the
+    // line table of an entry whose lines are not where its .fai puts them,
+    // a shared marker for one whose lines are, or another for one whose
+    // last base is where its .fai puts it but whose lines are unchecked.
+    // Entries are checked by faidx_meta_verify, or by the first fetch that
+    // finds a line end out of place; slots only ever move from unchecked to
+    // checked, under lines_mutex.
+    struct fai_lines_t **lines;
+    pthread_mutex_t lines_mutex;
 };
 
+// Per-reader scratch memory. Raw reads, compressed input and batch
+// bookkeeping are carved from it and all released when the next fetch
+// starts; chunks added when a fetch outgrows it are merged into one, so a
+// reader in steady state does not allocate.
+typedef struct fai_arena_chunk_t fai_arena_chunk_t;
+typedef struct {
+    fai_arena_chunk_t *first;    // Chunks in order, kept for reuse
+    fai_arena_chunk_t *cur;      // Chunk being carved, NULL if there are none
+    size_t used;                 // Bytes taken from cur
+    size_t live, peak;           // Bytes handed out, and the most at once
+} fai_arena_t;
+
 // Reader structure containing thread-specific data
 struct faidx_reader_t {
     faidx_meta_t *meta;          // Shared metadata (not owned)
-    FILE *fp;                    // File pointer for reading
-    gzFile gzfp;                 // gzFile pointer for compressed files
+    int fd;                      // meta->fd, borrowed for positioned reads
+    gzFile gzfp;                 // gzFile pointer for non-BGZF gzip files
+    
+    // BGZF block engine state
+    int inflater_init;           // Whether inflater has been initialised
+    fai_inflater_t inflater;     // Raw-deflate decompressor, reused for every block
+    char *ublock;                // Last block decompressed out of range
+    uint64_t ublock_coffset;     // Compressed offset of the block in ublock
+    int ublock_len;              // Decompressed length, -1 if ublock is empty
+    bgzf_cache_t *cache;         // Private block cache, overrides meta->cache
+    
+    // Name index, GZI table and shared cache of the node the reader was
+    // created on: meta's own, or a FAI_NUMA copy
+    simple_hash_t *hash;
+    const gzi_index_t *gzi;
+    bgzf_cache_t *node_cache;
+    
+    // Readahead for forward-sequential access (faidx_reader_set_readahead)
+    int ra_mode;                 // -1 automatic, 0 off, > 0 always, in blocks
+    int ra_streak;               // Consecutive reads that moved forward
+    uint64_t ra_ubeg, ra_uend;   // Span of the last raw read
+    uint64_t ra_advised;         // End of the last fadvise/madvise hint
+    struct fai_readahead_t *ra;  // Background inflater (BGZF), started lazily
+    
+    // Scratch for raw (newline-containing) reads and compressed blocks
+    fai_arena_t arena;
+    
+    // Fetch statistics, written only by the owning thread. Scratch readers
+    // point stats at meta->retired and update it atomically instead.
+    faidx_stats_t *stats;
+    int stats_shared;
+    faidx_reader_t *stats_prev, *stats_next;
+    int stats_timing;            // Whether the current fetch is timed
+    uint64_t stats_t;            // Time of the last phase boundary
+    uint64_t stats_acc[FAI_N_PHASES];
 };
 
 // Function declarations
 faidx_meta_t *faidx_meta_load(const char *filename, fai_format_options format, int flags);
+
+// Load a FASTA/FASTQ file, its .fai and (for BGZF) its .gzi from backends,
+// which meta takes over, even on failure. Plain gzip can't be read this way
+// and name is only used in messages. FAI_PACK is honoured; FAI_CREATE,
+// FAI_MMAP and FAI_BIN need a local file and are ignored.
+faidx_meta_t *faidx_meta_load_io(const char *name, faidx_io_t *data, faidx_io_t *fai,
+                                 faidx_io_t *gzi, fai_format_options format, int flags);
+
+// Remote files over HTTP(S) range requests, in builds with FAIGZ_CURL (the
+// "remote" feature); without it these fail with errno ENOSYS. s3://bucket/key
+// is read anonymously from bucket.s3.amazonaws.com, or from
+// $AWS_ENDPOINT_URL/bucket/key when that is set. Each read is one range
+// request. With a cache_dir, reads are rounded out to FAI_REMOTE_CHUNK
+// pieces kept in a sparse copy of the file there: only missing pieces are
+// fetched, each run of them with one request, and later loads reuse them
+// while the remote size and ETag stay the same. faidx_meta_load hands
+// http://, https:// and s3:// names to faidx_meta_load_url, with
+// $FAIGZ_CACHE_DIR as the cache.
+#define FAI_REMOTE_CHUNK (256 << 10)
+faidx_io_t *faidx_io_open_url(const char *url, const char *cache_dir);
+faidx_meta_t *faidx_meta_load_url(const char *url, const char *cache_dir,
+                                  fai_format_options format, int flags);
+
+// Allocator used by metas loaded from now on (NULL restores the default,
+// anonymous mmap with mbind and MADV_HUGEPAGE as asked). Setting one moves
+// the tables of every later load into it, with or without FAI_HUGE and
+// FAI_NUMA. Not to be called while metas are being loaded.
+void faidx_set_allocator(const faidx_allocator_t *allocator);
+
+// With FAI_NUMA on a machine with several nodes, each node gets its own
+// copy of the name index and GZI table in node-local memory, and its own
+// block cache of the size set with faidx_meta_set_cache_size. A reader
+// uses the copies of the node it was created on, so readers should be
+// created on the thread that uses them. Returns the number of nodes with
+// copies, 0 when the tables are not replicated.
+int faidx_meta_numa_nodes(const faidx_meta_t *meta);
+
+// Check every sequence's lines against its .fai line lengths (FAI_VERIFY
+// does this at load). Fetches then pick their copy path by the checked
+// layout, without checking line terminators: regular sequences are copied
+// line by line, and irregular ones are read through a table of their
+// lines. Without a check, the first fetch of a sequence looks for its last
+// base where the .fai puts it, every fetch checks the line ends in the
+// bytes it copies, and a sequence that fails either is checked then. Ragged
+// lines that add up to the .fai's layout can pass both in a fetch that
+// stays between them, so files that may have them should be checked.
+// Returns the number of irregular sequences, or -1 on a read error.
+int faidx_meta_verify(faidx_meta_t *meta);
 faidx_meta_t *faidx_meta_ref(faidx_meta_t *meta);
 void faidx_meta_destroy(faidx_meta_t *meta);
 faidx_reader_t *faidx_reader_create(faidx_meta_t *meta);
+
+// Build filename.fai, and filename.gzi for BGZF files that lack one. BGZF
+// and uncompressed files are decompressed and scanned in parallel chunks on
+// n_threads threads (0 uses every online CPU); plain gzip is scanned
+// serially. FASTQ indexes get the sixth (quality offset) column. Returns 0
+// on success, -1 on error.
+int faidx_build_index(const char *filename, fai_format_options format, int n_threads);
+
+// Options for faidx_compress; zeroed fields take the defaults
+typedef struct {
+    int n_threads;               // Compression threads, 0 for every online CPU
+    int level;                   // Deflate level, 0 for 6 (zlib: 1-9, libdeflate: 1-12)
+    int line_width;              // FASTA bases per line, 0 for 60
+    int align_records;           // Start a new block rather than split a record that fits in one
+} faidx_compress_opts_t;
+
+// Convert a FASTA/FASTQ file (plain or gzip) to BGZF at out_path (NULL for
+// in_path.gz) and write out_path.fai and out_path.gzi, in one pass over the
+// input. Blocks are deflated in parallel. FASTA is rewrapped to the line
+// width; FASTQ records are written as four lines with the '+' line bare.
+// Text before the first record is dropped. Returns 0 on success, -1 on
+// error. An input that cannot be opened or read leaves existing outputs
+// alone; a later error removes the outputs, since the archive has already
+// been overwritten.
+int faidx_compress(const char *in_path, const char *out_path, fai_format_options format,
+                   const faidx_compress_opts_t *opts);
 void faidx_reader_destroy(faidx_reader_t *reader);
 char *faidx_reader_fetch_seq(faidx_reader_t *reader, const char *c_name,
                            hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len);
 char *faidx_reader_fetch_qual(faidx_reader_t *reader, const char *c_name,
                             hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len);
+
+// Fetch the bases and quality of a FASTQ region with a single read, as the
+// quality string sits right after the sequence. On success *seq and *qual
+// are malloc'd, NUL-terminated and *len long; returns -1 (with both NULL)
+// for unknown records, empty regions or read errors.
+int faidx_reader_fetch_seq_qual(faidx_reader_t *reader, const char *c_name,
+                                hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                char **seq, char **qual, hts_pos_t *len);
+
+// Fetch into a caller-owned buffer without allocating. Returns the region
+// length after clipping to the sequence; if that exceeds buf_size nothing is
+// written and the caller should retry with a larger buffer. The result is
+// not NUL-terminated. Returns -1 for unknown sequences or read errors.
+hts_pos_t faidx_reader_fetch_seq_into(faidx_reader_t *reader, const char *c_name,
+                                      hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                      char *buf, size_t buf_size);
+
+// Transforms applied to fetched bases while they are de-lined, saving a
+// second pass over the result. Reverse complements cover the IUPAC codes
+// and keep case; FAI_FETCH_MASK_N takes precedence over FAI_FETCH_UPPER.
+#define FAI_FETCH_REVCOMP 0x01    // Reverse complement (minus strand)
+#define FAI_FETCH_UPPER   0x02    // Uppercase soft-masked (lowercase) bases
+#define FAI_FETCH_MASK_N  0x04    // Replace soft-masked bases with N
+
+// faidx_reader_fetch_seq_into with FAI_FETCH_* flags
+hts_pos_t faidx_reader_fetch_seq_into_flags(faidx_reader_t *reader, const char *c_name,
+                                            hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                            char *buf, size_t buf_size, int flags);
+
+// Stateless fetches, safe to call on one meta from any number of threads at
+// once. Each call sets up its own scratch state and reads with pread on the
+// descriptor shared by the index, so no per-thread reader (or descriptor) is
+// needed; BGZF blocks go through the shared cache. Plain gzip files, which
+// cannot be read at an offset, open a stream for every call. Results are as
+// for faidx_reader_fetch_seq and faidx_reader_fetch_seq_into.
+char *faidx_meta_fetch_seq(faidx_meta_t *meta, const char *c_name,
+                           hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len);
+hts_pos_t faidx_meta_fetch_seq_into(faidx_meta_t *meta, const char *c_name,
+                                    hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                    char *buf, size_t buf_size);
+hts_pos_t faidx_meta_fetch_seq_into_flags(faidx_meta_t *meta, const char *c_name,
+                                          hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                          char *buf, size_t buf_size, int flags);
+
+// faidx_meta_fetch_seq_into_flags for one large region (a whole chromosome)
+// on n_threads threads, 0 for one per CPU. The region is cut into chunks,
+// on BGZF block boundaries for BGZF files, and each thread inflates and
+// de-lines chunks straight into their place in buf. Every chunk counts as
+// a fetch in the meta's statistics. Plain gzip is read on one thread.
+hts_pos_t faidx_meta_fetch_seq_parallel(faidx_meta_t *meta, const char *c_name,
+                                        hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                        char *buf, size_t buf_size, int flags,
+                                        int n_threads);
+
+// One region of a batch fetch (0-based, half-open like faidx_reader_fetch_seq)
+typedef struct {
+    const char *name;
+    hts_pos_t beg, end;
+} faidx_region_t;
+
+// Fetch n regions in one pass. Regions are read in file order and runs of
+// overlapping or adjacent regions share a single read, so each BGZF block
+// is decompressed at most once per run. seqs[i] receives a malloc'd,
+// NUL-terminated copy of regions[i] and lens[i] its length; an empty region
+// gives "" and 0, an unknown sequence or read error NULL and -1. Returns the
+// number of regions fetched, or -1 if the batch could not be started.
+int64_t faidx_reader_fetch_batch(faidx_reader_t *reader, const faidx_region_t *regions,
+                                 size_t n, char **seqs, hts_pos_t *lens);
+
+// Results of faidx_reader_fetch_batch_into: every region's bases back to
+// back in one buffer, each NUL-terminated. Region i starts at seq + off[i]
+// and has len[i] bases (0 for an empty region, -1 for an unknown sequence
+// or read error, whose string is then ""). Zero-initialise before the first
+// batch; the buffers only grow and are reused by later batches, so a batch
+// allocates nothing once they are large enough.
+typedef struct {
+    char *seq;
+    size_t seq_len, seq_cap;     // Bytes used (NULs included) and allocated
+    size_t *off;
+    hts_pos_t *len;
+    size_t n, n_cap;             // Regions in the last batch, and room for them
+} faidx_batch_t;
+
+// faidx_reader_fetch_batch into one contiguous result, replacing what batch
+// held. Returns the number of regions fetched, or -1 if the batch could not
+// be started.
+int64_t faidx_reader_fetch_batch_into(faidx_reader_t *reader, const faidx_region_t *regions,
+                                      size_t n, faidx_batch_t *batch);
+void faidx_batch_free(faidx_batch_t *batch);
+
+// Asynchronous fetch engine. Regions are submitted without blocking and
+// fetched by a pool of n_threads workers (0 uses every online CPU), each
+// reading and decompressing with its own reader over the index's shared
+// descriptor, so up to n_threads reads are in flight at once. Completions
+// come back in the order they finish and carry the caller's tag. If notify
+// is set, it is called with notify_data from the thread that queued a
+// completion, with no lock held, after every completion.
+typedef struct faidx_async_t faidx_async_t;
+
+typedef struct {
+    uint64_t tag;                // As passed to faidx_async_submit
+    char *seq;                   // malloc'd and NUL-terminated, NULL on failure
+    hts_pos_t len;               // Bases fetched; 0 for an empty region, -1 for an
+                                 // unknown sequence or read error
+} faidx_completion_t;
+
+faidx_async_t *faidx_async_create(faidx_meta_t *meta, int n_threads,
+                                  void (*notify)(void *), void *notify_data);
+
+// Queue a region (0-based, half-open). Returns 0, or -1 if it could not be
+// queued; unknown sequences and empty regions complete immediately.
+int faidx_async_submit(faidx_async_t *ctx, const char *c_name,
+                       hts_pos_t p_beg_i, hts_pos_t p_end_i, uint64_t tag);
+
+// Collect up to max completions: poll returns at once, wait blocks until at
+// least one is ready or nothing is outstanding. Returns the number stored.
+size_t faidx_async_poll(faidx_async_t *ctx, faidx_completion_t *out, size_t max);
+size_t faidx_async_wait(faidx_async_t *ctx, faidx_completion_t *out, size_t max);
+
+// Regions submitted and not yet collected
+size_t faidx_async_pending(faidx_async_t *ctx);
+
+// Stop the workers once their current fetch is done. Queued requests and
+// uncollected completions are discarded.
+void faidx_async_destroy(faidx_async_t *ctx);
+
+// Streaming sequential reader for whole-file passes. Records are walked in
+// index (file) order and yielded as chunks of at most chunk_size bases that
+// never span two records; an empty record yields one empty chunk. With
+// n_threads > 0, worker threads read and inflate up to 2 * n_threads chunks
+// ahead of the consumer; with 0 every chunk is read on the calling thread.
+// Memory stays at (2 * n_threads or 1) * chunk_size whatever the record
+// lengths. A stream is consumed from one thread.
+typedef struct faidx_stream_t faidx_stream_t;
+
+typedef struct {
+    int seq_id;                  // Record index, as for faidx_meta_iseq
+    const char *name;            // Record name, valid while the index lives
+    hts_pos_t pos;               // Offset of the chunk within the record
+    hts_pos_t len;               // Bases in the chunk
+    hts_pos_t seq_len;           // Record length
+    const char *bases;           // Not NUL-terminated; valid until the next call
+} faidx_stream_chunk_t;
+
+faidx_stream_t *faidx_stream_create(faidx_meta_t *meta, size_t chunk_size, int n_threads);
+
+// Fetch the next chunk: returns 1 and fills *chunk, 0 at the end of the
+// file, or -1 on a read error
+int faidx_stream_next(faidx_stream_t *s, faidx_stream_chunk_t *chunk);
+void faidx_stream_destroy(faidx_stream_t *s);
+
 int faidx_meta_nseq(const faidx_meta_t *meta);
 const char *faidx_meta_iseq(const faidx_meta_t *meta, int i);
 hts_pos_t faidx_meta_seq_len(const faidx_meta_t *meta, const char *seq);
 int faidx_meta_has_seq(const faidx_meta_t *meta, const char *seq);
+int faidx_meta_is_mmap(const faidx_meta_t *meta);
+
+// Binary index sidecar (filename.fai.bin): the entry table, name arena, hash
+// slots and GZI block table laid out so that loading is a single read-only
+// mmap, shared across processes through the page cache. The sidecar records
+// the size and mtime of the sequence file and is ignored once they change.
+// faidx_meta_write_bin writes it atomically and returns 0 on success, -1 on
+// error; faidx_meta_is_bin reports whether meta was loaded from one.
+// FAI_LAZY skips the per-entry checks made on load, which would touch every
+// page, and reads no further ahead in the sidecar than lookups go; a load
+// that has to fall back to the text index writes the sidecar and maps it.
+int faidx_meta_write_bin(const faidx_meta_t *meta);
+int faidx_meta_is_bin(const faidx_meta_t *meta);
+
+// Packed store (FAI_PACK): sequence fetches unpack from memory instead of
+// reading the file; FASTQ qualities are still read from the file.
+// faidx_meta_packed_seq returns the ((*len + 31) / 32) packed words of a
+// sequence, or NULL if meta is not packed or the sequence is unknown.
+int faidx_meta_is_packed(const faidx_meta_t *meta);
+const uint64_t *faidx_meta_packed_seq(const faidx_meta_t *meta, const char *seq, hts_pos_t *len);
+
+// Decompressed block cache (no effect on uncompressed files). The shared
+// cache may be resized while readers are active; a reader's private cache
+// must be configured from the thread that owns the reader.
+int faidx_meta_set_cache_size(faidx_meta_t *meta, size_t bytes);
+int faidx_reader_set_cache_size(faidx_reader_t *reader, size_t bytes);
+void faidx_meta_cache_stats(const faidx_meta_t *meta, faidx_cache_stats_t *stats);
+void faidx_reader_cache_stats(const faidx_reader_t *reader, faidx_cache_stats_t *stats);
+
+// Fetch statistics of one reader, or of a meta: every reader created from
+// it, live or destroyed, plus the stateless faidx_meta_fetch_* calls. Both
+// may be called from any thread while fetches run; the snapshot of a busy
+// reader may be a fetch behind. faidx_hist_bucket_lower gives the smallest
+// time, in nanoseconds, counted by a histogram bucket.
+void faidx_reader_stats(const faidx_reader_t *reader, faidx_stats_t *stats);
+void faidx_meta_stats(faidx_meta_t *meta, faidx_stats_t *stats);
+uint64_t faidx_hist_bucket_lower(int bucket);
+
+// Readahead for forward-sequential access such as sorted regions or tiling
+// windows. With n_blocks < 0 (the default) it starts by itself once
+// FAI_READAHEAD_STREAK reads in a row have moved forward, covering
+// FAI_READAHEAD_BLOCKS blocks, and pauses when access turns random; 0 turns
+// it off and n_blocks > 0 keeps it on with that window. BGZF readers get a
+// background thread that inflates the next blocks after each fetch;
+// uncompressed files get posix_fadvise/madvise WILLNEED hints for the same
+// span (64 KiB per block). Returns 0 on success, -1 on error.
+#define FAI_READAHEAD_STREAK 4
+#define FAI_READAHEAD_BLOCKS 16
+int faidx_reader_set_readahead(faidx_reader_t *reader, int n_blocks);
+
+// Collection of FASTA/FASTQ files behind one name index, for references
+// spread over many files (one assembly per file, say). Names are looked up
+// in a single table merged from every file's index; a name found in several
+// files resolves to the first. Descriptors are opened on first read and
+// shared by all readers, with at most max_open (FAI_COLL_MAX_OPEN unless
+// changed) kept open: the least recently used idle one is closed to make
+// room. Memory-mapped, plain gzip and remote files keep their own handling.
+// paths and flags are as for faidx_meta_load; the collection is immutable
+// after loading, and safe to share between threads like a meta.
+#define FAI_COLL_MAX_OPEN 64
+typedef struct faidx_coll_t faidx_coll_t;
+faidx_coll_t *faidx_coll_load(const char *const *paths, int n, fai_format_options format, int flags);
+faidx_coll_t *faidx_coll_ref(faidx_coll_t *coll);
+void faidx_coll_destroy(faidx_coll_t *coll);
+int faidx_coll_set_max_open(faidx_coll_t *coll, int max_open);
+int faidx_coll_open_files(const faidx_coll_t *coll);
+int faidx_coll_nfiles(const faidx_coll_t *coll);
+faidx_meta_t *faidx_coll_meta(const faidx_coll_t *coll, int file);   // Borrowed
+int faidx_coll_nseq(const faidx_coll_t *coll);
+const char *faidx_coll_iseq(const faidx_coll_t *coll, int i);
+int faidx_coll_file_of(const faidx_coll_t *coll, const char *name);  // -1 if unknown
+hts_pos_t faidx_coll_seq_len(const faidx_coll_t *coll, const char *name);
+hts_pos_t faidx_coll_fetch_seq_into_flags(faidx_coll_t *coll, const char *c_name,
+                                          hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                          char *buf, size_t buf_size, int flags);
+
+// Per-thread reader over a collection. A file's reader is created the first
+// time one of its sequences is fetched, and only the FAI_COLL_READERS most
+// recently used are kept. faidx_coll_reader_get returns (borrowed) the reader
+// for a sequence's file for calls not wrapped here; results are as for the
+// faidx_reader_* functions of the same name.
+#define FAI_COLL_READERS 16
+typedef struct faidx_coll_reader_t faidx_coll_reader_t;
+faidx_coll_reader_t *faidx_coll_reader_create(faidx_coll_t *coll);
+void faidx_coll_reader_destroy(faidx_coll_reader_t *r);
+faidx_reader_t *faidx_coll_reader_get(faidx_coll_reader_t *r, const char *c_name);
+char *faidx_coll_reader_fetch_seq(faidx_coll_reader_t *r, const char *c_name,
+                                  hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len);
+char *faidx_coll_reader_fetch_qual(faidx_coll_reader_t *r, const char *c_name,
+                                   hts_pos_t p_beg_i, hts_pos_t p_end_i, hts_pos_t *len);
+hts_pos_t faidx_coll_reader_fetch_seq_into_flags(faidx_coll_reader_t *r, const char *c_name,
+                                                 hts_pos_t p_beg_i, hts_pos_t p_end_i,
+                                                 char *buf, size_t buf_size, int flags);
 
 // BGZF support functions
 gzi_index_t *load_gzi_index(const char *gzi_path);
 void destroy_gzi_index(gzi_index_t *index);
-int bgzf_read_block(gzFile fp, uint64_t coffset, char *buffer, int buffer_size);
+int bgzf_read_block(int fd, uint64_t coffset, char *buffer, int buffer_size);
 uint64_t find_bgzf_block(gzi_index_t *index, uint64_t uncompressed_offset);
 
 // Debug helper function
@@ -1,5 +1,7 @@
-use clap::{Parser, Subcommand};
-use faigz_rs::{FastaFormat, FastaIndex, FastaReader};
+use clap::{Parser, Subcommand, ValueEnum};
+use faigz_rs::{
+    BatchBuffer, CompressOptions, FastaFormat, FastaIndex, FastaReader, PhaseHistogram,
+};
 use std::fs;
 
 #[derive(Parser)]
@@ -36,6 +38,39 @@ enum Commands {
         #[arg(short, long)]
         one_based: bool,
     },
+    /// Extract every interval of a BED file (like bedtools getfasta)
+    Bed {
+        /// FASTA file path
+        fasta: String,
+        /// BED file with 0-based half-open intervals (chrom, start, end)
+        bed: String,
+        /// Number of intervals fetched per batch
+        #[arg(short, long, default_value = "100000")]
+        batch_size: usize,
+    },
+    /// Convert FASTA/FASTQ to BGZF and write its .fai and .gzi in one pass
+    Compress {
+        /// Input FASTA/FASTQ file (plain or gzip)
+        input: String,
+        /// Output BGZF file [default: INPUT.gz]
+        #[arg(short, long)]
+        output: Option<String>,
+        /// Input is FASTQ
+        #[arg(long)]
+        fastq: bool,
+        /// Compression threads (0 uses every CPU)
+        #[arg(short, long, default_value = "0")]
+        threads: usize,
+        /// Deflate level (0 for the default)
+        #[arg(short, long, default_value = "0")]
+        level: u32,
+        /// FASTA bases per line
+        #[arg(short = 'w', long, default_value = "60")]
+        line_width: usize,
+        /// Keep records that fit in a block within one block
+        #[arg(short, long)]
+        align: bool,
+    },
     /// Test multithreaded access
     ThreadTest {
         /// FASTA file path
@@ -46,6 +81,57 @@ enum Commands {
         /// Number of operations per thread
         #[arg(short, long, default_value = "100")]
         operations: usize,
+        /// Memory-map uncompressed files and share the mapping across threads
+        #[arg(long)]
+        mmap: bool,
+    },
+    /// Run a fetch workload and report counters and phase latencies
+    Stats {
+        /// FASTA file path
+        fasta: String,
+        /// Number of threads, each with its own reader
+        #[arg(short, long, default_value = "1")]
+        threads: usize,
+        /// Fetches per thread
+        #[arg(short = 'n', long, default_value = "10000")]
+        fetches: usize,
+        /// Bases per fetch
+        #[arg(short, long, default_value = "1000")]
+        length: i64,
+        /// Tile each sequence in order instead of fetching random regions
+        #[arg(short, long)]
+        sequential: bool,
+        /// Shared block cache size in MiB (BGZF only)
+        #[arg(short, long, default_value = "0")]
+        cache_mb: usize,
+        /// Memory-map uncompressed files
+        #[arg(long)]
+        mmap: bool,
+    },
+    /// Replay a recorded trace of fetches and report latency, throughput and I/O efficiency
+    Replay {
+        /// FASTA file path or URL
+        fasta: String,
+        /// Trace file, one `name beg end [thread]` request per line (0-based, half-open;
+        /// the thread is any label, and unlabeled requests form a thread of their own)
+        trace: String,
+        /// Worker threads, each with its own reader; trace threads are spread over them
+        /// (0 for one per trace thread)
+        #[arg(short, long, default_value = "0")]
+        threads: usize,
+        /// Requests per second across all workers, each request issued at its slot in the
+        /// trace (0 for as fast as possible)
+        #[arg(short, long, default_value = "0")]
+        rate: f64,
+        /// How the index is loaded
+        #[arg(short, long, value_enum, default_value = "default")]
+        backend: Backend,
+        /// Shared block cache size in MiB (BGZF only)
+        #[arg(short, long, default_value = "0")]
+        cache_mb: usize,
+        /// Replay the trace this many times
+        #[arg(long, default_value = "1")]
+        repeat: usize,
     },
     /// Compare with samtools faidx output
     Compare {
@@ -59,6 +145,21 @@ enum Commands {
     },
 }
 
+/// Index loaders the replay can compare
+#[derive(Clone, Copy, ValueEnum)]
+enum Backend {
+    /// `FastaIndex::new`: pread for plain files, BGZF blocks, range requests for URLs
+    Default,
+    /// One shared memory mapping of an uncompressed file
+    Mmap,
+    /// Sequences packed 2 bits per base in memory
+    Packed,
+    /// `.fai.bin` sidecar paged in as lookups touch it
+    Lazy,
+    /// Huge pages and per-NUMA-node copies of the tables
+    Numa,
+}
+
 fn main() -> Result<(), Box<dyn std::error::Error>> {
     let cli = Cli::parse();
 
@@ -77,12 +178,66 @@ fn main() -> Result<(), Box<dyn std::error::Error>> {
         } => {
             extract_sequences(&fasta, &regions, one_based)?;
         }
+        Commands::Bed {
+            fasta,
+            bed,
+            batch_size,
+        } => {
+            extract_bed(&fasta, &bed, batch_size)?;
+        }
+        Commands::Compress {
+            input,
+            output,
+            fastq,
+            threads,
+            level,
+            line_width,
+            align,
+        } => {
+            let output = output.unwrap_or_else(|| format!("{}.gz", input));
+            let format = if fastq {
+                FastaFormat::Fastq
+            } else {
+                FastaFormat::Fasta
+            };
+            let options = CompressOptions {
+                threads,
+                level,
+                line_width,
+                align_records: align,
+            };
+            FastaIndex::compress(&input, &output, format, &options)?;
+            println!("Wrote {0}, {0}.fai and {0}.gzi", output);
+        }
         Commands::ThreadTest {
             fasta,
             threads,
             operations,
+            mmap,
         } => {
-            thread_test(&fasta, threads, operations)?;
+            thread_test(&fasta, threads, operations, mmap)?;
+        }
+        Commands::Stats {
+            fasta,
+            threads,
+            fetches,
+            length,
+            sequential,
+            cache_mb,
+            mmap,
+        } => {
+            fetch_stats(&fasta, threads, fetches, length, sequential, cache_mb, mmap)?;
+        }
+        Commands::Replay {
+            fasta,
+            trace,
+            threads,
+            rate,
+            backend,
+            cache_mb,
+            repeat,
+        } => {
+            replay(&fasta, &trace, threads, rate, backend, cache_mb, repeat)?;
         }
         Commands::Compare {
             fasta,
@@ -212,16 +367,99 @@ fn extract_sequences(
     Ok(())
 }
 
+fn extract_bed(
+    fasta: &str,
+    bed: &str,
+    batch_size: usize,
+) -> Result<(), Box<dyn std::error::Error>> {
+    use std::io::{BufRead, BufReader, BufWriter, Write};
+
+    let index = FastaIndex::new(fasta, FastaFormat::Fasta)?;
+    let reader = FastaReader::new(&index)?;
+    let stdout = std::io::stdout();
+    let mut out = BufWriter::new(stdout.lock());
+
+    // One buffer holds every batch's bases, so a batch costs no per-region
+    // allocations
+    let mut batch = BatchBuffer::new();
+    let mut write_batch = |regions: &[(String, i64, i64)]| -> std::io::Result<()> {
+        let view = match reader.fetch_batch_into(regions, &mut batch) {
+            Ok(view) => view,
+            Err(e) => {
+                eprintln!("Error extracting batch: {}", e);
+                return Ok(());
+            }
+        };
+        for ((chr, start, end), bases) in regions.iter().zip(view.iter()) {
+            match bases {
+                Some(bases) => {
+                    writeln!(out, ">{}:{}-{}", chr, start, end)?;
+                    for line in bases.chunks(80) {
+                        out.write_all(line)?;
+                        out.write_all(b"\n")?;
+                    }
+                }
+                None => {
+                    eprintln!(
+                        "Error extracting {}:{}-{}: sequence not found",
+                        chr, start, end
+                    );
+                }
+            }
+        }
+        Ok(())
+    };
+
+    let mut regions = Vec::with_capacity(batch_size.max(1));
+    for (line_no, line) in BufReader::new(fs::File::open(bed)?).lines().enumerate() {
+        let line = line?;
+        if line.is_empty()
+            || line.starts_with('#')
+            || line.starts_with("track")
+            || line.starts_with("browser")
+        {
+            continue;
+        }
+
+        let fields: Vec<&str> = line.split('\t').collect();
+        if fields.len() < 3 {
+            eprintln!("Invalid BED line {}: {}", line_no + 1, line);
+            continue;
+        }
+        let start: i64 = fields[1]
+            .parse()
+            .map_err(|e| format!("Invalid start on line {}: {}", line_no + 1, e))?;
+        let end: i64 = fields[2]
+            .parse()
+            .map_err(|e| format!("Invalid end on line {}: {}", line_no + 1, e))?;
+        regions.push((fields[0].to_string(), start, end));
+
+        if regions.len() >= batch_size.max(1) {
+            write_batch(&regions)?;
+            regions.clear();
+        }
+    }
+    write_batch(&regions)?;
+
+    Ok(())
+}
+
 fn thread_test(
     fasta: &str,
     num_threads: usize,
     operations: usize,
+    mmap: bool,
 ) -> Result<(), Box<dyn std::error::Error>> {
     use std::sync::Arc;
     use std::thread;
     use std::time::Instant;
 
-    let index = Arc::new(FastaIndex::new(fasta, FastaFormat::Fasta)?);
+    let index = if mmap {
+        FastaIndex::new_mmap(fasta, FastaFormat::Fasta)?
+    } else {
+        FastaIndex::new(fasta, FastaFormat::Fasta)?
+    };
+    let index = Arc::new(index);
     let sequences = index.sequence_names();
 
     if sequences.is_empty() {
@@ -295,6 +533,328 @@ fn thread_test(
     Ok(())
 }
 
+fn fetch_stats(
+    fasta: &str,
+    num_threads: usize,
+    fetches: usize,
+    length: i64,
+    sequential: bool,
+    cache_mb: usize,
+    mmap: bool,
+) -> Result<(), Box<dyn std::error::Error>> {
+    use std::sync::Arc;
+    use std::thread;
+    use std::time::Instant;
+
+    let index = if mmap {
+        FastaIndex::new_mmap(fasta, FastaFormat::Fasta)?
+    } else {
+        FastaIndex::new(fasta, FastaFormat::Fasta)?
+    };
+    index.set_cache_size(cache_mb << 20);
+    let index = Arc::new(index);
+    let sequences: Vec<(String, i64)> = index
+        .sequence_names()
+        .into_iter()
+        .filter_map(|name| index.sequence_length(&name).map(|len| (name, len)))
+        .filter(|&(_, len)| len > 0)
+        .collect();
+    if sequences.is_empty() {
+        return Err("No sequences found in FASTA file".into());
+    }
+    let length = length.max(1);
+
+    let start = Instant::now();
+    let handles: Vec<_> = (0..num_threads.max(1))
+        .map(|thread_id| {
+            let index = Arc::clone(&index);
+            let sequences = sequences.clone();
+            thread::spawn(move || -> Result<(), faigz_rs::FastaError> {
+                let reader = FastaReader::new(&index)?;
+                let mut buf = Vec::new();
+                // xorshift, seeded per thread, so runs are repeatable
+                let mut state = 0x9e37_79b9_7f4a_7c15u64 ^ (thread_id as u64 + 1);
+                let (mut seq, mut pos) = (thread_id % sequences.len(), 0);
+                for _ in 0..fetches {
+                    let beg = if sequential {
+                        if pos >= sequences[seq].1 {
+                            seq = (seq + 1) % sequences.len();
+                            pos = 0;
+                        }
+                        pos += length;
+                        pos - length
+                    } else {
+                        state ^= state << 13;
+                        state ^= state >> 7;
+                        state ^= state << 17;
+                        seq = (state % sequences.len() as u64) as usize;
+                        ((state >> 20) % sequences[seq].1 as u64) as i64
+                    };
+                    buf.clear();
+                    reader.fetch_seq_into(&sequences[seq].0, beg, beg + length, &mut buf)?;
+                }
+                Ok(())
+            })
+        })
+        .collect();
+    for handle in handles {
+        handle.join().unwrap()?;
+    }
+    let elapsed = start.elapsed();
+
+    let stats = index.stats();
+    println!(
+        "{} fetches, {} bases in {:?} ({:.0} fetches/s, {:.1} MB/s)",
+        stats.fetches,
+        stats.bases,
+        elapsed,
+        stats.fetches as f64 / elapsed.as_secs_f64(),
+        stats.bases as f64 / elapsed.as_secs_f64() / 1e6
+    );
+    println!("Bytes read:        {}", stats.bytes_read);
+    println!("Compressed bytes:  {}", stats.compressed_bytes);
+    println!("Blocks inflated:   {}", stats.blocks_inflated);
+    println!("Blocks reused:     {}", stats.blocks_reused);
+    println!(
+        "Cache hits/misses: {}/{}",
+        stats.cache_hits, stats.cache_misses
+    );
+    println!();
+    println!(
+        "{:<8} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10}",
+        "phase", "timed", "mean", "p50", "p90", "p99", "max"
+    );
+    for (phase, hist) in [
+        ("lookup", &stats.lookup),
+        ("read", &stats.read),
+        ("inflate", &stats.inflate),
+        ("deline", &stats.deline),
+    ] {
+        print_phase(phase, hist);
+    }
+
+    Ok(())
+}
+
+fn ns(t: u64) -> String {
+    match t {
+        0..=999 => format!("{}ns", t),
+        1_000..=999_999 => format!("{:.1}us", t as f64 / 1e3),
+        _ => format!("{:.1}ms", t as f64 / 1e6),
+    }
+}
+
+fn print_phase(phase: &str, hist: &PhaseHistogram) {
+    println!(
+        "{:<8} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10}",
+        phase,
+        hist.count,
+        ns(hist.mean_ns()),
+        ns(hist.quantile_ns(0.5)),
+        ns(hist.quantile_ns(0.9)),
+        ns(hist.quantile_ns(0.99)),
+        ns(hist.max_ns)
+    );
+}
+
+/// One request of a replay trace
+struct TraceRequest {
+    name: String,
+    beg: i64,
+    end: i64,
+    thread: usize, // Trace threads numbered in order of first appearance, unlabeled last
+}
+
+fn read_trace(trace: &str) -> Result<Vec<TraceRequest>, Box<dyn std::error::Error>> {
+    let mut requests = Vec::new();
+    let mut threads = std::collections::HashMap::new();
+    for (i, line) in fs::read_to_string(trace)?.lines().enumerate() {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let fields: Vec<&str> = line.split_whitespace().collect();
+        let bad = || format!("{}:{}: expected `name beg end [thread]`", trace, i + 1);
+        if fields.len() < 3 || fields.len() > 4 {
+            return Err(bad().into());
+        }
+        requests.push(TraceRequest {
+            name: fields[0].to_string(),
+            beg: fields[1].parse().map_err(|_| bad())?,
+            end: fields[2].parse().map_err(|_| bad())?,
+            thread: match fields.get(3) {
+                Some(&thread) => {
+                    let next = threads.len();
+                    *threads.entry(thread.to_string()).or_insert(next)
+                }
+                None => usize::MAX,
+            },
+        });
+    }
+    // Unlabeled requests make up a trace thread of their own, after the labeled ones
+    let unlabeled = threads.len();
+    for request in requests.iter_mut().filter(|r| r.thread == usize::MAX) {
+        request.thread = unlabeled;
+    }
+    Ok(requests)
+}
+
+/// Replay the requests of the trace threads that map to `worker`, in trace
+/// order; returns each request's latency in nanoseconds, the bases returned
+/// and the number of failed requests
+fn replay_worker(
+    index: &FastaIndex,
+    requests: &[TraceRequest],
+    worker: usize,
+    workers: usize,
+    repeat: usize,
+    rate: f64,
+    start: std::time::Instant,
+) -> Result<(Vec<u64>, u64, usize), faigz_rs::FastaError> {
+    use std::time::{Duration, Instant};
+
+    let reader = FastaReader::new(index)?;
+    let mut buf = Vec::new();
+    let mut latencies = Vec::new();
+    let (mut bases, mut failed) = (0u64, 0usize);
+    for round in 0..repeat {
+        for (i, request) in requests.iter().enumerate() {
+            if request.thread % workers != worker {
+                continue;
+            }
+            let issued = if rate > 0.0 {
+                let slot = round * requests.len() + i;
+                let due = start + Duration::from_secs_f64(slot as f64 / rate);
+                if let Some(wait) = due.checked_duration_since(Instant::now()) {
+                    std::thread::sleep(wait);
+                }
+                due
+            } else {
+                Instant::now()
+            };
+            buf.clear();
+            match reader.fetch_seq_into(&request.name, request.beg, request.end, &mut buf) {
+                Ok(n) => bases += n as u64,
+                Err(_) => failed += 1,
+            }
+            latencies.push(issued.elapsed().as_nanos() as u64);
+        }
+    }
+    Ok((latencies, bases, failed))
+}
+
+fn replay(
+    fasta: &str,
+    trace: &str,
+    threads: usize,
+    rate: f64,
+    backend: Backend,
+    cache_mb: usize,
+    repeat: usize,
+) -> Result<(), Box<dyn std::error::Error>> {
+    use std::sync::Arc;
+    use std::thread;
+    use std::time::Instant;
+
+    let repeat = repeat.max(1);
+    let requests = Arc::new(read_trace(trace)?);
+    if requests.is_empty() {
+        return Err(format!("{}: no requests", trace).into());
+    }
+    let index = match backend {
+        Backend::Default => FastaIndex::new(fasta, FastaFormat::Fasta)?,
+        Backend::Mmap => FastaIndex::new_mmap(fasta, FastaFormat::Fasta)?,
+        Backend::Packed => FastaIndex::new_packed(fasta, FastaFormat::Fasta)?,
+        Backend::Lazy => FastaIndex::new_lazy(fasta, FastaFormat::Fasta)?,
+        Backend::Numa => FastaIndex::new_numa(fasta, FastaFormat::Fasta)?,
+    };
+    index.set_cache_size(cache_mb << 20);
+    let index = Arc::new(index);
+
+    // Each trace thread's requests stay in order on one worker
+    let workers = if threads > 0 {
+        threads
+    } else {
+        requests.iter().map(|r| r.thread).max().unwrap_or(0) + 1
+    };
+    let total = requests.len() * repeat;
+
+    // With a rate, latency runs from each request's slot rather than from
+    // when a worker got to it, so a backlog shows up in the tail
+    let start = Instant::now();
+    let handles: Vec<_> = (0..workers)
+        .map(|worker| {
+            let index = Arc::clone(&index);
+            let requests = Arc::clone(&requests);
+            thread::spawn(move || {
+                replay_worker(&index, &requests, worker, workers, repeat, rate, start)
+            })
+        })
+        .collect();
+
+    let mut latencies = Vec::with_capacity(total);
+    let (mut bases, mut failed) = (0u64, 0usize);
+    for handle in handles {
+        let (worker_latencies, worker_bases, worker_failed) = handle.join().unwrap()?;
+        latencies.extend(worker_latencies);
+        bases += worker_bases;
+        failed += worker_failed;
+    }
+    let elapsed = start.elapsed();
+    latencies.sort_unstable();
+    let quantile =
+        |q: f64| latencies[((q * latencies.len() as f64) as usize).min(latencies.len() - 1)];
+
+    let stats = index.stats();
+    let per_base = |bytes: u64| bytes as f64 / bases.max(1) as f64;
+    println!(
+        "{} requests ({} failed) on {} workers in {:?}: {:.0} requests/s, {:.1} MB/s",
+        total,
+        failed,
+        workers,
+        elapsed,
+        total as f64 / elapsed.as_secs_f64(),
+        bases as f64 / elapsed.as_secs_f64() / 1e6
+    );
+    println!(
+        "Latency: p50 {}  p99 {}  p999 {}  max {}",
+        ns(quantile(0.5)),
+        ns(quantile(0.99)),
+        ns(quantile(0.999)),
+        ns(latencies[latencies.len() - 1])
+    );
+    println!("Bases returned:            {}", bases);
+    println!(
+        "Bytes read per base:       {:.3}",
+        per_base(stats.bytes_read)
+    );
+    println!(
+        "Bytes inflated per base:   {:.3}",
+        per_base(stats.bytes_inflated)
+    );
+    println!(
+        "Compressed bytes per base: {:.3}",
+        per_base(stats.compressed_bytes)
+    );
+    println!(
+        "Blocks inflated/reused:    {}/{}",
+        stats.blocks_inflated, stats.blocks_reused
+    );
+    let lookups = stats.cache_hits + stats.cache_misses;
+    println!(
+        "Cache hits/misses:         {}/{} ({:.1}% hit)",
+        stats.cache_hits,
+        stats.cache_misses,
+        if lookups > 0 {
+            100.0 * stats.cache_hits as f64 / lookups as f64
+        } else {
+            0.0
+        }
+    );
+
+    Ok(())
+}
+
 fn compare_with_samtools(
     fasta: &str,
     region: &str,
@@ -30,9 +30,15 @@
 //! # Ok::<(), Box<dyn std::error::Error>>(())
 //! ```
 
+use std::collections::{HashMap, VecDeque};
 use std::ffi::{CStr, CString};
-use std::os::raw::{c_int, c_void};
-use std::sync::Arc;
+use std::future::Future;
+use std::ops::{Deref, DerefMut};
+use std::os::raw::{c_char, c_int, c_void};
+use std::pin::Pin;
+use std::sync::atomic::{AtomicPtr, AtomicU64, Ordering};
+use std::sync::{Condvar, Mutex, MutexGuard};
+use std::task::{Context, Poll, Waker};
 use thiserror::Error;
 
 // Include the generated bindings
@@ -65,6 +71,79 @@ pub enum FastaError {
 /// Result type for FASTA operations
 pub type FastaResult<T> = Result<T, FastaError>;
 
+/// Handling of soft-masked (lowercase) bases, see [`SeqTransform`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum SoftMask {
+    /// Leave the case as it is in the file
+    #[default]
+    Keep,
+    /// Uppercase soft-masked bases
+    Upper,
+    /// Replace soft-masked bases with `N`
+    HardMask,
+}
+
+/// Transforms applied to fetched bases, see [`FastaReader::fetch_seq_transformed`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct SeqTransform {
+    /// Reverse complement the region (minus strand); IUPAC codes are
+    /// complemented and case is kept
+    pub reverse_complement: bool,
+    /// What to do with soft-masked bases
+    pub soft_mask: SoftMask,
+}
+
+impl SeqTransform {
+    /// Reverse complement only
+    pub fn reverse_complement() -> Self {
+        SeqTransform {
+            reverse_complement: true,
+            soft_mask: SoftMask::Keep,
+        }
+    }
+
+    fn flags(self) -> c_int {
+        let strand = if self.reverse_complement {
+            FAI_FETCH_REVCOMP
+        } else {
+            0
+        };
+        let mask = match self.soft_mask {
+            SoftMask::Keep => 0,
+            SoftMask::Upper => FAI_FETCH_UPPER,
+            SoftMask::HardMask => FAI_FETCH_MASK_N,
+        };
+        (strand | mask) as c_int
+    }
+}
+
+/// Options for [`FastaIndex::compress`]; the defaults match `bgzip`
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct CompressOptions {
+    /// Compression threads (0 uses every online CPU)
+    pub threads: usize,
+    /// Deflate level, 0 for the default of 6 (1-9, or 1-12 with libdeflate)
+    pub level: u32,
+    /// FASTA bases per line, 0 for 60
+    pub line_width: usize,
+    /// Start a new block rather than split a record that fits in one, so a
+    /// fetch within a record touches a single block. Costs some ratio on
+    /// files of many short records.
+    pub align_records: bool,
+}
+
+/// Readahead policy of a [`FastaReader`], see [`FastaReader::set_readahead`]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum Readahead {
+    /// Start once fetches keep moving forward, pause when they jump around
+    #[default]
+    Auto,
+    /// Never read ahead
+    Off,
+    /// Always read this many 64 KiB blocks ahead (0 is the same as `Off`)
+    Blocks(usize),
+}
+
 /// Format options for FASTA/FASTQ files
 #[derive(Debug, Clone, Copy)]
 pub enum FastaFormat {
@@ -83,6 +162,291 @@ impl From<FastaFormat> for fai_format_options {
     }
 }
 
+/// Decompressed block cache counters
+///
+/// Returned by [`FastaIndex::cache_stats`] for the shared cache and by
+/// [`FastaReader::cache_stats`] for the cache a reader uses.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CacheStats {
+    /// Lookups served from the cache
+    pub hits: u64,
+    /// Lookups that had to read and inflate the block
+    pub misses: u64,
+    /// Blocks dropped to stay within the budget
+    pub evictions: u64,
+    /// Decompressed bytes currently cached
+    pub bytes: u64,
+    /// Configured budget in bytes (0 when disabled)
+    pub capacity: u64,
+}
+
+impl From<faidx_cache_stats_t> for CacheStats {
+    fn from(stats: faidx_cache_stats_t) -> Self {
+        CacheStats {
+            hits: stats.hits,
+            misses: stats.misses,
+            evictions: stats.evictions,
+            bytes: stats.bytes,
+            capacity: stats.capacity,
+        }
+    }
+}
+
+/// Latency histogram of one fetch phase
+///
+/// Buckets are log-linear: every power of two of nanoseconds is split into
+/// four, so a reported quantile is within 25% of the true value.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct PhaseHistogram {
+    /// Timed fetches
+    pub count: u64,
+    /// Time spent in the phase over all timed fetches
+    pub sum_ns: u64,
+    /// Slowest timed fetch
+    pub max_ns: u64,
+    buckets: Vec<u64>,
+}
+
+impl PhaseHistogram {
+    fn from_raw(hist: &faidx_hist_t) -> Self {
+        PhaseHistogram {
+            count: hist.count,
+            sum_ns: hist.sum_ns,
+            max_ns: hist.max_ns,
+            buckets: hist.buckets.to_vec(),
+        }
+    }
+
+    /// Mean time of the phase in nanoseconds, 0 if nothing was timed
+    pub fn mean_ns(&self) -> u64 {
+        if self.count == 0 {
+            return 0;
+        }
+        self.sum_ns / self.count
+    }
+
+    /// Time in nanoseconds that a fraction `q` (0.0 to 1.0) of the timed
+    /// fetches stayed within, rounded up to the end of its bucket
+    pub fn quantile_ns(&self, q: f64) -> u64 {
+        let target = (q.clamp(0.0, 1.0) * self.count as f64).ceil().max(1.0) as u64;
+        let mut seen = 0;
+        for (b, &n) in self.buckets.iter().enumerate() {
+            seen += n;
+            if seen >= target && n > 0 {
+                if b + 1 == self.buckets.len() {
+                    return self.max_ns;
+                }
+                let end = unsafe { faidx_hist_bucket_lower((b + 1) as c_int) } - 1;
+                return end.min(self.max_ns);
+            }
+        }
+        self.max_ns
+    }
+
+    /// Non-empty buckets as (smallest time in nanoseconds, fetches)
+    pub fn buckets(&self) -> impl Iterator<Item = (u64, u64)> + '_ {
+        self.buckets
+            .iter()
+            .enumerate()
+            .filter(|&(_, &n)| n > 0)
+            .map(|(b, &n)| (unsafe { faidx_hist_bucket_lower(b as c_int) }, n))
+    }
+}
+
+/// Fetch counters and phase latencies
+///
+/// Returned by [`FastaReader::stats`] for one reader and by
+/// [`FastaIndex::stats`] for every reader of an index, including the ones
+/// already dropped and the stateless fetches. Counters are exact; the phases
+/// are timed on one fetch in 64, and a batch is timed as one fetch.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct FetchStats {
+    /// Regions fetched (every region of a batch counts, size queries do not)
+    pub fetches: u64,
+    /// Bases returned
+    pub bases: u64,
+    /// File bytes read, newlines included (decompressed for BGZF)
+    pub bytes_read: u64,
+    /// Compressed bytes read from disk (BGZF only)
+    pub compressed_bytes: u64,
+    /// BGZF blocks this reader inflated
+    pub blocks_inflated: u64,
+    /// Decompressed bytes of the blocks inflated
+    pub bytes_inflated: u64,
+    /// BGZF blocks served by the last decompressed block or by readahead
+    pub blocks_reused: u64,
+    /// Block cache hits
+    pub cache_hits: u64,
+    /// Block cache misses
+    pub cache_misses: u64,
+    /// Fetches whose phases were timed
+    pub timed: u64,
+    /// Name lookup and region resolution
+    pub lookup: PhaseHistogram,
+    /// Reading the file: pread, the mapping or the block cache
+    pub read: PhaseHistogram,
+    /// Inflating BGZF blocks
+    pub inflate: PhaseHistogram,
+    /// Stripping newlines, applying transforms or unpacking
+    pub deline: PhaseHistogram,
+}
+
+impl From<&faidx_stats_t> for FetchStats {
+    fn from(stats: &faidx_stats_t) -> Self {
+        let phase = |p: u32| PhaseHistogram::from_raw(&stats.phases[p as usize]);
+        FetchStats {
+            fetches: stats.fetches,
+            bases: stats.bases,
+            bytes_read: stats.bytes_read,
+            compressed_bytes: stats.compressed_bytes,
+            blocks_inflated: stats.blocks_inflated,
+            bytes_inflated: stats.bytes_inflated,
+            blocks_reused: stats.blocks_reused,
+            cache_hits: stats.cache_hits,
+            cache_misses: stats.cache_misses,
+            timed: stats.timed,
+            lookup: phase(FAI_PHASE_LOOKUP),
+            read: phase(FAI_PHASE_READ),
+            inflate: phase(FAI_PHASE_INFLATE),
+            deline: phase(FAI_PHASE_DELINE),
+        }
+    }
+}
+
+/// Run `f` with a NUL-terminated copy of `name`, kept on the stack when short
+///
+/// Returns `None` if the name contains an interior NUL byte.
+fn with_c_name<T>(name: &str, f: impl FnOnce(*const c_char) -> T) -> Option<T> {
+    let bytes = name.as_bytes();
+    if bytes.contains(&0) {
+        return None;
+    }
+
+    let mut stack = [0u8; 256];
+    if bytes.len() < stack.len() {
+        stack[..bytes.len()].copy_from_slice(bytes);
+        Some(f(stack.as_ptr() as *const c_char))
+    } else {
+        let c_name = CString::new(name).ok()?;
+        Some(f(c_name.as_ptr()))
+    }
+}
+
+/// Where a fetch reads from: a reader's own state or the index's stateless
+/// path, for one file or a collection
+#[derive(Clone, Copy)]
+enum FetchSource {
+    Reader(*mut faidx_reader_t),
+    Shared(*mut faidx_meta_t),
+    Parallel(*mut faidx_meta_t, c_int),
+    CollectionReader(*mut faidx_coll_reader_t),
+    Collection(*mut faidx_coll_t),
+}
+
+impl FetchSource {
+    /// `faidx_*_fetch_seq_into` for this source
+    unsafe fn fetch_seq_into(
+        self,
+        c_name: *const c_char,
+        start: i64,
+        end: i64,
+        buf: *mut c_char,
+        buf_size: usize,
+        flags: c_int,
+    ) -> hts_pos_t {
+        match self {
+            FetchSource::Reader(reader) => {
+                faidx_reader_fetch_seq_into_flags(reader, c_name, start, end, buf, buf_size, flags)
+            }
+            FetchSource::Shared(meta) => {
+                faidx_meta_fetch_seq_into_flags(meta, c_name, start, end, buf, buf_size, flags)
+            }
+            FetchSource::Parallel(meta, threads) => faidx_meta_fetch_seq_parallel(
+                meta, c_name, start, end, buf, buf_size, flags, threads,
+            ),
+            FetchSource::CollectionReader(reader) => faidx_coll_reader_fetch_seq_into_flags(
+                reader, c_name, start, end, buf, buf_size, flags,
+            ),
+            FetchSource::Collection(coll) => {
+                faidx_coll_fetch_seq_into_flags(coll, c_name, start, end, buf, buf_size, flags)
+            }
+        }
+    }
+}
+
+/// Append the bases of a region to `buf`, transformed by the `FAI_FETCH_*`
+/// `flags`; returns the number appended
+fn fetch_into(
+    source: FetchSource,
+    seqname: &str,
+    start: i64,
+    end: i64,
+    flags: c_int,
+    buf: &mut Vec<u8>,
+) -> FastaResult<usize> {
+    let not_found = || FastaError::SequenceNotFound(seqname.to_string());
+
+    with_c_name(seqname, |c_name| loop {
+        let spare = buf.capacity() - buf.len();
+        let n = unsafe {
+            source.fetch_seq_into(
+                c_name,
+                start,
+                end,
+                buf.as_mut_ptr().add(buf.len()) as *mut c_char,
+                spare,
+                flags,
+            )
+        };
+
+        if n < 0 {
+            return Err(not_found());
+        }
+        let n = n as usize;
+        if n > spare {
+            // Too small: nothing was written, so grow and fetch again
+            buf.reserve(n);
+            continue;
+        }
+
+        // The C side initialised exactly n bytes of spare capacity
+        unsafe { buf.set_len(buf.len() + n) };
+        return Ok(n);
+    })
+    .ok_or_else(not_found)?
+}
+
+/// C regions for a batch fetch, with their NUL-terminated names packed into
+/// one buffer that must outlive them. Names with an interior NUL get a null
+/// name, which C reports as not found.
+fn batch_regions<S: AsRef<str>>(regions: &[(S, i64, i64)]) -> (Vec<u8>, Vec<faidx_region_t>) {
+    let mut names = Vec::new();
+    let mut offsets = Vec::with_capacity(regions.len());
+    for (name, _, _) in regions {
+        let bytes = name.as_ref().as_bytes();
+        if bytes.contains(&0) {
+            offsets.push(None);
+            continue;
+        }
+        offsets.push(Some(names.len()));
+        names.extend_from_slice(bytes);
+        names.push(0);
+    }
+
+    let c_regions = regions
+        .iter()
+        .zip(offsets)
+        .map(|((_, start, end), offset)| faidx_region_t {
+            name: offset.map_or(std::ptr::null(), |o| unsafe {
+                names.as_ptr().add(o) as *const c_char
+            }),
+            beg: *start,
+            end: *end,
+        })
+        .collect();
+    (names, c_regions)
+}
+
 /// Shared FASTA index metadata
 ///
 /// This structure holds the shared metadata for a FASTA/FASTQ file that can be
@@ -112,16 +476,256 @@ impl FastaIndex {
     /// # Returns
     ///
     /// A new `FastaIndex` instance or an error if the file cannot be loaded
+    ///
+    /// A missing `.fai` (and, for BGZF files, `.gzi`) is built next to the
+    /// file first, as with [`FastaIndex::build_index`].
     pub fn new(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, FAI_CREATE as c_int)
+    }
+
+    /// Build the `.fai` index for a FASTA/FASTQ file, plus the `.gzi` block
+    /// index for a BGZF file that has none
+    ///
+    /// BGZF and uncompressed files are decompressed and scanned in parallel
+    /// chunks; plain gzip files can only be scanned from the start.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    /// * `threads` - Number of worker threads (0 uses every online CPU)
+    pub fn build_index(path: &str, format: FastaFormat, threads: usize) -> FastaResult<()> {
+        let c_path = CString::new(path).map_err(|_| FastaError::InvalidPath(path.to_string()))?;
+
+        let threads = c_int::try_from(threads).unwrap_or(c_int::MAX);
+        let ret = unsafe { faidx_build_index(c_path.as_ptr(), format.into(), threads) };
+        if ret < 0 {
+            return Err(FastaError::IndexLoadError(format!(
+                "{}: failed to build index",
+                path
+            )));
+        }
+        Ok(())
+    }
+
+    /// Convert a FASTA/FASTQ file to BGZF and write its `.fai` and `.gzi`
+    ///
+    /// The input (plain or gzip) is read once: records are rewritten with
+    /// uniform line width while the output blocks are deflated on worker
+    /// threads, and both indexes come out of the same pass. FASTQ records
+    /// are written as four lines. Replaces `bgzip` followed by
+    /// `samtools faidx`.
+    ///
+    /// # Arguments
+    ///
+    /// * `input` - Path to the FASTA/FASTQ file
+    /// * `output` - Path of the BGZF file to write
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    /// * `options` - Threads, level, line width and block alignment
+    pub fn compress(
+        input: &str,
+        output: &str,
+        format: FastaFormat,
+        options: &CompressOptions,
+    ) -> FastaResult<()> {
+        let c_input =
+            CString::new(input).map_err(|_| FastaError::InvalidPath(input.to_string()))?;
+        let c_output =
+            CString::new(output).map_err(|_| FastaError::InvalidPath(output.to_string()))?;
+
+        let opts = faidx_compress_opts_t {
+            n_threads: c_int::try_from(options.threads).unwrap_or(c_int::MAX),
+            level: c_int::try_from(options.level).unwrap_or(c_int::MAX),
+            line_width: c_int::try_from(options.line_width).unwrap_or(c_int::MAX),
+            align_records: options.align_records as c_int,
+        };
+        let ret =
+            unsafe { faidx_compress(c_input.as_ptr(), c_output.as_ptr(), format.into(), &opts) };
+        if ret < 0 {
+            return Err(FastaError::IoError(format!(
+                "{}: failed to compress to {}",
+                input, output
+            )));
+        }
+        Ok(())
+    }
+
+    /// Create a new FASTA index that memory-maps the file
+    ///
+    /// Uncompressed files are mapped once and every reader created from this
+    /// index fetches straight from the shared mapping, so creating a reader
+    /// opens no file and all threads share the page cache. Compressed files
+    /// are loaded exactly as with [`FastaIndex::new`], and a missing index is
+    /// built the same way.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    pub fn new_mmap(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, (FAI_CREATE | FAI_MMAP) as c_int)
+    }
+
+    /// Create a new FASTA index from the binary `.fai.bin` sidecar
+    ///
+    /// The sidecar holds the index entries, names, hash table and (for BGZF
+    /// files) block table in a layout that is mapped read-only and used in
+    /// place, so loading costs one `mmap` however many sequences there are,
+    /// and processes opening the same file share its pages. A missing or
+    /// stale sidecar (the sequence file changed since it was written) is
+    /// ignored: the text index is loaded, or built, as with
+    /// [`FastaIndex::new`], and a fresh sidecar is written next to it.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    pub fn new_binary(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, (FAI_CREATE | FAI_BIN) as c_int)
+    }
+
+    /// Create a new FASTA index that pages its tables in on demand
+    ///
+    /// For files with millions of records. Like [`FastaIndex::new_binary`],
+    /// but the sidecar is not checked entry by entry on load, and the kernel
+    /// is told not to read ahead in it, so startup is one `mmap` and resident
+    /// memory grows only with the names and entries fetches actually touch.
+    /// When the sidecar is missing or stale, the text index is parsed once to
+    /// write it and is then dropped for the mapping, so [`FastaIndex::is_binary`]
+    /// holds after any successful load of a local file. Sequence order, as
+    /// seen by [`FastaIndex::sequence_name`], is that of the `.fai`.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    pub fn new_lazy(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, (FAI_CREATE | FAI_LAZY) as c_int)
+    }
+
+    /// Write the `.fai.bin` sidecar for this index, replacing any existing one
+    pub fn write_binary_index(&self) -> FastaResult<()> {
+        if unsafe { faidx_meta_write_bin(self.meta) } < 0 {
+            return Err(FastaError::IndexLoadError(
+                "failed to write binary index".to_string(),
+            ));
+        }
+        Ok(())
+    }
+
+    /// Create a new FASTA index that keeps every sequence packed in memory
+    ///
+    /// Each sequence is decoded once at load time into 2 bits per base, with
+    /// side tables for other characters (such as `N` runs) and soft-masked
+    /// (lowercase) intervals, typically a quarter of the size of the text.
+    /// Readers then unpack sequence fetches from memory with no I/O, and
+    /// readers of a FASTA file open no file at all. FASTQ qualities are still
+    /// read from the file.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    pub fn new_packed(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, (FAI_CREATE | FAI_PACK) as c_int)
+    }
+
+    /// Create a new FASTA index laid out for large multi-socket machines
+    ///
+    /// The name index, GZI table and packed sequences are backed by huge
+    /// pages where the kernel allows it, and on a machine with several NUMA
+    /// nodes each node gets its own copy of the name index and GZI table and
+    /// its own block cache. A reader uses the copies of the node it was
+    /// created on, so readers should be created on the thread that uses them.
+    ///
+    /// # Arguments
+    ///
+    /// * `path` - Path to the FASTA/FASTQ file
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    pub fn new_numa(path: &str, format: FastaFormat) -> FastaResult<Self> {
+        Self::load(path, format, (FAI_CREATE | FAI_NUMA | FAI_HUGE) as c_int)
+    }
+
+    /// Get the number of NUMA nodes with their own copy of the tables
+    ///
+    /// Returns 0 when the tables are not replicated, as on single-node
+    /// machines or for indexes not loaded with [`FastaIndex::new_numa`].
+    pub fn numa_nodes(&self) -> usize {
+        unsafe { faidx_meta_numa_nodes(self.meta) as usize }
+    }
+
+    /// Check every sequence's lines against the line lengths in its `.fai`
+    ///
+    /// A `.fai` records one line length per sequence, so a sequence with
+    /// ragged lines (as left by hand-edited or concatenated files) is only
+    /// read correctly through a table of where its lines fall. This reads
+    /// the whole file once and builds those tables; afterwards fetches of
+    /// regular sequences copy line by line without looking at terminators,
+    /// and irregular ones go straight to their table. Without a check, the
+    /// first fetch of a sequence looks for its last base where the `.fai`
+    /// puts it and every fetch checks the line ends in what it copies; a
+    /// sequence that fails either is checked then. Ragged lines that add up
+    /// to the `.fai`'s layout can slip past both, so call this for files that
+    /// may have them.
+    ///
+    /// Returns the number of irregular sequences.
+    pub fn verify_layout(&self) -> FastaResult<usize> {
+        let irregular = unsafe { faidx_meta_verify(self.meta) };
+        if irregular < 0 {
+            return Err(FastaError::IoError(
+                "failed to read sequences while checking their lines".to_string(),
+            ));
+        }
+        Ok(irregular as usize)
+    }
+
+    /// Open a remote FASTA/FASTQ file by `http://`, `https://` or `s3://` URL
+    ///
+    /// Only the ranges each fetch needs are downloaded, one request per read;
+    /// the `.fai` (and, for BGZF files, the `.gzi`) must sit next to the file
+    /// on the server, as `<url>.fai` and `<url>.gzi`. `s3://bucket/key` URLs
+    /// are read anonymously from `bucket.s3.amazonaws.com`, or from
+    /// `$AWS_ENDPOINT_URL/bucket/key` when that is set. Plain gzip files
+    /// cannot be read at an offset and are rejected.
+    ///
+    /// With a `cache_dir`, downloaded ranges are kept there in 256 KiB pieces
+    /// and reused by later loads for as long as the remote file's size and
+    /// ETag are unchanged, so a warm cache issues no range requests at all.
+    /// [`FastaIndex::new`] opens URLs the same way, caching in
+    /// `$FAIGZ_CACHE_DIR` when that is set.
+    ///
+    /// # Arguments
+    ///
+    /// * `url` - URL of the FASTA/FASTQ file
+    /// * `cache_dir` - Existing directory for the block cache, if any
+    /// * `format` - Format of the file (FASTA or FASTQ)
+    #[cfg(feature = "remote")]
+    pub fn new_url(url: &str, cache_dir: Option<&str>, format: FastaFormat) -> FastaResult<Self> {
+        let c_url = CString::new(url).map_err(|_| FastaError::InvalidPath(url.to_string()))?;
+        let c_dir = cache_dir
+            .map(|dir| CString::new(dir).map_err(|_| FastaError::InvalidPath(dir.to_string())))
+            .transpose()?;
+
+        let dir_ptr = c_dir.as_ref().map_or(std::ptr::null(), |dir| dir.as_ptr());
+        let meta = unsafe { faidx_meta_load_url(c_url.as_ptr(), dir_ptr, format.into(), 0) };
+        if meta.is_null() {
+            return Err(FastaError::IndexLoadError(format!(
+                "{}: could not read the file, its .fai or its .gzi",
+                url
+            )));
+        }
+
+        Ok(FastaIndex { meta })
+    }
+
+    fn load(path: &str, format: FastaFormat, flags: c_int) -> FastaResult<Self> {
         let c_path = CString::new(path).map_err(|_| FastaError::InvalidPath(path.to_string()))?;
 
-        // Pass 0 (no flags) to only load existing index, never create
-        // This prevents trying to create index by reading bgzip files as plain text
-        let meta = unsafe { faidx_meta_load(c_path.as_ptr(), format.into(), 0) };
+        let meta = unsafe { faidx_meta_load(c_path.as_ptr(), format.into(), flags) };
 
         if meta.is_null() {
             return Err(FastaError::IndexLoadError(format!(
-                "{}: Index file not found or failed to load. \
+                "{}: Index file not found and could not be built, or failed to load. \
                 Create index with: samtools faidx {}",
                 path, path
             )));
@@ -130,6 +734,125 @@ impl FastaIndex {
         Ok(FastaIndex { meta })
     }
 
+    /// Check whether the sequence file is memory-mapped
+    pub fn is_mmap(&self) -> bool {
+        unsafe { faidx_meta_is_mmap(self.meta) != 0 }
+    }
+
+    /// Fetch a sequence region without a reader
+    ///
+    /// Unlike [`FastaReader`] fetches, this takes `&self` on the index, which
+    /// is `Sync`: any number of threads may call it on one shared index at
+    /// once. Each call reads with `pread` on a descriptor the index shares
+    /// between all readers, with scratch state that lives for the call only,
+    /// so there is no per-thread reader or file descriptor. BGZF blocks go
+    /// through the shared cache (see [`FastaIndex::set_cache_size`]). Plain
+    /// gzip files cannot be read at an offset and open a stream per call.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    pub fn fetch_seq(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
+        let mut buf = Vec::new();
+        if self.fetch_seq_into(seqname, start, end, &mut buf)? == 0 {
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
+    }
+
+    /// Fetch a region into a caller-owned buffer without a reader
+    ///
+    /// The stateless counterpart of [`FastaReader::fetch_seq_into`]; see
+    /// [`FastaIndex::fetch_seq`].
+    pub fn fetch_seq_into(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        fetch_into(FetchSource::Shared(self.meta), seqname, start, end, 0, buf)
+    }
+
+    /// Fetch one large region, such as a whole chromosome, on several threads
+    ///
+    /// The region is cut into chunks, on BGZF block boundaries for BGZF
+    /// files, and `threads` threads (0 for one per CPU) each inflate and
+    /// de-line chunks straight into their place in the result, so loading a
+    /// chromosome scales with the cores available. Plain gzip files are
+    /// read on one thread. Pass `end = i64::MAX` for the rest of the
+    /// sequence.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    /// * `threads` - Number of threads, 0 for one per CPU
+    pub fn fetch_seq_parallel(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        threads: usize,
+    ) -> FastaResult<String> {
+        let mut buf = Vec::new();
+        if self.fetch_seq_parallel_into(seqname, start, end, threads, &mut buf)? == 0 {
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
+    }
+
+    /// [`FastaIndex::fetch_seq_parallel`] into a caller-owned buffer
+    ///
+    /// The bases are appended to `buf`; returns the number appended.
+    pub fn fetch_seq_parallel_into(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        threads: usize,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        let threads = threads.min(c_int::MAX as usize) as c_int;
+        let source = FetchSource::Parallel(self.meta, threads);
+        fetch_into(source, seqname, start, end, 0, buf)
+    }
+
+    /// Check whether the index was loaded from a `.fai.bin` sidecar
+    pub fn is_binary(&self) -> bool {
+        unsafe { faidx_meta_is_bin(self.meta) != 0 }
+    }
+
+    /// Check whether the sequences are packed in memory
+    pub fn is_packed(&self) -> bool {
+        unsafe { faidx_meta_is_packed(self.meta) != 0 }
+    }
+
+    /// Get the packed bases of a sequence and its length
+    ///
+    /// Base `i` is the 2-bit code (A=0, C=1, G=2, T=3) at bits
+    /// `2 * (i % 32)` of word `i / 32`. Characters other than ACGT read as A
+    /// and case is not recorded. Returns `None` unless the index was created
+    /// with [`FastaIndex::new_packed`] and has the sequence.
+    pub fn packed_sequence(&self, name: &str) -> Option<(&[u64], i64)> {
+        let mut len: hts_pos_t = 0;
+        let words = with_c_name(name, |c_name| unsafe {
+            faidx_meta_packed_seq(self.meta, c_name, &mut len)
+        })?;
+        if words.is_null() {
+            return None;
+        }
+        let n_words = (len as usize + 31) / 32;
+        Some((unsafe { std::slice::from_raw_parts(words, n_words) }, len))
+    }
+
     /// Get the number of sequences in the index
     pub fn num_sequences(&self) -> usize {
         unsafe { faidx_meta_nseq(self.meta) as usize }
@@ -174,6 +897,35 @@ impl FastaIndex {
         }
         names
     }
+
+    /// Set the memory budget of the block cache shared by all readers
+    ///
+    /// Decompressed BGZF blocks that fetches only partly consume are kept so
+    /// overlapping regions don't inflate the same block again. A budget of 0
+    /// (the default) disables the cache. This can be changed while readers
+    /// are in use and has no effect on uncompressed files.
+    pub fn set_cache_size(&self, bytes: usize) {
+        unsafe {
+            faidx_meta_set_cache_size(self.meta, bytes);
+        }
+    }
+
+    /// Get the counters of the shared block cache
+    pub fn cache_stats(&self) -> CacheStats {
+        let mut stats: faidx_cache_stats_t = unsafe { std::mem::zeroed() };
+        unsafe { faidx_meta_cache_stats(self.meta, &mut stats) };
+        stats.into()
+    }
+
+    /// Get the fetch statistics of every reader created from this index
+    ///
+    /// Readers that are still fetching contribute what they have counted so
+    /// far, so this may be called from a monitoring thread at any time.
+    pub fn stats(&self) -> FetchStats {
+        let mut stats: Box<faidx_stats_t> = Box::new(unsafe { std::mem::zeroed() });
+        unsafe { faidx_meta_stats(self.meta, &mut *stats) };
+        FetchStats::from(&*stats)
+    }
 }
 
 impl Clone for FastaIndex {
@@ -197,11 +949,14 @@ unsafe impl Sync for FastaIndex {}
 /// FASTA reader for accessing sequences
 ///
 /// This structure provides thread-safe access to FASTA/FASTQ sequences using
-/// a shared index. Each reader maintains its own file handle but shares the
-/// index metadata.
+/// a shared index. Each reader keeps its own buffers and decompression state
+/// but reads through the file descriptor shared by the index (plain gzip
+/// files excepted), so a reader is `Send` but not `Sync`. For fetches from
+/// many threads without a reader each, see [`FastaIndex::fetch_seq`].
 pub struct FastaReader {
     reader: *mut faidx_reader_t,
-    _index: Arc<FastaIndex>, // Keep index alive
+    index: FastaIndex, // Shares the metadata; cloning only bumps its refcount
+    buf: Vec<u8>,      // Reused by fetch_seq_bytes
 }
 
 impl FastaReader {
@@ -223,10 +978,60 @@ impl FastaReader {
 
         Ok(FastaReader {
             reader,
-            _index: Arc::new(index.clone()),
+            index: index.clone(),
+            buf: Vec::new(),
         })
     }
 
+    /// Check whether this reader fetches from a shared memory mapping
+    pub fn is_mmap(&self) -> bool {
+        self.index.is_mmap()
+    }
+
+    /// Give this reader a private block cache with the given budget
+    ///
+    /// A private cache takes precedence over the shared one set with
+    /// [`FastaIndex::set_cache_size`]; a budget of 0 drops it again.
+    pub fn set_cache_size(&self, bytes: usize) -> FastaResult<()> {
+        if unsafe { faidx_reader_set_cache_size(self.reader, bytes) } < 0 {
+            return Err(FastaError::MemoryError);
+        }
+        Ok(())
+    }
+
+    /// Get the counters of the block cache this reader uses
+    pub fn cache_stats(&self) -> CacheStats {
+        let mut stats: faidx_cache_stats_t = unsafe { std::mem::zeroed() };
+        unsafe { faidx_reader_cache_stats(self.reader, &mut stats) };
+        stats.into()
+    }
+
+    /// Get the fetch statistics of this reader
+    pub fn stats(&self) -> FetchStats {
+        let mut stats: Box<faidx_stats_t> = Box::new(unsafe { std::mem::zeroed() });
+        unsafe { faidx_reader_stats(self.reader, &mut *stats) };
+        FetchStats::from(&*stats)
+    }
+
+    /// Set how this reader reads ahead of forward-sequential fetches
+    ///
+    /// Sorted regions and tiling windows keep landing in the next BGZF
+    /// block. With readahead on, a background thread inflates the blocks
+    /// after each fetch so the next one finds them ready; uncompressed files
+    /// get kernel readahead hints instead. The default, [`Readahead::Auto`],
+    /// needs no call at all.
+    pub fn set_readahead(&self, readahead: Readahead) -> FastaResult<()> {
+        let n_blocks = match readahead {
+            Readahead::Auto => -1,
+            Readahead::Off => 0,
+            Readahead::Blocks(n) => n.min(c_int::MAX as usize) as c_int,
+        };
+        if unsafe { faidx_reader_set_readahead(self.reader, n_blocks) } < 0 {
+            return Err(FastaError::MemoryError);
+        }
+        Ok(())
+    }
+
     /// Fetch a sequence from the specified region
     ///
     /// # Arguments
@@ -239,46 +1044,234 @@ impl FastaReader {
     ///
     /// The sequence string or an error if the sequence cannot be fetched
     pub fn fetch_seq(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
-        let c_seqname =
-            CString::new(seqname).map_err(|_| FastaError::SequenceNotFound(seqname.to_string()))?;
-
-        let mut len: i64 = 0;
-        let seq_ptr = unsafe {
-            faidx_reader_fetch_seq(self.reader, c_seqname.as_ptr(), start, end, &mut len)
-        };
-
-        if seq_ptr.is_null() {
+        let mut buf = Vec::new();
+        if fetch_into(
+            FetchSource::Reader(self.reader),
+            seqname,
+            start,
+            end,
+            0,
+            &mut buf,
+        )? == 0
+        {
             return Err(FastaError::SequenceNotFound(seqname.to_string()));
         }
 
-        let c_str = unsafe { CStr::from_ptr(seq_ptr) };
-        let result = c_str.to_string_lossy().to_string();
-
-        unsafe {
-            libc::free(seq_ptr as *mut c_void);
-        }
-
-        Ok(result)
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
     }
 
-    /// Fetch the entire sequence
+    /// Fetch a region into a caller-owned buffer
+    ///
+    /// The bases are appended to `buf` as raw bytes, without UTF-8
+    /// validation. Once `buf` has enough capacity, repeated calls (after
+    /// `buf.clear()`) perform no allocations at all.
     ///
     /// # Arguments
     ///
     /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    /// * `buf` - Buffer the bases are appended to
     ///
     /// # Returns
     ///
-    /// The complete sequence string or an error if the sequence cannot be fetched
-    pub fn fetch_seq_all(&self, seqname: &str) -> FastaResult<String> {
-        let length = self
-            ._index
-            .sequence_length(seqname)
-            .ok_or_else(|| FastaError::SequenceNotFound(seqname.to_string()))?;
+    /// The number of bases appended (0 for an empty region) or an error if
+    /// the sequence cannot be fetched
+    pub fn fetch_seq_into(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        fetch_into(
+            FetchSource::Reader(self.reader),
+            seqname,
+            start,
+            end,
+            0,
+            buf,
+        )
+    }
+
+    /// Fetch a region with its bases transformed on the way out
+    ///
+    /// Reverse complementing and case changes are applied while the bases
+    /// are copied out of the file (with a SIMD kernel where the CPU has
+    /// one), so there is no second pass over the result.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    /// * `transform` - Strand and soft-mask handling
+    pub fn fetch_seq_transformed(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        transform: SeqTransform,
+    ) -> FastaResult<String> {
+        let mut buf = Vec::new();
+        if self.fetch_seq_into_transformed(seqname, start, end, transform, &mut buf)? == 0 {
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
+    }
+
+    /// [`FastaReader::fetch_seq_into`] with the bases transformed on the way out
+    pub fn fetch_seq_into_transformed(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        transform: SeqTransform,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        fetch_into(
+            FetchSource::Reader(self.reader),
+            seqname,
+            start,
+            end,
+            transform.flags(),
+            buf,
+        )
+    }
+
+    /// Fetch a region into the reader's own reusable buffer
+    ///
+    /// Like [`FastaReader::fetch_seq_into`], but the bases borrow from a
+    /// buffer owned by the reader and are valid until the next call.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    pub fn fetch_seq_bytes(&mut self, seqname: &str, start: i64, end: i64) -> FastaResult<&[u8]> {
+        self.buf.clear();
+        fetch_into(
+            FetchSource::Reader(self.reader),
+            seqname,
+            start,
+            end,
+            0,
+            &mut self.buf,
+        )?;
+        Ok(&self.buf)
+    }
+
+    /// Fetch the entire sequence
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    ///
+    /// # Returns
+    ///
+    /// The complete sequence string or an error if the sequence cannot be fetched
+    pub fn fetch_seq_all(&self, seqname: &str) -> FastaResult<String> {
+        let length = self
+            .index
+            .sequence_length(seqname)
+            .ok_or_else(|| FastaError::SequenceNotFound(seqname.to_string()))?;
 
         self.fetch_seq(seqname, 0, length)
     }
 
+    /// Fetch many regions in one pass
+    ///
+    /// The regions are read in file order, with overlapping or adjacent
+    /// regions sharing a single read, so each compressed block is
+    /// decompressed once rather than once per region. This is much faster
+    /// than calling [`FastaReader::fetch_seq`] in a loop for large BED-style
+    /// batches.
+    ///
+    /// # Arguments
+    ///
+    /// * `regions` - `(seqname, start, end)` triples, 0-based half-open
+    ///
+    /// # Returns
+    ///
+    /// One result per region, in input order. Empty regions yield an empty
+    /// string; unknown sequences yield `SequenceNotFound`.
+    pub fn fetch_batch<S: AsRef<str>>(
+        &self,
+        regions: &[(S, i64, i64)],
+    ) -> Vec<FastaResult<String>> {
+        let (_names, c_regions) = batch_regions(regions);
+
+        let mut seqs: Vec<*mut c_char> = vec![std::ptr::null_mut(); regions.len()];
+        let mut lens: Vec<i64> = vec![-1; regions.len()];
+        let fetched = unsafe {
+            faidx_reader_fetch_batch(
+                self.reader,
+                c_regions.as_ptr(),
+                c_regions.len(),
+                seqs.as_mut_ptr(),
+                lens.as_mut_ptr(),
+            )
+        };
+        if fetched < 0 {
+            return regions
+                .iter()
+                .map(|_| Err(FastaError::MemoryError))
+                .collect();
+        }
+
+        regions
+            .iter()
+            .zip(seqs.into_iter().zip(lens))
+            .map(|((name, _, _), (seq, len))| {
+                if seq.is_null() {
+                    return Err(FastaError::SequenceNotFound(name.as_ref().to_string()));
+                }
+
+                let bytes = unsafe { std::slice::from_raw_parts(seq as *const u8, len as usize) };
+                let result = String::from_utf8_lossy(bytes).into_owned();
+                unsafe {
+                    libc::free(seq as *mut c_void);
+                }
+                Ok(result)
+            })
+            .collect()
+    }
+
+    /// Fetch many regions into one reusable buffer
+    ///
+    /// Like [`FastaReader::fetch_batch`], but every region's bases are
+    /// written back to back into `buf` instead of one `String` each. The
+    /// buffer keeps its memory between batches, so once it is large enough a
+    /// batch allocates only the region list handed to C.
+    ///
+    /// # Returns
+    ///
+    /// A view of the results, borrowed from `buf`, with one entry per region
+    /// in input order.
+    pub fn fetch_batch_into<'b, S: AsRef<str>>(
+        &self,
+        regions: &[(S, i64, i64)],
+        buf: &'b mut BatchBuffer,
+    ) -> FastaResult<BatchView<'b>> {
+        let (_names, c_regions) = batch_regions(regions);
+        let fetched = unsafe {
+            faidx_reader_fetch_batch_into(
+                self.reader,
+                c_regions.as_ptr(),
+                c_regions.len(),
+                &mut buf.batch,
+            )
+        };
+        if fetched < 0 {
+            return Err(FastaError::MemoryError);
+        }
+        Ok(buf.view())
+    }
+
     /// Fetch quality scores for the specified region (FASTQ only)
     ///
     /// # Arguments
@@ -291,16 +1284,14 @@ impl FastaReader {
     ///
     /// The quality string or an error if the quality cannot be fetched
     pub fn fetch_qual(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
-        let c_seqname =
-            CString::new(seqname).map_err(|_| FastaError::SequenceNotFound(seqname.to_string()))?;
-
         let mut len: i64 = 0;
-        let qual_ptr = unsafe {
-            faidx_reader_fetch_qual(self.reader, c_seqname.as_ptr(), start, end - 1, &mut len)
-        };
+        let qual_ptr = with_c_name(seqname, |c_name| unsafe {
+            faidx_reader_fetch_qual(self.reader, c_name, start, end, &mut len)
+        })
+        .unwrap_or(std::ptr::null_mut());
 
         if qual_ptr.is_null() {
-            return Err(FastaError::QualityNotAvailable);
+            return Err(self.no_quality(seqname));
         }
 
         let c_str = unsafe { CStr::from_ptr(qual_ptr) };
@@ -313,6 +1304,65 @@ impl FastaReader {
         Ok(result)
     }
 
+    /// Fetch the sequence and quality scores of a region together (FASTQ only)
+    ///
+    /// In FASTQ the quality string directly follows the sequence, so both
+    /// are read in a single pass.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    ///
+    /// # Returns
+    ///
+    /// The `(sequence, quality)` pair or an error if they cannot be fetched
+    pub fn fetch_seq_qual(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+    ) -> FastaResult<(String, String)> {
+        let mut seq_ptr: *mut c_char = std::ptr::null_mut();
+        let mut qual_ptr: *mut c_char = std::ptr::null_mut();
+        let mut len: i64 = 0;
+        let ret = with_c_name(seqname, |c_name| unsafe {
+            faidx_reader_fetch_seq_qual(
+                self.reader,
+                c_name,
+                start,
+                end,
+                &mut seq_ptr,
+                &mut qual_ptr,
+                &mut len,
+            )
+        })
+        .unwrap_or(-1);
+
+        if ret < 0 {
+            return Err(self.no_quality(seqname));
+        }
+
+        let take = |ptr: *mut c_char| {
+            let s = unsafe { CStr::from_ptr(ptr) }
+                .to_string_lossy()
+                .into_owned();
+            unsafe { libc::free(ptr as *mut c_void) };
+            s
+        };
+        Ok((take(seq_ptr), take(qual_ptr)))
+    }
+
+    /// Error for a failed quality fetch
+    fn no_quality(&self, seqname: &str) -> FastaError {
+        if self.index.has_sequence(seqname) {
+            FastaError::QualityNotAvailable
+        } else {
+            FastaError::SequenceNotFound(seqname.to_string())
+        }
+    }
+
     /// Parse a region string (e.g., "chr1:1000-2000") and fetch the sequence
     ///
     /// # Arguments
@@ -349,6 +1399,35 @@ impl FastaReader {
             self.fetch_seq_all(region)
         }
     }
+
+    /// Walk every record front to back in chunks of at most `chunk_size` bases
+    ///
+    /// This suits whole-genome passes such as k-mer counting: instead of
+    /// allocating each chromosome with [`FastaReader::fetch_seq_all`], the
+    /// file is read in order into a fixed set of buffers. With `threads > 0`
+    /// that many background threads read and inflate up to two chunks each
+    /// ahead of the consumer; with 0 each chunk is read on the calling
+    /// thread. Memory stays near `2 * threads * chunk_size` however long the
+    /// records are.
+    ///
+    /// # Arguments
+    ///
+    /// * `chunk_size` - Maximum bases per chunk; chunks never span records
+    /// * `threads` - Number of read-ahead threads
+    pub fn chunks(&self, chunk_size: usize, threads: usize) -> FastaResult<SequenceChunks> {
+        if chunk_size == 0 {
+            return Err(FastaError::InvalidRegion("chunk size 0".to_string()));
+        }
+        let threads = c_int::try_from(threads).map_err(|_| FastaError::ReaderCreationError)?;
+        let stream = unsafe { faidx_stream_create(self.index.meta, chunk_size, threads) };
+        if stream.is_null() {
+            return Err(FastaError::ReaderCreationError);
+        }
+        Ok(SequenceChunks {
+            stream,
+            record: Vec::new(),
+        })
+    }
 }
 
 impl Drop for FastaReader {
@@ -361,6 +1440,887 @@ impl Drop for FastaReader {
 
 unsafe impl Send for FastaReader {}
 
+/// Many FASTA/FASTQ files behind one name index
+///
+/// For references spread over many files, such as one assembly per file in
+/// a pangenome, a collection finds the file holding a sequence with one
+/// lookup in a table merged from every file's index, instead of asking each
+/// [`FastaIndex`] in turn. A name present in several files resolves to the
+/// first. File descriptors are opened on the first read from each file and
+/// shared by all readers; only the most recently used are kept open (see
+/// [`FastaCollection::set_max_open_files`]). Like [`FastaIndex`], a
+/// collection is `Sync` and cloning it only bumps a refcount.
+pub struct FastaCollection {
+    coll: *mut faidx_coll_t,
+}
+
+impl std::fmt::Debug for FastaCollection {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("FastaCollection")
+            .field("num_files", &self.num_files())
+            .field("num_sequences", &self.num_sequences())
+            .finish()
+    }
+}
+
+impl FastaCollection {
+    /// Load a collection from the given files
+    ///
+    /// Each file is loaded as with [`FastaIndex::new`], so missing indexes
+    /// are built first.
+    ///
+    /// # Arguments
+    ///
+    /// * `paths` - Paths to the FASTA/FASTQ files
+    /// * `format` - Format of the files (FASTA or FASTQ)
+    pub fn new<P: AsRef<str>>(paths: &[P], format: FastaFormat) -> FastaResult<Self> {
+        let c_paths = paths
+            .iter()
+            .map(|p| {
+                let p = p.as_ref();
+                CString::new(p).map_err(|_| FastaError::InvalidPath(p.to_string()))
+            })
+            .collect::<FastaResult<Vec<_>>>()?;
+        let ptrs: Vec<*const c_char> = c_paths.iter().map(|p| p.as_ptr()).collect();
+        let n = c_int::try_from(ptrs.len()).map_err(|_| FastaError::MemoryError)?;
+
+        let coll = unsafe { faidx_coll_load(ptrs.as_ptr(), n, format.into(), FAI_CREATE as c_int) };
+        if coll.is_null() {
+            return Err(FastaError::IndexLoadError(format!(
+                "failed to load a collection of {} files",
+                paths.len()
+            )));
+        }
+
+        Ok(FastaCollection { coll })
+    }
+
+    /// Set how many file descriptors the collection keeps open at most
+    ///
+    /// When a file has to be opened and the limit is reached, the least
+    /// recently read idle file is closed first. Files being read at that
+    /// moment are never closed, so many threads can briefly exceed it.
+    pub fn set_max_open_files(&self, max_open: usize) {
+        let max_open = c_int::try_from(max_open.max(1)).unwrap_or(c_int::MAX);
+        unsafe {
+            faidx_coll_set_max_open(self.coll, max_open);
+        }
+    }
+
+    /// Get the number of file descriptors currently open
+    pub fn open_files(&self) -> usize {
+        unsafe { faidx_coll_open_files(self.coll) as usize }
+    }
+
+    /// Get the number of files in the collection
+    pub fn num_files(&self) -> usize {
+        unsafe { faidx_coll_nfiles(self.coll) as usize }
+    }
+
+    /// Get the index of one file of the collection
+    ///
+    /// The index shares the collection's metadata and descriptors and stays
+    /// valid after the collection is dropped.
+    pub fn index(&self, file: usize) -> Option<FastaIndex> {
+        let file = c_int::try_from(file).ok()?;
+        let meta = unsafe { faidx_coll_meta(self.coll, file) };
+        if meta.is_null() {
+            return None;
+        }
+        Some(FastaIndex {
+            meta: unsafe { faidx_meta_ref(meta) },
+        })
+    }
+
+    /// Get the file holding a sequence
+    pub fn file_of(&self, name: &str) -> Option<usize> {
+        let file = with_c_name(name, |c_name| unsafe {
+            faidx_coll_file_of(self.coll, c_name)
+        })?;
+        usize::try_from(file).ok()
+    }
+
+    /// Get the number of sequences in all files
+    pub fn num_sequences(&self) -> usize {
+        unsafe { faidx_coll_nseq(self.coll) as usize }
+    }
+
+    /// Get the name of the sequence at the given index, counting through the
+    /// files in order
+    pub fn sequence_name(&self, index: usize) -> Option<String> {
+        let index = c_int::try_from(index).ok()?;
+        let name_ptr = unsafe { faidx_coll_iseq(self.coll, index) };
+        if name_ptr.is_null() {
+            None
+        } else {
+            let c_str = unsafe { CStr::from_ptr(name_ptr) };
+            Some(c_str.to_string_lossy().to_string())
+        }
+    }
+
+    /// Get the length of the specified sequence
+    pub fn sequence_length(&self, name: &str) -> Option<i64> {
+        let length = with_c_name(name, |c_name| unsafe {
+            faidx_coll_seq_len(self.coll, c_name)
+        })?;
+        if length < 0 {
+            None
+        } else {
+            Some(length)
+        }
+    }
+
+    /// Check if any file of the collection contains the specified sequence
+    pub fn has_sequence(&self, name: &str) -> bool {
+        self.file_of(name).is_some()
+    }
+
+    /// Fetch a sequence region without a reader
+    ///
+    /// The collection counterpart of [`FastaIndex::fetch_seq`], safe to call
+    /// from many threads on one shared collection.
+    pub fn fetch_seq(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
+        let mut buf = Vec::new();
+        if self.fetch_seq_into(seqname, start, end, &mut buf)? == 0 {
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
+    }
+
+    /// Fetch a region into a caller-owned buffer without a reader
+    pub fn fetch_seq_into(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        fetch_into(
+            FetchSource::Collection(self.coll),
+            seqname,
+            start,
+            end,
+            0,
+            buf,
+        )
+    }
+}
+
+impl Clone for FastaCollection {
+    fn clone(&self) -> Self {
+        let coll = unsafe { faidx_coll_ref(self.coll) };
+        FastaCollection { coll }
+    }
+}
+
+impl Drop for FastaCollection {
+    fn drop(&mut self) {
+        unsafe {
+            faidx_coll_destroy(self.coll);
+        }
+    }
+}
+
+unsafe impl Send for FastaCollection {}
+unsafe impl Sync for FastaCollection {}
+
+/// Reader over a [`FastaCollection`]
+///
+/// Holds one [`FastaReader`]-like reader per file, created the first time
+/// one of the file's sequences is fetched; only the 16 most recently used
+/// are kept, so memory stays bounded however many files there are. Like a
+/// [`FastaReader`], it is `Send` but not `Sync`.
+pub struct CollectionReader {
+    reader: *mut faidx_coll_reader_t,
+    collection: FastaCollection,
+}
+
+impl CollectionReader {
+    /// Create a new reader over a collection
+    pub fn new(collection: &FastaCollection) -> FastaResult<Self> {
+        let reader = unsafe { faidx_coll_reader_create(collection.coll) };
+        if reader.is_null() {
+            return Err(FastaError::ReaderCreationError);
+        }
+
+        Ok(CollectionReader {
+            reader,
+            collection: collection.clone(),
+        })
+    }
+
+    /// Fetch a sequence from the specified region
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence, in any file of the collection
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    pub fn fetch_seq(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
+        let mut buf = Vec::new();
+        if self.fetch_seq_into(seqname, start, end, &mut buf)? == 0 {
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+
+        Ok(String::from_utf8(buf)
+            .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned()))
+    }
+
+    /// Fetch a region into a caller-owned buffer; see
+    /// [`FastaReader::fetch_seq_into`]
+    pub fn fetch_seq_into(
+        &self,
+        seqname: &str,
+        start: i64,
+        end: i64,
+        buf: &mut Vec<u8>,
+    ) -> FastaResult<usize> {
+        fetch_into(
+            FetchSource::CollectionReader(self.reader),
+            seqname,
+            start,
+            end,
+            0,
+            buf,
+        )
+    }
+
+    /// Fetch quality scores for the specified region (FASTQ only)
+    pub fn fetch_qual(&self, seqname: &str, start: i64, end: i64) -> FastaResult<String> {
+        let mut len: i64 = 0;
+        let qual_ptr = with_c_name(seqname, |c_name| unsafe {
+            faidx_coll_reader_fetch_qual(self.reader, c_name, start, end, &mut len)
+        })
+        .unwrap_or(std::ptr::null_mut());
+
+        if qual_ptr.is_null() {
+            return Err(if self.collection.has_sequence(seqname) {
+                FastaError::QualityNotAvailable
+            } else {
+                FastaError::SequenceNotFound(seqname.to_string())
+            });
+        }
+
+        let c_str = unsafe { CStr::from_ptr(qual_ptr) };
+        let result = c_str.to_string_lossy().to_string();
+        unsafe {
+            libc::free(qual_ptr as *mut c_void);
+        }
+        Ok(result)
+    }
+}
+
+impl Drop for CollectionReader {
+    fn drop(&mut self) {
+        unsafe {
+            faidx_coll_reader_destroy(self.reader);
+        }
+    }
+}
+
+unsafe impl Send for CollectionReader {}
+
+/// Pool of reusable readers over one index
+///
+/// Creating a [`FastaReader`] allocates its buffers and decoder state, which
+/// shows up when many short tasks (for example rayon jobs) each need one. A
+/// pool keeps readers that are handed back and reuses them, buffers and
+/// decoder state included, so a task only pays for creation when every
+/// pooled reader is in use. The pool is `Sync` and can
+/// be shared by reference or through an `Arc`.
+///
+/// A pooled reader keeps its state between tasks, including any private
+/// cache set with [`FastaReader::set_cache_size`].
+pub struct ReaderPool {
+    index: FastaIndex,
+    idle: Mutex<Vec<FastaReader>>,
+}
+
+impl ReaderPool {
+    /// Create an empty pool over an index
+    pub fn new(index: &FastaIndex) -> Self {
+        ReaderPool {
+            index: index.clone(),
+            idle: Mutex::new(Vec::new()),
+        }
+    }
+
+    /// Take a reader from the pool, creating one if none is idle
+    ///
+    /// The reader returns to the pool when the guard is dropped.
+    pub fn get(&self) -> FastaResult<PooledReader<'_>> {
+        let reader = self.idle.lock().unwrap_or_else(|e| e.into_inner()).pop();
+        let reader = match reader {
+            Some(reader) => reader,
+            None => FastaReader::new(&self.index)?,
+        };
+        Ok(PooledReader {
+            pool: self,
+            reader: Some(reader),
+        })
+    }
+
+    /// Run `f` with a pooled reader
+    pub fn with_reader<T>(&self, f: impl FnOnce(&mut FastaReader) -> T) -> FastaResult<T> {
+        let mut reader = self.get()?;
+        Ok(f(&mut reader))
+    }
+
+    /// Number of readers waiting in the pool
+    pub fn idle_readers(&self) -> usize {
+        self.idle.lock().unwrap_or_else(|e| e.into_inner()).len()
+    }
+
+    /// The index the pool's readers fetch from
+    pub fn index(&self) -> &FastaIndex {
+        &self.index
+    }
+}
+
+/// A reader borrowed from a [`ReaderPool`], returned to it on drop
+pub struct PooledReader<'a> {
+    pool: &'a ReaderPool,
+    reader: Option<FastaReader>,
+}
+
+impl Deref for PooledReader<'_> {
+    type Target = FastaReader;
+
+    fn deref(&self) -> &FastaReader {
+        self.reader.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledReader<'_> {
+    fn deref_mut(&mut self) -> &mut FastaReader {
+        self.reader.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledReader<'_> {
+    fn drop(&mut self) {
+        if let Some(reader) = self.reader.take() {
+            self.pool
+                .idle
+                .lock()
+                .unwrap_or_else(|e| e.into_inner())
+                .push(reader);
+        }
+    }
+}
+
+/// Reusable result storage for [`FastaReader::fetch_batch_into`]
+///
+/// Holds the bases of every region of the last batch in one buffer, plus
+/// their offsets and lengths. The buffers only grow, so a buffer reused for
+/// batches of similar size stops allocating after the first.
+pub struct BatchBuffer {
+    batch: faidx_batch_t,
+}
+
+impl BatchBuffer {
+    /// Create an empty buffer; nothing is allocated until the first batch
+    pub fn new() -> Self {
+        BatchBuffer {
+            batch: unsafe { std::mem::zeroed() },
+        }
+    }
+
+    fn view(&self) -> BatchView<'_> {
+        let b = &self.batch;
+        if b.n == 0 {
+            return BatchView {
+                seq: &[],
+                off: &[],
+                len: &[],
+            };
+        }
+        unsafe {
+            BatchView {
+                seq: std::slice::from_raw_parts(b.seq as *const u8, b.seq_len),
+                off: std::slice::from_raw_parts(b.off, b.n),
+                len: std::slice::from_raw_parts(b.len, b.n),
+            }
+        }
+    }
+}
+
+impl Default for BatchBuffer {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Drop for BatchBuffer {
+    fn drop(&mut self) {
+        unsafe {
+            faidx_batch_free(&mut self.batch);
+        }
+    }
+}
+
+unsafe impl Send for BatchBuffer {}
+unsafe impl Sync for BatchBuffer {}
+
+/// Results of a batch, borrowed from the [`BatchBuffer`] they were fetched into
+#[derive(Debug, Clone, Copy)]
+pub struct BatchView<'a> {
+    seq: &'a [u8],
+    off: &'a [usize],
+    len: &'a [i64],
+}
+
+impl<'a> BatchView<'a> {
+    /// Number of regions in the batch
+    pub fn len(&self) -> usize {
+        self.len.len()
+    }
+
+    /// Check whether the batch had no regions
+    pub fn is_empty(&self) -> bool {
+        self.len.is_empty()
+    }
+
+    /// Bases of region `i`, or `None` if its sequence was not found or could
+    /// not be read. Empty regions yield an empty slice.
+    pub fn get(&self, i: usize) -> Option<&'a [u8]> {
+        let len = *self.len.get(i)?;
+        if len < 0 {
+            return None;
+        }
+        let off = self.off[i];
+        Some(&self.seq[off..off + len as usize])
+    }
+
+    /// Bases of every region, in input order, as for [`BatchView::get`]
+    pub fn iter(&self) -> impl Iterator<Item = Option<&'a [u8]>> + '_ {
+        (0..self.len()).map(move |i| self.get(i))
+    }
+}
+
+/// One chunk of a [`SequenceChunks`] walk
+#[derive(Debug)]
+pub struct SequenceChunk<'a> {
+    /// Index of the record, as for [`FastaIndex::sequence_name`]
+    pub seq_index: usize,
+    /// Name of the record
+    pub name: &'a str,
+    /// Offset of the chunk within the record (0-based)
+    pub offset: i64,
+    /// Length of the whole record
+    pub seq_len: i64,
+    /// The chunk's bases
+    pub bases: &'a [u8],
+}
+
+impl SequenceChunk<'_> {
+    /// Check whether this is the last chunk of its record
+    pub fn is_record_end(&self) -> bool {
+        self.offset + self.bases.len() as i64 >= self.seq_len
+    }
+}
+
+/// Streaming walk over all records, created by [`FastaReader::chunks`]
+///
+/// Chunks borrow the walk's buffers, so they are taken one at a time with
+/// [`SequenceChunks::next_chunk`] rather than through `Iterator`. An empty
+/// record yields one empty chunk.
+pub struct SequenceChunks {
+    stream: *mut faidx_stream_t, // Holds its own reference to the metadata
+    record: Vec<u8>,             // Reused by next_record
+}
+
+impl SequenceChunks {
+    fn next_raw(&mut self) -> Option<FastaResult<faidx_stream_chunk_t>> {
+        let mut chunk = std::mem::MaybeUninit::<faidx_stream_chunk_t>::uninit();
+        match unsafe { faidx_stream_next(self.stream, chunk.as_mut_ptr()) } {
+            1 => Some(Ok(unsafe { chunk.assume_init() })),
+            0 => None,
+            _ => Some(Err(FastaError::IoError(
+                "sequence stream read failed".to_string(),
+            ))),
+        }
+    }
+
+    fn name<'a>(chunk: &faidx_stream_chunk_t) -> FastaResult<&'a str> {
+        let name = unsafe { CStr::from_ptr(chunk.name) };
+        name.to_str()
+            .map_err(|_| FastaError::IoError("sequence name is not UTF-8".to_string()))
+    }
+
+    /// Take the next chunk, or `None` once every record has been read
+    ///
+    /// The chunk's bases are valid until the next call.
+    pub fn next_chunk(&mut self) -> Option<FastaResult<SequenceChunk<'_>>> {
+        let chunk = match self.next_raw()? {
+            Ok(chunk) => chunk,
+            Err(e) => return Some(Err(e)),
+        };
+        let bases: &[u8] = if chunk.len > 0 {
+            unsafe { std::slice::from_raw_parts(chunk.bases as *const u8, chunk.len as usize) }
+        } else {
+            &[]
+        };
+        Some(Self::name(&chunk).map(|name| SequenceChunk {
+            seq_index: chunk.seq_id as usize,
+            name,
+            offset: chunk.pos,
+            seq_len: chunk.seq_len,
+            bases,
+        }))
+    }
+
+    /// Take the rest of the current record as one buffer
+    ///
+    /// Convenience for callers that want whole records; the buffer is reused
+    /// between calls but grows to the longest record read, so memory is no
+    /// longer bounded by the chunk size.
+    pub fn next_record(&mut self) -> Option<FastaResult<(&str, &[u8])>> {
+        self.record.clear();
+        loop {
+            let chunk = match self.next_raw()? {
+                Ok(chunk) => chunk,
+                Err(e) => return Some(Err(e)),
+            };
+            if chunk.len > 0 {
+                let bases = unsafe {
+                    std::slice::from_raw_parts(chunk.bases as *const u8, chunk.len as usize)
+                };
+                self.record.extend_from_slice(bases);
+            }
+            if chunk.pos + chunk.len >= chunk.seq_len {
+                return Some(Self::name(&chunk).map(|name| (name, self.record.as_slice())));
+            }
+        }
+    }
+}
+
+impl Drop for SequenceChunks {
+    fn drop(&mut self) {
+        unsafe {
+            faidx_stream_destroy(self.stream);
+        }
+    }
+}
+
+unsafe impl Send for SequenceChunks {}
+
+/// A finished [`AsyncFetcher`] request
+#[derive(Debug)]
+pub struct Completion {
+    /// Tag returned by [`AsyncFetcher::submit`]
+    pub tag: u64,
+    /// The fetched bases
+    pub result: FastaResult<String>,
+}
+
+/// Per-request routing: who is waiting for a tag and what came back
+struct Slot {
+    name: String,
+    claimed: bool, // Awaited by a FetchFuture rather than collected
+    result: Option<FastaResult<String>>,
+    waker: Option<Waker>,
+}
+
+#[derive(Default)]
+struct RouterState {
+    slots: HashMap<u64, Slot>,
+    ready: VecDeque<Completion>, // Unclaimed completions, in finishing order
+    outstanding: usize,          // Unclaimed requests not yet collected
+    stream_waker: Option<Waker>,
+}
+
+/// Receives completions from the engine's workers and hands each one to its
+/// future, or queues it for [`AsyncFetcher::wait_completion`] and the stream
+#[derive(Default)]
+struct Router {
+    engine: AtomicPtr<faidx_async_t>,
+    state: Mutex<RouterState>,
+    ready: Condvar,
+}
+
+impl Router {
+    fn lock(&self) -> MutexGuard<'_, RouterState> {
+        self.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+
+    /// Drain the engine's completion queue
+    fn drain(&self) {
+        let engine = self.engine.load(Ordering::Acquire);
+        if engine.is_null() {
+            return;
+        }
+
+        let mut out = [faidx_completion_t {
+            tag: 0,
+            seq: std::ptr::null_mut(),
+            len: 0,
+        }; 64];
+        loop {
+            let n = unsafe { faidx_async_poll(engine, out.as_mut_ptr(), out.len()) };
+            if n == 0 {
+                return;
+            }
+
+            let mut wakers = Vec::new();
+            let mut state = self.lock();
+            for c in &out[..n] {
+                let bases = (!c.seq.is_null()).then(|| unsafe {
+                    let bytes = std::slice::from_raw_parts(c.seq as *const u8, c.len as usize);
+                    let bases = String::from_utf8_lossy(bytes).into_owned();
+                    libc::free(c.seq as *mut c_void);
+                    bases
+                });
+
+                // A slot is gone once its future was dropped: discard the result
+                let Some(slot) = state.slots.get_mut(&c.tag) else {
+                    continue;
+                };
+                let result = bases.ok_or_else(|| FastaError::SequenceNotFound(slot.name.clone()));
+                if slot.claimed {
+                    slot.result = Some(result);
+                    wakers.extend(slot.waker.take());
+                } else {
+                    state.slots.remove(&c.tag);
+                    state.ready.push_back(Completion { tag: c.tag, result });
+                    wakers.extend(state.stream_waker.take());
+                }
+            }
+            drop(state);
+            self.ready.notify_all();
+            wakers.into_iter().for_each(Waker::wake);
+        }
+    }
+}
+
+unsafe extern "C" fn router_notify(data: *mut c_void) {
+    let router = &*(data as *const Router);
+    // Never unwind into the C worker thread
+    let _ = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| router.drain()));
+}
+
+/// Asynchronous region fetches, for keeping many reads in flight
+///
+/// Requests are queued without blocking and fetched by a pool of worker
+/// threads, each with its own reader over the index's shared descriptor, so
+/// reads and BGZF decompression run on the workers and up to `threads`
+/// reads are outstanding at once. Each request either resolves its own
+/// future ([`AsyncFetcher::fetch`]) or is collected, in the order requests
+/// finish, with [`AsyncFetcher::wait_completion`], [`AsyncFetcher::try_completion`]
+/// or (with the `async` feature) the [`AsyncFetcher::completions`] stream.
+///
+/// The futures need no particular runtime: they are woken from the worker
+/// threads, so they run under tokio or any other executor.
+pub struct AsyncFetcher {
+    engine: *mut faidx_async_t,
+    router: Box<Router>,
+    next_tag: AtomicU64,
+}
+
+impl AsyncFetcher {
+    /// Start an engine over an index with `threads` workers (0 uses every CPU)
+    pub fn new(index: &FastaIndex, threads: usize) -> FastaResult<Self> {
+        let router = Box::<Router>::default();
+        let threads = c_int::try_from(threads).unwrap_or(c_int::MAX);
+        let engine = unsafe {
+            faidx_async_create(
+                index.meta,
+                threads,
+                Some(router_notify),
+                &*router as *const Router as *mut c_void,
+            )
+        };
+        if engine.is_null() {
+            return Err(FastaError::ReaderCreationError);
+        }
+        router.engine.store(engine, Ordering::Release);
+
+        Ok(AsyncFetcher {
+            engine,
+            router,
+            next_tag: AtomicU64::new(0),
+        })
+    }
+
+    fn submit_slot(&self, seqname: &str, start: i64, end: i64, claimed: bool) -> FastaResult<u64> {
+        let tag = self.next_tag.fetch_add(1, Ordering::Relaxed);
+        let slot = Slot {
+            name: seqname.to_string(),
+            claimed,
+            result: None,
+            waker: None,
+        };
+
+        // The slot must exist before the request can complete
+        {
+            let mut state = self.router.lock();
+            state.slots.insert(tag, slot);
+            if !claimed {
+                state.outstanding += 1;
+            }
+        }
+
+        let ret = with_c_name(seqname, |c_name| unsafe {
+            faidx_async_submit(self.engine, c_name, start, end, tag)
+        });
+        if ret != Some(0) {
+            let mut state = self.router.lock();
+            state.slots.remove(&tag);
+            if !claimed {
+                state.outstanding -= 1;
+            }
+            return Err(FastaError::SequenceNotFound(seqname.to_string()));
+        }
+        Ok(tag)
+    }
+
+    /// Queue a region and return its tag
+    ///
+    /// The result arrives as a [`Completion`] carrying that tag.
+    ///
+    /// # Arguments
+    ///
+    /// * `seqname` - Name of the sequence
+    /// * `start` - Start position (0-based, inclusive)
+    /// * `end` - End position (0-based, exclusive)
+    pub fn submit(&self, seqname: &str, start: i64, end: i64) -> FastaResult<u64> {
+        self.submit_slot(seqname, start, end, false)
+    }
+
+    /// Queue a region and return a future for its bases
+    ///
+    /// The request is submitted immediately, so calling `fetch` many times
+    /// before awaiting keeps all of them in flight. Dropping the future
+    /// discards the result.
+    pub fn fetch(&self, seqname: &str, start: i64, end: i64) -> FetchFuture<'_> {
+        let (tag, error) = match self.submit_slot(seqname, start, end, true) {
+            Ok(tag) => (Some(tag), None),
+            Err(e) => (None, Some(e)),
+        };
+        FetchFuture {
+            fetcher: self,
+            tag,
+            error,
+        }
+    }
+
+    fn take_completion(&self, state: &mut RouterState) -> Option<Completion> {
+        let completion = state.ready.pop_front()?;
+        state.outstanding -= 1;
+        Some(completion)
+    }
+
+    /// Take a finished [`AsyncFetcher::submit`] request, if there is one
+    pub fn try_completion(&self) -> Option<Completion> {
+        self.take_completion(&mut self.router.lock())
+    }
+
+    /// Block until a submitted request finishes
+    ///
+    /// Returns `None` once every submitted request has been collected.
+    pub fn wait_completion(&self) -> Option<Completion> {
+        let mut state = self.router.lock();
+        loop {
+            if let Some(completion) = self.take_completion(&mut state) {
+                return Some(completion);
+            }
+            if state.outstanding == 0 {
+                return None;
+            }
+            state = self
+                .router
+                .ready
+                .wait(state)
+                .unwrap_or_else(|e| e.into_inner());
+        }
+    }
+
+    /// Number of [`AsyncFetcher::submit`] requests not yet collected
+    pub fn outstanding(&self) -> usize {
+        self.router.lock().outstanding
+    }
+
+    /// Stream of finished [`AsyncFetcher::submit`] requests
+    ///
+    /// The stream ends once every submitted request has been collected.
+    #[cfg(feature = "async")]
+    pub fn completions(&self) -> Completions<'_> {
+        Completions { fetcher: self }
+    }
+}
+
+impl Drop for AsyncFetcher {
+    fn drop(&mut self) {
+        // Joins the workers, so no notification can reach the router after
+        unsafe { faidx_async_destroy(self.engine) };
+    }
+}
+
+unsafe impl Send for AsyncFetcher {}
+unsafe impl Sync for AsyncFetcher {}
+
+/// Future returned by [`AsyncFetcher::fetch`]
+pub struct FetchFuture<'a> {
+    fetcher: &'a AsyncFetcher,
+    tag: Option<u64>,          // None once the result has been returned
+    error: Option<FastaError>, // The request could not be submitted
+}
+
+impl Future for FetchFuture<'_> {
+    type Output = FastaResult<String>;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        if let Some(e) = self.error.take() {
+            return Poll::Ready(Err(e));
+        }
+        let tag = self.tag.expect("FetchFuture polled after completion");
+
+        let mut state = self.fetcher.router.lock();
+        let slot = state.slots.get_mut(&tag).unwrap();
+        if slot.result.is_none() {
+            slot.waker = Some(cx.waker().clone());
+            return Poll::Pending;
+        }
+        let result = state.slots.remove(&tag).unwrap().result.unwrap();
+        drop(state);
+        self.tag = None;
+        Poll::Ready(result)
+    }
+}
+
+impl Drop for FetchFuture<'_> {
+    fn drop(&mut self) {
+        if let Some(tag) = self.tag {
+            self.fetcher.router.lock().slots.remove(&tag);
+        }
+    }
+}
+
+/// Stream returned by [`AsyncFetcher::completions`]
+#[cfg(feature = "async")]
+pub struct Completions<'a> {
+    fetcher: &'a AsyncFetcher,
+}
+
+#[cfg(feature = "async")]
+impl futures_core::Stream for Completions<'_> {
+    type Item = Completion;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Completion>> {
+        let mut state = self.fetcher.router.lock();
+        if let Some(completion) = self.fetcher.take_completion(&mut state) {
+            return Poll::Ready(Some(completion));
+        }
+        if state.outstanding == 0 {
+            return Poll::Ready(None);
+        }
+        state.stream_waker = Some(cx.waker().clone());
+        Poll::Pending
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
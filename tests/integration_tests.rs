@@ -1,4 +1,7 @@
-use faigz_rs::{FastaError, FastaFormat, FastaIndex, FastaReader};
+use faigz_rs::{
+    AsyncFetcher, BatchBuffer, CollectionReader, CompressOptions, FastaCollection, FastaError,
+    FastaFormat, FastaIndex, FastaReader, Readahead, SeqTransform, SoftMask,
+};
 use std::io::Write;
 use std::sync::Arc;
 use std::thread;
@@ -141,19 +144,29 @@ fn test_fastq_support() {
     let index = FastaIndex::new(path, FastaFormat::Fastq).unwrap();
     let reader = FastaReader::new(&index).unwrap();
 
-    // Test quality score fetching (currently not supported in minimal implementation)
-    let qual_result = reader.fetch_qual("seq1", 0, 10);
-    // Our minimal implementation doesn't support quality string fetching yet
-    match qual_result {
-        Err(FastaError::QualityNotAvailable) => {
-            println!("Quality string fetching not supported (as expected)");
-        }
-        Ok(qual) => {
-            println!("Fetched quality scores: {}", qual);
-            assert!(!qual.is_empty());
-        }
-        Err(e) => panic!("Unexpected error: {}", e),
-    }
+    // Quality scores cover the same region as the bases
+    assert_eq!(reader.fetch_qual("seq1", 0, 10).unwrap(), "IIIIIIIIII");
+    assert_eq!(reader.fetch_qual("seq2", 4, 16).unwrap(), "JJJJJJJJJJJJ");
+    assert_eq!(reader.fetch_seq("seq2", 0, 4).unwrap(), "GCTA");
+
+    let (seq, qual) = reader.fetch_seq_qual("seq2", 2, 7).unwrap();
+    assert_eq!(seq, "TAGCT");
+    assert_eq!(qual, "JJJJJ");
+
+    assert!(matches!(
+        reader.fetch_qual("nonexistent", 0, 10),
+        Err(FastaError::SequenceNotFound(_))
+    ));
+
+    // A FASTA index has no quality to offer
+    let fasta_file = create_test_fasta();
+    let index = FastaIndex::new(fasta_file.path().to_str().unwrap(), FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    assert!(matches!(
+        reader.fetch_qual("seq1", 0, 10),
+        Err(FastaError::QualityNotAvailable)
+    ));
+    assert!(reader.fetch_seq_qual("seq1", 0, 10).is_err());
 }
 
 #[test]
@@ -197,3 +210,1075 @@ fn test_memory_safety() {
 
     println!("Memory safety test completed successfully");
 }
+
+#[test]
+fn test_many_contig_lookup() {
+    let dir = tempfile::tempdir().unwrap();
+    let path = dir.path().join("pansn.fa");
+    let fai_path = dir.path().join("pansn.fa.fai");
+
+    // Write a FASTA with PanSN-style names and its matching .fai
+    let mut fasta = std::fs::File::create(&path).unwrap();
+    let mut fai = std::fs::File::create(&fai_path).unwrap();
+    let mut offset = 0u64;
+    let n = 20000;
+    for i in 0..n {
+        let name = format!("HG{:05}#{}#chr{}", i / 24, i % 2 + 1, i % 24);
+        let header = format!(">{}\n", name);
+        let seq_len = 10 + i % 7;
+        offset += header.len() as u64;
+        writeln!(
+            fai,
+            "{}\t{}\t{}\t{}\t{}",
+            name,
+            seq_len,
+            offset,
+            seq_len,
+            seq_len + 1
+        )
+        .unwrap();
+        writeln!(fasta, "{}{}", header, "A".repeat(seq_len)).unwrap();
+        offset += seq_len as u64 + 1;
+    }
+    drop(fasta);
+    drop(fai);
+
+    let index = FastaIndex::new(path.to_str().unwrap(), FastaFormat::Fasta).unwrap();
+    assert_eq!(index.num_sequences(), n);
+
+    // Every name resolves to its own entry, in .fai order
+    for i in (0..n).step_by(97) {
+        let name = format!("HG{:05}#{}#chr{}", i / 24, i % 2 + 1, i % 24);
+        assert_eq!(index.sequence_name(i).as_deref(), Some(name.as_str()));
+        assert!(index.has_sequence(&name));
+        assert_eq!(index.sequence_length(&name), Some((10 + i % 7) as i64));
+    }
+
+    assert!(!index.has_sequence("HG99999#1#chr1"));
+    assert!(!index.has_sequence("HG00000#1#chr"));
+    assert!(index.sequence_length("").is_none());
+}
+
+#[test]
+fn test_mmap_reader() {
+    let index = FastaIndex::new("test.fa", FastaFormat::Fasta).unwrap();
+    let mapped = FastaIndex::new_mmap("test.fa", FastaFormat::Fasta).unwrap();
+    assert!(!index.is_mmap());
+    assert!(mapped.is_mmap());
+
+    let reader = FastaReader::new(&index).unwrap();
+    let mapped_reader = FastaReader::new(&mapped).unwrap();
+    assert!(mapped_reader.is_mmap());
+
+    // Mapped fetches match stdio fetches, including ranges that cross lines
+    for name in index.sequence_names() {
+        let len = index.sequence_length(&name).unwrap();
+        for (start, end) in [(0, len), (0, 1), (len - 1, len), (95, 105), (1, len - 1)] {
+            assert_eq!(
+                mapped_reader.fetch_seq(&name, start, end).unwrap(),
+                reader.fetch_seq(&name, start, end).unwrap(),
+                "{}:{}-{}",
+                name,
+                start,
+                end
+            );
+        }
+    }
+
+    // Compressed files load normally and are never mapped
+    let compressed = FastaIndex::new_mmap("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    assert!(!compressed.is_mmap());
+}
+
+#[test]
+fn test_fetch_seq_into() {
+    let index = FastaIndex::new("test.fa", FastaFormat::Fasta).unwrap();
+    let mut reader = FastaReader::new(&index).unwrap();
+
+    // Appends raw bytes matching fetch_seq
+    let mut buf = b"prefix:".to_vec();
+    let n = reader.fetch_seq_into("chr1", 95, 105, &mut buf).unwrap();
+    assert_eq!(n, 10);
+    assert_eq!(
+        &buf[7..],
+        reader.fetch_seq("chr1", 95, 105).unwrap().as_bytes()
+    );
+
+    // A buffer with enough capacity is reused without reallocating
+    buf.clear();
+    buf.reserve(256);
+    let capacity = buf.capacity();
+    let ptr = buf.as_ptr();
+    for name in index.sequence_names() {
+        buf.clear();
+        let len = index.sequence_length(&name).unwrap();
+        let n = reader.fetch_seq_into(&name, 0, len, &mut buf).unwrap();
+        assert_eq!(n as i64, len);
+        assert_eq!(buf.capacity(), capacity);
+        assert_eq!(buf.as_ptr(), ptr);
+    }
+
+    // Coordinates are clipped like fetch_seq; empty regions append nothing
+    buf.clear();
+    assert_eq!(
+        reader.fetch_seq_into("chrX", 200, 1000, &mut buf).unwrap(),
+        2
+    );
+    assert_eq!(reader.fetch_seq_into("chrX", 50, 50, &mut buf).unwrap(), 0);
+    assert_eq!(buf, b"CC");
+    assert!(reader
+        .fetch_seq_into("nonexistent", 0, 10, &mut buf)
+        .is_err());
+    assert!(reader.fetch_seq_into("chr1\0", 0, 10, &mut buf).is_err());
+
+    // Borrowed results come from the reader's own buffer
+    let bytes = reader.fetch_seq_bytes("chr2", 0, 8).unwrap();
+    assert_eq!(bytes, b"GCTAGCTA");
+    let long_name = "x".repeat(300);
+    assert!(reader.fetch_seq_bytes(&long_name, 0, 8).is_err());
+}
+
+#[test]
+fn test_fetch_batch() {
+    for path in ["test.fa", "scerevisiae8.fa.gz"] {
+        let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+        let reader = FastaReader::new(&index).unwrap();
+
+        // Unsorted, overlapping and adjacent regions across every sequence
+        let mut regions = Vec::new();
+        for name in index.sequence_names().iter().rev() {
+            let len = index.sequence_length(name).unwrap();
+            for (start, end) in [(len / 2, len), (0, len / 2), (10, 90), (0, len), (50, 60)] {
+                regions.push((name.clone(), start, end));
+            }
+        }
+
+        let results = reader.fetch_batch(&regions);
+        assert_eq!(results.len(), regions.len());
+        for ((name, start, end), result) in regions.iter().zip(results) {
+            assert_eq!(
+                result.unwrap(),
+                reader.fetch_seq(name, *start, *end).unwrap(),
+                "{}:{}-{}",
+                name,
+                start,
+                end
+            );
+        }
+    }
+
+    // Failures are reported per region without affecting the others
+    let index = FastaIndex::new("test.fa", FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    let results = reader.fetch_batch(&[
+        ("chr2", 0, 8),
+        ("nonexistent", 0, 10),
+        ("chr1\0", 0, 10),
+        ("chrX", 50, 50),
+    ]);
+    assert_eq!(results[0].as_deref().unwrap(), "GCTAGCTA");
+    assert!(matches!(results[1], Err(FastaError::SequenceNotFound(_))));
+    assert!(results[2].is_err());
+    assert_eq!(results[3].as_deref().unwrap(), "");
+    assert!(reader.fetch_batch::<&str>(&[]).is_empty());
+}
+
+#[test]
+fn test_fetch_batch_into() {
+    let mut buf = BatchBuffer::new();
+    for path in ["test.fa", "scerevisiae8.fa.gz"] {
+        let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+        let reader = FastaReader::new(&index).unwrap();
+
+        let mut regions = Vec::new();
+        for name in index.sequence_names().iter().rev() {
+            let len = index.sequence_length(name).unwrap();
+            for (start, end) in [(len / 2, len), (0, len / 2), (10, 90), (50, 60), (5, 5)] {
+                regions.push((name.clone(), start, end));
+            }
+        }
+        regions.push(("nonexistent".to_string(), 0, 10));
+
+        // The buffer is reused across files and batches
+        for _ in 0..2 {
+            let expected = reader.fetch_batch(&regions);
+            let view = reader.fetch_batch_into(&regions, &mut buf).unwrap();
+            assert_eq!(view.len(), regions.len());
+            for (bases, result) in view.iter().zip(expected) {
+                match result {
+                    Ok(seq) => assert_eq!(bases.unwrap(), seq.as_bytes()),
+                    Err(_) => assert!(bases.is_none()),
+                }
+            }
+        }
+    }
+
+    let index = FastaIndex::new("test.fa", FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    let view = reader
+        .fetch_batch_into(&[("chr2", 0, 8), ("chr1\0", 0, 10)], &mut buf)
+        .unwrap();
+    assert_eq!(view.get(0).unwrap(), b"GCTAGCTA");
+    assert!(view.get(1).is_none());
+    assert!(view.get(2).is_none());
+    assert!(reader
+        .fetch_batch_into::<&str>(&[], &mut buf)
+        .unwrap()
+        .is_empty());
+}
+
+#[test]
+fn test_build_index() {
+    let dir = tempfile::tempdir().unwrap();
+
+    // A BGZF copy without indexes gets the same .fai and .gzi as bgzip/samtools
+    let gz = dir.path().join("y.fa.gz");
+    std::fs::copy("scerevisiae8.fa.gz", &gz).unwrap();
+    let gz = gz.to_str().unwrap();
+    FastaIndex::build_index(gz, FastaFormat::Fasta, 4).unwrap();
+    assert_eq!(
+        std::fs::read(format!("{}.fai", gz)).unwrap(),
+        std::fs::read("scerevisiae8.fa.gz.fai").unwrap()
+    );
+    assert_eq!(
+        std::fs::read(format!("{}.gzi", gz)).unwrap(),
+        std::fs::read("scerevisiae8.fa.gz.gzi").unwrap()
+    );
+
+    // new() builds a missing index for uncompressed files too
+    let fa = dir.path().join("t.fa");
+    std::fs::copy("test.fa", &fa).unwrap();
+    let index = FastaIndex::new(fa.to_str().unwrap(), FastaFormat::Fasta).unwrap();
+    assert_eq!(
+        std::fs::read(dir.path().join("t.fa.fai")).unwrap(),
+        std::fs::read("test.fa.fai").unwrap()
+    );
+    let reader = FastaReader::new(&index).unwrap();
+    assert_eq!(reader.fetch_seq("chr2", 0, 8).unwrap(), "GCTAGCTA");
+
+    assert!(FastaIndex::build_index("/nonexistent/file.fa", FastaFormat::Fasta, 0).is_err());
+}
+
+#[test]
+fn test_compress() {
+    let dir = tempfile::tempdir().unwrap();
+    let source = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let source_reader = FastaReader::new(&source).unwrap();
+
+    for (width, align) in [(0, false), (70, true)] {
+        let out = dir.path().join(format!("c{}.fa.gz", width));
+        let out = out.to_str().unwrap();
+        let options = CompressOptions {
+            threads: 3,
+            line_width: width,
+            align_records: align,
+            ..Default::default()
+        };
+        FastaIndex::compress("scerevisiae8.fa.gz", out, FastaFormat::Fasta, &options).unwrap();
+
+        // The indexes written alongside are the ones a separate pass builds
+        let copy = dir.path().join("copy.fa.gz");
+        std::fs::copy(out, &copy).unwrap();
+        let copy = copy.to_str().unwrap();
+        FastaIndex::build_index(copy, FastaFormat::Fasta, 2).unwrap();
+        assert_eq!(
+            std::fs::read(format!("{}.fai", out)).unwrap(),
+            std::fs::read(format!("{}.fai", copy)).unwrap()
+        );
+        std::fs::remove_file(format!("{}.fai", copy)).unwrap();
+
+        let index = FastaIndex::new(out, FastaFormat::Fasta).unwrap();
+        let reader = FastaReader::new(&index).unwrap();
+        assert_eq!(index.sequence_names(), source.sequence_names());
+        for name in source.sequence_names().iter().step_by(17) {
+            let len = source.sequence_length(name).unwrap();
+            for (start, end) in [(0, len), (len / 3, len / 3 + 5000)] {
+                assert_eq!(
+                    reader.fetch_seq(name, start, end).unwrap(),
+                    source_reader.fetch_seq(name, start, end).unwrap()
+                );
+            }
+        }
+    }
+
+    // Multi-line FASTQ with CRLF endings and '@'/'+' quality lines
+    let mut fastq = NamedTempFile::new().unwrap();
+    write!(
+        fastq,
+        "@r1 x\r\nACGT\r\nAC\r\n+r1\r\n@+II\r\nII\r\n@r2\n\n+\n\n"
+    )
+    .unwrap();
+    fastq.flush().unwrap();
+    let out = dir.path().join("r.fq.gz");
+    let out = out.to_str().unwrap();
+    let input = fastq.path().to_str().unwrap();
+    FastaIndex::compress(input, out, FastaFormat::Fastq, &Default::default()).unwrap();
+    let index = FastaIndex::new(out, FastaFormat::Fastq).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    assert_eq!(
+        reader.fetch_seq_qual("r1", 0, 6).unwrap(),
+        ("ACGTAC".to_string(), "@+IIII".to_string())
+    );
+    assert_eq!(index.sequence_length("r2"), Some(0));
+
+    // Truncated records fail and leave nothing behind
+    let mut bad = NamedTempFile::new().unwrap();
+    write!(bad, "@r1\nACGT\n+\nII\n").unwrap();
+    bad.flush().unwrap();
+    let out = dir.path().join("bad.fq.gz");
+    let out = out.to_str().unwrap();
+    let input = bad.path().to_str().unwrap();
+    assert!(FastaIndex::compress(input, out, FastaFormat::Fastq, &Default::default()).is_err());
+    assert!(!std::path::Path::new(out).exists());
+}
+
+#[test]
+fn test_fetch_seq_parallel() {
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let names = index.sequence_names();
+    let longest = names
+        .iter()
+        .max_by_key(|name| index.sequence_length(name).unwrap())
+        .unwrap();
+    let len = index.sequence_length(longest).unwrap();
+
+    for (start, end) in [(0, len), (12345, len - 999), (len - 10, i64::MAX)] {
+        let serial = index.fetch_seq(longest, start, end).unwrap();
+        for threads in [0, 1, 4] {
+            assert_eq!(
+                index
+                    .fetch_seq_parallel(longest, start, end, threads)
+                    .unwrap(),
+                serial
+            );
+        }
+    }
+
+    let mut buf = b">".to_vec();
+    let n = index
+        .fetch_seq_parallel_into(&names[0], 0, 100, 2, &mut buf)
+        .unwrap();
+    assert_eq!(n, 100);
+    assert_eq!(
+        &buf[1..],
+        index.fetch_seq(&names[0], 0, 100).unwrap().as_bytes()
+    );
+    assert!(index.fetch_seq_parallel("nonexistent", 0, 10, 2).is_err());
+}
+
+#[test]
+fn test_line_layout() {
+    // The .fai only records the first line of "ragged"
+    let ragged = ["ACGTACGTAC", "GGG", "TTTTTTTTTTTTTT", "CA"].concat();
+    let mut fasta = NamedTempFile::new().unwrap();
+    write!(
+        fasta,
+        ">ragged\nACGTACGTAC\nGGG\nTTTTTTTTTTTTTT\nCA\n>crlf\r\nACGT\r\nGGCC\r\nTT\r\n>single\nACGTTGCA\n"
+    )
+    .unwrap();
+    fasta.flush().unwrap();
+    let path = fasta.path().to_str().unwrap();
+
+    for verify in [false, true] {
+        let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+        if verify {
+            assert_eq!(index.verify_layout().unwrap(), 1);
+        }
+        let reader = FastaReader::new(&index).unwrap();
+        for (start, end) in [(0, 29), (8, 15), (13, 27), (27, 29)] {
+            assert_eq!(
+                reader.fetch_seq("ragged", start, end).unwrap(),
+                ragged[start as usize..end as usize]
+            );
+        }
+        assert_eq!(reader.fetch_seq("crlf", 2, 9).unwrap(), "GTGGCCT");
+        assert_eq!(reader.fetch_seq("single", 3, 8).unwrap(), "TTGCA");
+
+        let regions = [("ragged", 5, 20), ("single", 0, 4), ("crlf", 0, 10)];
+        let batch: Vec<String> = reader
+            .fetch_batch(&regions)
+            .into_iter()
+            .map(Result::unwrap)
+            .collect();
+        assert_eq!(batch, [&ragged[5..20], "ACGT", "ACGTGGCCTT"]);
+    }
+}
+
+#[test]
+fn test_ragged_first_fetch() {
+    // Each fetch is the first of an unchecked index and, by the .fai's
+    // layout, stays inside one line
+    let seq = ["ACGTACGTAC", "GG", "ACGTTGCAAC", "TTTT"].concat();
+    let mut fasta = NamedTempFile::new().unwrap();
+    write!(fasta, ">shifted\nACGTACGTAC\nGG\nACGTTGCAAC\nTTTT\n").unwrap();
+    fasta.flush().unwrap();
+    let path = fasta.path().to_str().unwrap();
+
+    for (start, end) in [(13, 16), (20, 24), (2, 5), (11, 13)] {
+        let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+        let reader = FastaReader::new(&index).unwrap();
+        assert_eq!(
+            reader.fetch_seq("shifted", start, end).unwrap(),
+            seq[start as usize..end as usize]
+        );
+    }
+}
+
+#[test]
+fn test_line_width_kernels() {
+    // The widths with kernels of their own, and one without
+    let seq: String = (0..1000)
+        .map(|i| ["A", "C", "G", "T"][(i * 7 + i / 3) % 4])
+        .collect();
+    for width in [60, 70, 80, 61] {
+        for eol in ["\n", "\r\n"] {
+            let mut fasta = NamedTempFile::new().unwrap();
+            write!(fasta, ">s{}", eol).unwrap();
+            for line in seq.as_bytes().chunks(width) {
+                fasta.write_all(line).unwrap();
+                write!(fasta, "{}", eol).unwrap();
+            }
+            fasta.flush().unwrap();
+
+            let path = fasta.path().to_str().unwrap();
+            let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+            let reader = FastaReader::new(&index).unwrap();
+            for (start, end) in [(0, 1000), (59, 61), (79, 241), (width as i64, 999)] {
+                assert_eq!(
+                    reader.fetch_seq("s", start, end).unwrap(),
+                    seq[start as usize..end as usize]
+                );
+            }
+        }
+    }
+}
+
+#[test]
+fn test_packed_index() {
+    let mut fasta = NamedTempFile::new().unwrap();
+    writeln!(fasta, ">mixed").unwrap();
+    writeln!(fasta, "ACGTNNNNacgtnnRYacgT").unwrap();
+    writeln!(fasta, "TTTT-*GGGGCCCCaaaaAA").unwrap();
+    writeln!(fasta, "CAT").unwrap();
+    writeln!(fasta, ">empty").unwrap();
+    fasta.flush().unwrap();
+    let path = fasta.path().to_str().unwrap();
+
+    let text = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+    let packed = FastaIndex::new_packed(path, FastaFormat::Fasta).unwrap();
+    assert!(packed.is_packed());
+    assert!(!text.is_packed());
+
+    let text_reader = FastaReader::new(&text).unwrap();
+    let packed_reader = FastaReader::new(&packed).unwrap();
+    for start in 0..43 {
+        for end in start..=45 {
+            assert_eq!(
+                packed_reader.fetch_seq("mixed", start, end).ok(),
+                text_reader.fetch_seq("mixed", start, end).ok(),
+                "mixed:{}-{}",
+                start,
+                end
+            );
+        }
+    }
+    assert_eq!(
+        packed_reader.fetch_seq_all("mixed").unwrap(),
+        "ACGTNNNNacgtnnRYacgTTTTT-*GGGGCCCCaaaaAACAT"
+    );
+    let batch = packed_reader.fetch_batch(&[("mixed", 4, 8), ("empty", 0, 5), ("missing", 0, 1)]);
+    assert_eq!(batch[0].as_deref().unwrap(), "NNNN");
+    assert!(batch[2].is_err());
+
+    // 43 bases in two words; the mask and exceptions are not in the words
+    let (words, len) = packed.packed_sequence("mixed").unwrap();
+    assert_eq!((words.len(), len), (2, 43));
+    assert_eq!(words[0] & 0xff, 0b11_10_01_00);
+    assert_eq!((words[1] >> 16) & 0x3f, 0b11_00_01);
+    assert!(packed.packed_sequence("missing").is_none());
+    assert!(text.packed_sequence("mixed").is_none());
+}
+
+#[test]
+fn test_lazy_index() {
+    let dir = tempfile::tempdir().unwrap();
+    let fa = dir.path().join("many.fa");
+    let long_name = "L".repeat(3000);
+    let mut file = std::fs::File::create(&fa).unwrap();
+    for i in 0..5000 {
+        writeln!(file, ">read{}\n{}", i, &"ACGTTGCA"[..1 + i % 8]).unwrap();
+    }
+    writeln!(file, ">{}\nACGTAC", long_name).unwrap();
+    drop(file);
+    let fa = fa.to_str().unwrap();
+
+    // The text index is parsed once, then swapped for the new sidecar
+    let text = FastaIndex::new(fa, FastaFormat::Fasta).unwrap();
+    let first = FastaIndex::new_lazy(fa, FastaFormat::Fasta).unwrap();
+    assert!(first.is_binary());
+    let lazy = FastaIndex::new_lazy(fa, FastaFormat::Fasta).unwrap();
+    assert!(lazy.is_binary());
+
+    // Names longer than a line buffer survive the text path as well
+    for index in [&text, &first, &lazy] {
+        assert_eq!(index.num_sequences(), 5001);
+        assert_eq!(index.sequence_name(4321).unwrap(), "read4321");
+        assert_eq!(index.sequence_name(5000).unwrap(), long_name);
+        assert_eq!(index.fetch_seq(&long_name, 1, 4).unwrap(), "CGT");
+    }
+    for i in (0..5000).step_by(97) {
+        let name = format!("read{}", i);
+        assert_eq!(
+            lazy.fetch_seq(&name, 0, 8).unwrap(),
+            text.fetch_seq(&name, 0, 8).unwrap()
+        );
+    }
+    assert!(!lazy.has_sequence("read5000"));
+}
+
+#[test]
+fn test_numa_index() {
+    let plain = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let numa = FastaIndex::new_numa("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&numa).unwrap();
+    let plain_reader = FastaReader::new(&plain).unwrap();
+    for name in plain.sequence_names().iter().take(3) {
+        assert_eq!(
+            reader.fetch_seq(name, 1000, 1500).unwrap(),
+            plain_reader.fetch_seq(name, 1000, 1500).unwrap()
+        );
+    }
+    assert_eq!(plain.numa_nodes(), 0);
+    assert!(numa.numa_nodes() != 1);
+}
+
+#[test]
+fn test_binary_index() {
+    let dir = tempfile::tempdir().unwrap();
+    let gz = dir.path().join("y.fa.gz");
+    std::fs::copy("scerevisiae8.fa.gz", &gz).unwrap();
+    std::fs::copy("scerevisiae8.fa.gz.fai", dir.path().join("y.fa.gz.fai")).unwrap();
+    let gz = gz.to_str().unwrap();
+
+    // The first load falls back to the text index and writes the sidecar
+    let text = FastaIndex::new_binary(gz, FastaFormat::Fasta).unwrap();
+    assert!(!text.is_binary());
+    assert!(dir.path().join("y.fa.gz.fai.bin").exists());
+
+    // The .gzi is not needed once its blocks are in the sidecar
+    std::fs::remove_file(dir.path().join("y.fa.gz.gzi")).ok();
+    let bin = FastaIndex::new_binary(gz, FastaFormat::Fasta).unwrap();
+    assert!(bin.is_binary());
+    assert_eq!(bin.sequence_names(), text.sequence_names());
+
+    let text_reader = FastaReader::new(&text).unwrap();
+    let bin_reader = FastaReader::new(&bin).unwrap();
+    for name in bin.sequence_names() {
+        let len = bin.sequence_length(&name).unwrap();
+        assert_eq!(Some(len), text.sequence_length(&name));
+        let (start, end) = (len / 2, len / 2 + 1000);
+        assert_eq!(
+            bin_reader.fetch_seq(&name, start, end).unwrap(),
+            text_reader.fetch_seq(&name, start, end).unwrap()
+        );
+    }
+    assert!(!bin.has_sequence("nonexistent"));
+
+    // Rewriting the sequence file makes the sidecar stale
+    let fa = dir.path().join("t.fa");
+    std::fs::copy("test.fa", &fa).unwrap();
+    let fa = fa.to_str().unwrap();
+    FastaIndex::new(fa, FastaFormat::Fasta)
+        .unwrap()
+        .write_binary_index()
+        .unwrap();
+    assert!(FastaIndex::new_binary(fa, FastaFormat::Fasta)
+        .unwrap()
+        .is_binary());
+    let mut seq = std::fs::read(fa).unwrap();
+    seq.extend_from_slice(b">extra\nACGT\n");
+    std::fs::write(fa, seq).unwrap();
+    std::fs::remove_file(format!("{}.fai", fa)).unwrap();
+    let rebuilt = FastaIndex::new_binary(fa, FastaFormat::Fasta).unwrap();
+    assert!(!rebuilt.is_binary());
+    assert!(rebuilt.has_sequence("extra"));
+}
+
+#[test]
+fn test_sequence_chunks() {
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    let names = index.sequence_names();
+
+    for threads in [0, 3] {
+        let mut chunks = reader.chunks(100_000, threads).unwrap();
+        let mut expected = (0, 0);
+        while let Some(chunk) = chunks.next_chunk() {
+            let chunk = chunk.unwrap();
+            assert_eq!((chunk.seq_index, chunk.offset), expected);
+            assert_eq!(chunk.name, names[chunk.seq_index]);
+            assert!(chunk.bases.len() <= 100_000);
+            if chunk.seq_index < 3 {
+                let end = chunk.offset + chunk.bases.len() as i64;
+                let want = reader.fetch_seq(chunk.name, chunk.offset, end).unwrap();
+                assert_eq!(chunk.bases, want.as_bytes());
+            }
+            expected = if chunk.is_record_end() {
+                (chunk.seq_index + 1, 0)
+            } else {
+                (chunk.seq_index, chunk.offset + chunk.bases.len() as i64)
+            };
+        }
+        assert_eq!(expected, (names.len(), 0));
+    }
+
+    let mut records = reader.chunks(4096, 2).unwrap();
+    for name in names.iter().take(3) {
+        let (got, bases) = records.next_record().unwrap().unwrap();
+        assert_eq!(got, name);
+        assert_eq!(bases, reader.fetch_seq_all(name).unwrap().as_bytes());
+    }
+    assert!(reader.chunks(0, 1).is_err());
+}
+
+#[test]
+fn test_fetch_transformed() {
+    let mut fasta = NamedTempFile::new().unwrap();
+    writeln!(fasta, ">mixed").unwrap();
+    writeln!(fasta, "ACGTNNNNacgtnnRYacgT").unwrap();
+    writeln!(fasta, "TTTT-*GGGGCCCCaaaaAA").unwrap();
+    writeln!(fasta, "CATkmbdhvswu").unwrap();
+    fasta.flush().unwrap();
+    let path = fasta.path().to_str().unwrap();
+
+    fn complement(c: char) -> char {
+        let from = "ACGTUMRWSYKVHDBNacgtumrwsykvhdbn";
+        let to = "TGCAAKYWSRMBDHVNtgcaakywsrmbdhvn";
+        from.find(c).map_or(c, |i| to.as_bytes()[i] as char)
+    }
+
+    for index in [
+        FastaIndex::new(path, FastaFormat::Fasta).unwrap(),
+        FastaIndex::new_packed(path, FastaFormat::Fasta).unwrap(),
+    ] {
+        let reader = FastaReader::new(&index).unwrap();
+        for (start, end) in [(0, 52), (3, 41), (17, 18), (20, 52)] {
+            let plain = reader.fetch_seq("mixed", start, end).unwrap();
+            let revcomp: String = plain.chars().rev().map(complement).collect();
+            let fetch = |reverse_complement, soft_mask| {
+                let transform = SeqTransform {
+                    reverse_complement,
+                    soft_mask,
+                };
+                reader
+                    .fetch_seq_transformed("mixed", start, end, transform)
+                    .unwrap()
+            };
+
+            assert_eq!(fetch(false, SoftMask::Keep), plain);
+            assert_eq!(fetch(true, SoftMask::Keep), revcomp);
+            assert_eq!(fetch(false, SoftMask::Upper), plain.to_uppercase());
+            assert_eq!(fetch(true, SoftMask::Upper), revcomp.to_uppercase());
+            let hard: String = revcomp
+                .chars()
+                .map(|c| if c.is_ascii_lowercase() { 'N' } else { c })
+                .collect();
+            assert_eq!(fetch(true, SoftMask::HardMask), hard);
+        }
+    }
+
+    let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    let mut buf = b"x".to_vec();
+    let n = reader
+        .fetch_seq_into_transformed("mixed", 0, 4, SeqTransform::reverse_complement(), &mut buf)
+        .unwrap();
+    assert_eq!((n, &buf[..]), (4, &b"xACGT"[..]));
+}
+
+#[test]
+fn test_bgzf_crc_check() {
+    let dir = tempfile::tempdir().unwrap();
+    let path = dir.path().join("y.fa.gz");
+    for ext in ["", ".fai", ".gzi"] {
+        std::fs::copy(
+            format!("scerevisiae8.fa.gz{}", ext),
+            format!("{}{}", path.display(), ext),
+        )
+        .unwrap();
+    }
+    let path = path.to_str().unwrap();
+    let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+    let name = index.sequence_name(0).unwrap();
+    let good = index.fetch_seq(&name, 10, 20).unwrap();
+
+    // Flip one bit of the first block's CRC32
+    let mut data = std::fs::read(path).unwrap();
+    let bsize = u16::from_le_bytes([data[16], data[17]]) as usize + 1;
+    data[bsize - 8] ^= 1;
+    std::fs::write(path, &data).unwrap();
+
+    let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+    assert!(index.fetch_seq(&name, 10, 20).is_err());
+    assert_eq!(good.len(), 10);
+}
+
+#[test]
+fn test_readahead() {
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let name = index.sequence_name(0).unwrap();
+    let len = index.sequence_length(&name).unwrap();
+
+    // Overlapping tiling windows, then a jump backwards
+    let mut windows: Vec<i64> = (0..len).step_by(7_000).collect();
+    windows.push(1_000);
+    for readahead in [Readahead::Off, Readahead::Auto, Readahead::Blocks(4)] {
+        let reader = FastaReader::new(&index).unwrap();
+        reader.set_readahead(readahead).unwrap();
+        for &start in &windows {
+            assert_eq!(
+                reader.fetch_seq(&name, start, start + 10_000).unwrap(),
+                index.fetch_seq(&name, start, start + 10_000).unwrap(),
+                "{:?} at {}",
+                readahead,
+                start
+            );
+        }
+    }
+}
+
+#[test]
+fn test_collection() {
+    // One assembly per file, with PanSN-style names
+    let files: Vec<NamedTempFile> = (0..5)
+        .map(|f| {
+            let mut file = NamedTempFile::new().unwrap();
+            for c in 0..3 {
+                writeln!(file, ">HG{:03}#1#chr{}", f, c).unwrap();
+                for l in 0..(10 + f * 3 + c) {
+                    let line: String = (0..60)
+                        .map(|i| b"ACGT"[(f + c + l + i) % 4] as char)
+                        .collect();
+                    writeln!(file, "{}", line).unwrap();
+                }
+            }
+            file
+        })
+        .collect();
+    let paths: Vec<&str> = files.iter().map(|f| f.path().to_str().unwrap()).collect();
+
+    let collection = FastaCollection::new(&paths, FastaFormat::Fasta).unwrap();
+    assert_eq!(collection.num_files(), 5);
+    assert_eq!(collection.num_sequences(), 15);
+    assert_eq!(collection.sequence_name(4).unwrap(), "HG001#1#chr1");
+    assert_eq!(collection.file_of("HG003#1#chr2"), Some(3));
+    assert_eq!(collection.file_of("HG009#1#chr0"), None);
+    assert_eq!(collection.sequence_length("HG004#1#chr2"), Some(24 * 60));
+
+    // Descriptors are opened on demand and capped
+    assert_eq!(collection.open_files(), 0);
+    collection.set_max_open_files(2);
+    let reader = CollectionReader::new(&collection).unwrap();
+    for name in (0..collection.num_sequences())
+        .rev()
+        .map(|i| collection.sequence_name(i).unwrap())
+    {
+        let index = collection
+            .index(collection.file_of(&name).unwrap())
+            .unwrap();
+        let expected = index.fetch_seq(&name, 30, 200).unwrap();
+        assert_eq!(reader.fetch_seq(&name, 30, 200).unwrap(), expected);
+        assert_eq!(collection.fetch_seq(&name, 30, 200).unwrap(), expected);
+        assert!(collection.open_files() <= 2);
+    }
+    assert!(matches!(
+        reader.fetch_seq("HG009#1#chr0", 0, 10),
+        Err(FastaError::SequenceNotFound(_))
+    ));
+
+    // Shared across threads like an index
+    let collection = Arc::new(collection);
+    let handles: Vec<_> = (0..4)
+        .map(|t| {
+            let collection = Arc::clone(&collection);
+            thread::spawn(move || {
+                let reader = CollectionReader::new(&collection).unwrap();
+                for i in 0..100 {
+                    let name = format!("HG{:03}#1#chr{}", (t + i) % 5, i % 3);
+                    assert_eq!(
+                        reader
+                            .fetch_seq(&name, i as i64, i as i64 + 50)
+                            .unwrap()
+                            .len(),
+                        50
+                    );
+                }
+            })
+        })
+        .collect();
+    for handle in handles {
+        handle.join().unwrap();
+    }
+}
+
+#[test]
+fn test_fetch_stats() {
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let name = index.sequence_name(0).unwrap();
+
+    let reader = FastaReader::new(&index).unwrap();
+    for i in 0..100 {
+        reader
+            .fetch_seq(&name, i * 2_000, i * 2_000 + 1_000)
+            .unwrap();
+    }
+    let stats = reader.stats();
+    assert_eq!(stats.fetches, 100);
+    assert_eq!(stats.bases, 100_000);
+    assert!(stats.bytes_read >= stats.bases);
+    assert!(stats.compressed_bytes > 0 && stats.blocks_inflated > 0);
+    assert_eq!(stats.timed, 2);
+    for phase in [&stats.lookup, &stats.read, &stats.inflate, &stats.deline] {
+        assert_eq!(phase.count, stats.timed);
+        assert_eq!(phase.buckets().map(|(_, n)| n).sum::<u64>(), phase.count);
+        assert!(phase.quantile_ns(0.5) <= phase.quantile_ns(1.0));
+        assert!(phase.quantile_ns(1.0) <= phase.max_ns);
+    }
+
+    // The index adds up dropped readers and stateless fetches
+    drop(reader);
+    index.fetch_seq(&name, 0, 500).unwrap();
+    let total = index.stats();
+    assert_eq!(total.fetches, 101);
+    assert_eq!(total.bases, 100_500);
+    assert_eq!(total.blocks_inflated, stats.blocks_inflated + 1);
+}
+
+/// Minimal executor: poll on this thread, park until woken
+fn block_on<F: std::future::Future>(fut: F) -> F::Output {
+    struct Unpark(thread::Thread);
+    impl std::task::Wake for Unpark {
+        fn wake(self: Arc<Self>) {
+            self.0.unpark();
+        }
+    }
+
+    let waker = std::task::Waker::from(Arc::new(Unpark(thread::current())));
+    let mut cx = std::task::Context::from_waker(&waker);
+    let mut fut = std::pin::pin!(fut);
+    loop {
+        if let std::task::Poll::Ready(out) = fut.as_mut().poll(&mut cx) {
+            return out;
+        }
+        thread::park();
+    }
+}
+
+#[test]
+fn test_async_fetcher() {
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let reader = FastaReader::new(&index).unwrap();
+    let names = index.sequence_names();
+    let region = |i: usize| {
+        let name = &names[i % names.len()];
+        let start = (i as i64 * 7919) % 50_000;
+        (name.as_str(), start, start + 500)
+    };
+
+    let fetcher = AsyncFetcher::new(&index, 4).unwrap();
+
+    // All futures are submitted before the first is awaited
+    let futures: Vec<_> = (0..200)
+        .map(|i| {
+            let (name, start, end) = region(i);
+            fetcher.fetch(name, start, end)
+        })
+        .collect();
+    for (i, future) in futures.into_iter().enumerate() {
+        let (name, start, end) = region(i);
+        assert_eq!(
+            block_on(future).unwrap(),
+            reader.fetch_seq(name, start, end).unwrap()
+        );
+    }
+
+    // Tagged submissions come back through wait_completion, in any order
+    let tags: Vec<u64> = (0..100)
+        .map(|i| {
+            let (name, start, end) = region(i);
+            fetcher.submit(name, start, end).unwrap()
+        })
+        .collect();
+    let missing = fetcher.submit("nonexistent", 0, 10).unwrap();
+    let mut seen = std::collections::HashMap::new();
+    while let Some(done) = fetcher.wait_completion() {
+        seen.insert(done.tag, done.result);
+    }
+    assert_eq!(seen.len(), 101);
+    assert_eq!(fetcher.outstanding(), 0);
+    for (i, tag) in tags.iter().enumerate() {
+        let (name, start, end) = region(i);
+        assert_eq!(
+            seen[tag].as_ref().unwrap(),
+            &reader.fetch_seq(name, start, end).unwrap()
+        );
+    }
+    assert!(matches!(
+        seen[&missing],
+        Err(FastaError::SequenceNotFound(_))
+    ));
+
+    // Dropped futures discard their result; unknown names fail
+    drop(fetcher.fetch(&names[0], 0, 100_000));
+    assert!(block_on(fetcher.fetch("nonexistent", 0, 10)).is_err());
+    assert_eq!(block_on(fetcher.fetch(&names[0], 5, 5)).unwrap(), "");
+    assert!(fetcher.try_completion().is_none());
+}
+
+#[cfg(feature = "async")]
+#[test]
+fn test_async_completions_stream() {
+    use futures_core::Stream;
+
+    let index = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let fetcher = AsyncFetcher::new(&index, 2).unwrap();
+    let name = index.sequence_name(0).unwrap();
+    for i in 0..50 {
+        fetcher.submit(&name, i * 100, i * 100 + 100).unwrap();
+    }
+
+    let mut stream = std::pin::pin!(fetcher.completions());
+    let mut count = 0;
+    while let Some(done) = block_on(std::future::poll_fn(|cx| stream.as_mut().poll_next(cx))) {
+        assert_eq!(done.result.unwrap().len(), 100);
+        count += 1;
+    }
+    assert_eq!(count, 50);
+}
+
+/// Serve the files in the working directory over HTTP/1.1 with HEAD and
+/// Range support, counting the range requests
+#[cfg(feature = "remote")]
+fn serve_ranges() -> (String, Arc<std::sync::atomic::AtomicUsize>) {
+    use std::io::{BufRead, BufReader};
+    use std::net::TcpListener;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+    let url = format!("http://{}", listener.local_addr().unwrap());
+    let ranges = Arc::new(AtomicUsize::new(0));
+    let counter = Arc::clone(&ranges);
+    thread::spawn(move || {
+        for stream in listener.incoming() {
+            let mut stream = stream.unwrap();
+            let counter = Arc::clone(&counter);
+            thread::spawn(move || {
+                let mut reader = BufReader::new(stream.try_clone().unwrap());
+                loop {
+                    let mut request = String::new();
+                    let mut range = None;
+                    let mut line = String::new();
+                    while reader.read_line(&mut line).unwrap_or(0) > 0 && line != "\r\n" {
+                        if request.is_empty() {
+                            request = line.clone();
+                        } else if let Some(value) =
+                            line.to_ascii_lowercase().strip_prefix("range: bytes=")
+                        {
+                            let (beg, end) = value.trim().split_once('-').unwrap();
+                            range = Some((
+                                beg.parse::<usize>().unwrap(),
+                                end.parse::<usize>().unwrap(),
+                            ));
+                        }
+                        line.clear();
+                    }
+                    let mut parts = request.split_whitespace();
+                    let (Some(method), Some(path)) = (parts.next(), parts.next()) else {
+                        return;
+                    };
+                    let Ok(data) = std::fs::read(path.trim_start_matches('/')) else {
+                        stream
+                            .write_all(b"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n")
+                            .unwrap();
+                        continue;
+                    };
+                    let (status, body) = match range {
+                        Some((beg, end)) => {
+                            counter.fetch_add(1, Ordering::SeqCst);
+                            ("206 Partial Content", &data[beg..(end + 1).min(data.len())])
+                        }
+                        None => ("200 OK", &data[..]),
+                    };
+                    let header = format!(
+                        "HTTP/1.1 {}\r\nContent-Length: {}\r\nETag: \"{}\"\r\n\r\n",
+                        status,
+                        body.len(),
+                        data.len()
+                    );
+                    stream.write_all(header.as_bytes()).unwrap();
+                    if method != "HEAD" {
+                        stream.write_all(body).unwrap();
+                    }
+                }
+            });
+        }
+    });
+    (url, ranges)
+}
+
+#[cfg(feature = "remote")]
+#[test]
+fn test_remote_index() {
+    use std::sync::atomic::Ordering;
+
+    let (url, ranges) = serve_ranges();
+    let local = FastaIndex::new("scerevisiae8.fa.gz", FastaFormat::Fasta).unwrap();
+    let url = format!("{}/scerevisiae8.fa.gz", url);
+    let cache = tempfile::tempdir().unwrap();
+    let cache_dir = cache.path().to_str().unwrap();
+
+    let regions: Vec<(String, i64, i64)> = (0..40)
+        .map(|i| {
+            let name = local.sequence_name(i % local.num_sequences()).unwrap();
+            let len = local.sequence_length(&name).unwrap();
+            let beg = (i as i64 * 7919 * 311) % len;
+            (name, beg, (beg + 5000).min(len))
+        })
+        .collect();
+
+    // Cold: every fetch matches the local file
+    let remote = FastaIndex::new_url(&url, Some(cache_dir), FastaFormat::Fasta).unwrap();
+    assert_eq!(remote.num_sequences(), local.num_sequences());
+    let reader = FastaReader::new(&remote).unwrap();
+    for (name, beg, end) in &regions {
+        assert_eq!(
+            reader.fetch_seq(name, *beg, *end).unwrap(),
+            local.fetch_seq(name, *beg, *end).unwrap()
+        );
+    }
+    drop(reader);
+    drop(remote);
+    assert!(ranges.load(Ordering::SeqCst) > 0);
+
+    // Warm: the same fetches, and the index files, come from the cache
+    ranges.store(0, Ordering::SeqCst);
+    let remote = FastaIndex::new_url(&url, Some(cache_dir), FastaFormat::Fasta).unwrap();
+    for (name, beg, end) in &regions {
+        assert_eq!(
+            remote.fetch_seq(name, *beg, *end).unwrap(),
+            local.fetch_seq(name, *beg, *end).unwrap()
+        );
+    }
+    assert_eq!(ranges.load(Ordering::SeqCst), 0);
+
+    // Without a cache each read is a request of its own
+    let uncached = FastaIndex::new_url(&url, None, FastaFormat::Fasta).unwrap();
+    let (name, beg, end) = &regions[0];
+    assert_eq!(
+        uncached.fetch_seq(name, *beg, *end).unwrap(),
+        local.fetch_seq(name, *beg, *end).unwrap()
+    );
+    assert!(ranges.load(Ordering::SeqCst) > 0);
+
+    assert!(FastaIndex::new_url(&format!("{}.missing", url), None, FastaFormat::Fasta).is_err());
+}
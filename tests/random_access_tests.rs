@@ -298,3 +298,92 @@ fn test_region_parsing() {
 
     println!("Region parsing tests completed");
 }
+
+#[test]
+fn test_block_boundary_consistency() {
+    let fasta_file = "scerevisiae8.fa.gz";
+
+    if !fs::metadata(fasta_file).is_ok() {
+        eprintln!("Test file {} not found, skipping test", fasta_file);
+        return;
+    }
+
+    let index =
+        FastaIndex::new(fasta_file, FastaFormat::Fasta).expect("Failed to load FASTA index");
+
+    let reader = FastaReader::new(&index).expect("Failed to create FASTA reader");
+
+    // chrXII spans many BGZF blocks; every window must agree with the full fetch
+    let seq_name = "SGDref#1#chrXII";
+    let seq_len = index.sequence_length(seq_name).unwrap();
+    let full = reader.fetch_seq_all(seq_name).unwrap();
+    assert_eq!(full.len() as i64, seq_len);
+
+    let mut start = 0;
+    while start < seq_len {
+        let end = std::cmp::min(seq_len, start + 1000);
+        let window = reader.fetch_seq(seq_name, start, end).unwrap();
+        assert_eq!(
+            window,
+            &full[start as usize..end as usize],
+            "Window {}-{} differs from full sequence",
+            start,
+            end
+        );
+        start += 65_213;
+    }
+
+    // The last base of the last sequence lives in the final data block
+    let last_idx = index.num_sequences() - 1;
+    let last_name = index.sequence_name(last_idx).unwrap();
+    let last_len = index.sequence_length(&last_name).unwrap();
+    let tail = reader
+        .fetch_seq(&last_name, last_len - 1, last_len)
+        .unwrap();
+    assert_eq!(tail.len(), 1);
+}
+
+#[test]
+fn test_shared_block_cache() {
+    let fasta_file = "scerevisiae8.fa.gz";
+
+    if !fs::metadata(fasta_file).is_ok() {
+        eprintln!("Test file {} not found, skipping test", fasta_file);
+        return;
+    }
+
+    let index =
+        FastaIndex::new(fasta_file, FastaFormat::Fasta).expect("Failed to load FASTA index");
+    let uncached = FastaReader::new(&index).expect("Failed to create FASTA reader");
+
+    index.set_cache_size(8 << 20);
+    let reader_a = FastaReader::new(&index).expect("Failed to create FASTA reader");
+    let reader_b = FastaReader::new(&index).expect("Failed to create FASTA reader");
+
+    // Overlapping sliding windows land in the same blocks across both readers
+    let seq_name = "SGDref#1#chrIV";
+    for start in (0..400_000).step_by(5_000) {
+        let expected = uncached.fetch_seq(seq_name, start, start + 300).unwrap();
+        assert_eq!(
+            reader_a.fetch_seq(seq_name, start, start + 300).unwrap(),
+            expected
+        );
+        assert_eq!(
+            reader_b.fetch_seq(seq_name, start, start + 300).unwrap(),
+            expected
+        );
+    }
+
+    let stats = index.cache_stats();
+    assert_eq!(stats.capacity, 8 << 20);
+    assert!(stats.hits > 0, "Expected cache hits, got {:?}", stats);
+    assert!(stats.bytes <= stats.capacity);
+    assert_eq!(reader_a.cache_stats(), stats);
+
+    // A private cache is counted separately from the shared one
+    reader_a.set_cache_size(1 << 20).unwrap();
+    reader_a.fetch_seq(seq_name, 10, 20).unwrap();
+    reader_a.fetch_seq(seq_name, 500_000, 500_010).unwrap();
+    assert_eq!(reader_a.cache_stats().capacity, 1 << 20);
+    assert_eq!(index.cache_stats().capacity, 8 << 20);
+}
@@ -1,4 +1,4 @@
-use faigz_rs::{FastaFormat, FastaIndex, FastaReader};
+use faigz_rs::{FastaFormat, FastaIndex, FastaReader, ReaderPool};
 use std::io::Write;
 use std::sync::{Arc, Barrier};
 use std::thread;
@@ -245,3 +245,85 @@ fn test_stress_concurrent_access() {
         println!("Stress test skipped - index creation failed");
     }
 }
+
+#[test]
+fn test_reader_pool() {
+    let fasta_file = create_large_test_fasta();
+    let path = fasta_file.path().to_str().unwrap();
+
+    let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+    let pool = ReaderPool::new(&index);
+    let num_threads = 8;
+
+    // Many short tasks per thread; each borrows a reader only briefly
+    thread::scope(|s| {
+        for thread_id in 0..num_threads {
+            let pool = &pool;
+            s.spawn(move || {
+                for i in 0..200 {
+                    let seq_id = (thread_id * 200 + i) % 100;
+                    let seq_name = format!("seq{}", seq_id);
+                    let seq = pool
+                        .with_reader(|reader| reader.fetch_seq_all(&seq_name))
+                        .unwrap()
+                        .unwrap();
+                    assert_eq!(seq.len(), 50 + (seq_id * 10) % 200);
+                }
+            });
+        }
+    });
+
+    // Readers were reused: never more than one per concurrent task
+    let idle = pool.idle_readers();
+    assert!(idle >= 1 && idle <= num_threads, "{} idle readers", idle);
+
+    let reader = pool.get().unwrap();
+    assert_eq!(pool.idle_readers(), idle - 1);
+    assert_eq!(reader.fetch_seq("seq1", 0, 4).unwrap(), "TTTT");
+    drop(reader);
+    assert_eq!(pool.idle_readers(), idle);
+
+    // Pooled readers keep the index alive after the caller's handle goes
+    drop(index);
+    assert_eq!(pool.index().num_sequences(), 100);
+    assert!(pool.get().unwrap().fetch_seq_all("seq2").is_ok());
+}
+
+#[test]
+fn test_shared_index_fetch() {
+    let fasta_file = create_large_test_fasta();
+    let path = fasta_file.path().to_str().unwrap();
+
+    for path in [path, "scerevisiae8.fa.gz"] {
+        let index = FastaIndex::new(path, FastaFormat::Fasta).unwrap();
+        index.set_cache_size(4 << 20);
+        let names = index.sequence_names();
+        let reader = FastaReader::new(&index).unwrap();
+        let expected: Vec<String> = names
+            .iter()
+            .map(|name| reader.fetch_seq(name, 0, 2000).unwrap())
+            .collect();
+
+        // Every thread fetches through the same index, with no reader of its own
+        thread::scope(|s| {
+            for thread_id in 0..32 {
+                let (index, names, expected) = (&index, &names, &expected);
+                s.spawn(move || {
+                    let mut buf = Vec::new();
+                    for i in 0..100 {
+                        let k = (thread_id * 7 + i) % names.len();
+                        let start = (i % 50) as i64;
+                        let seq = index.fetch_seq(&names[k], start, 2000).unwrap();
+                        assert_eq!(seq, expected[k][start as usize..]);
+
+                        buf.clear();
+                        index.fetch_seq_into(&names[k], 0, 10, &mut buf).unwrap();
+                        assert_eq!(buf, expected[k].as_bytes()[..10]);
+                    }
+                });
+            }
+        });
+
+        assert!(index.fetch_seq("nonexistent", 0, 10).is_err());
+    }
+}